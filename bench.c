@@ -0,0 +1,722 @@
+/**
+* Leistungsmessung der Kartierung und Frontier-Suche.
+*
+* Misst die Transformation der Laserstrahlen, das Eintragen von Messungen mit
+* {\see map_draw}, die Flutung mit {\see checkForOpenSpaces} und ihre
+* kachelparallele Variante auf künstlichen Karten verschiedener Größe und
+* Wanddichte sowie auf der erfahrenen Karte, und den Durchsatz der gesamten
+* Kartierung samt Suche. Die Messungen stammen aus einer Aufzeichnung (--log)
+* oder aus einer simulierten Fahrt durch einen festen Raum, so dass
+* aufeinanderfolgende Läufe vergleichbar sind.
+*
+* Jede Messgröße wird mehrfach bestimmt und der Median berichtet. Mit --json
+* werden die Ergebnisse maschinenlesbar abgelegt, mit --baseline gegen eine
+* frühere Ablage verglichen; der Rückgabewert ist dann 2, sobald eine Größe
+* um mehr als die Toleranz schlechter ausfällt, die beiden Flutungen
+* voneinander abweichen oder ein Frontier-Cluster nicht gefunden wird.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <libgen.h>
+#include <math.h>
+#include <time.h>
+#include <libplayerc/playerc.h>
+
+#include "map.h"
+#include "grid.h"
+#include "laser.h"
+#include "frontier.h"
+#include "transforms.h"
+#include "explorer.h"
+#include "pipeline.h"
+#include "scanlog.h"
+
+/**
+* Anzahl der Wiederholungen je Messgröße
+*/
+#define BENCH_RUNS 5
+
+/**
+* Anzahl der Wiederholungen für Messgrößen über die gesamte Fahrt
+*/
+#define BENCH_SEQUENCE_RUNS 3
+
+/**
+* Anzahl der Messungen der simulierten Fahrt (zwei Runden bei 10 Hz)
+*/
+#define BENCH_SCANS 600
+
+/**
+* Standardtoleranz beim Vergleich mit der Vergleichsbasis in Prozent
+*/
+#define BENCH_TOLERANCE 15.0
+
+/**
+* Maximale Anzahl der Ergebnisse
+*/
+#define BENCH_MAX_RESULTS 32
+
+/**
+* Maximale Länge der Bezeichnung eines Ergebnisses samt Endzeichen
+*/
+#define BENCH_NAME_LENGTH 64
+
+/**
+* Ergebnis einer Messgröße
+*/
+typedef struct {
+	char name[BENCH_NAME_LENGTH];	/*! Bezeichnung */
+	const char *unit;		/*! Einheit */
+	double value;			/*! Median der Wiederholungen */
+	int higherIsBetter;		/*! Nicht-null, wenn größere Werte besser sind */
+} benchresult_t;
+
+/**
+* Wandstück der simulierten Umgebung
+*/
+typedef struct {
+	double x0, y0, x1, y1;
+} segment_t;
+
+static benchresult_t results[BENCH_MAX_RESULTS];
+static int resultCount = 0;
+
+static segment_t world[64];
+static int worldCount = 0;
+
+static volatile double sink = 0;	/* Verhindert das Wegoptimieren gemessener Schleifen */
+static int mismatches = 0;			/* Abweichungen zwischen serieller und paralleler Flutung */
+static int missedClusters = 0;		/* Nicht gefundene Frontier-Cluster */
+
+/**
+* Liefert die monotone Systemzeit.
+* \return Die Zeit in Sekunden
+*/
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static int compareDouble(const void *a, const void *b)
+{
+	const double da = *(const double*)a;
+	const double db = *(const double*)b;
+	return (da > db) - (da < db);
+}
+
+/**
+* Bestimmt den Median einer Messreihe; die Reihe wird dabei sortiert.
+* \param[inout] values Die Messwerte
+* \param[in] count Anzahl der Messwerte
+* \return Der Median
+*/
+static double median(double *values, const int count)
+{
+	qsort(values, count, sizeof(double), compareDouble);
+	return (count % 2) ? values[count/2] : 0.5*(values[count/2-1] + values[count/2]);
+}
+
+/**
+* Legt ein Ergebnis ab und gibt es aus.
+* \param[in] name Die Bezeichnung
+* \param[in] unit Die Einheit
+* \param[in] value Der Wert
+* \param[in] higherIsBetter Nicht-null, wenn größere Werte besser sind
+*/
+static void report(const char *name, const char *unit, const double value, const int higherIsBetter)
+{
+	if (resultCount >= BENCH_MAX_RESULTS) return;
+	benchresult_t *result = &results[resultCount++];
+	snprintf(result->name, sizeof(result->name), "%s", name);
+	result->unit = unit;
+	result->value = value;
+	result->higherIsBetter = higherIsBetter;
+	printf("%-44s %12.3f %s\n", name, value, unit);
+	fflush(stdout);
+}
+
+/**
+* Fügt der simulierten Umgebung ein Wandstück hinzu.
+*/
+static void addWall(const double x0, const double y0, const double x1, const double y1)
+{
+	segment_t *segment = &world[worldCount++];
+	segment->x0 = x0; segment->y0 = y0;
+	segment->x1 = x1; segment->y1 = y1;
+}
+
+/**
+* Fügt der simulierten Umgebung ein achsparalleles Rechteck hinzu.
+*/
+static void addBox(const double x0, const double y0, const double x1, const double y1)
+{
+	addWall(x0, y0, x1, y0);
+	addWall(x1, y0, x1, y1);
+	addWall(x1, y1, x0, y1);
+	addWall(x0, y1, x0, y0);
+}
+
+/**
+* Verfolgt einen Strahl durch die simulierte Umgebung.
+* \param[in] px Die X-Koordinate des Ursprungs in Weltkoordinaten
+* \param[in] py Die Y-Koordinate des Ursprungs in Weltkoordinaten
+* \param[in] angle Die Richtung in Radians
+* \return Die Entfernung zur nächsten Wand, höchstens {\see LASER_RANGE_MAX}
+*/
+static double castRay(const double px, const double py, const double angle)
+{
+	const double dx = cos(angle);
+	const double dy = sin(angle);
+	double nearest = LASER_RANGE_MAX;
+	for (int i = 0; i < worldCount; ++i)
+	{
+		const double ex = world[i].x1 - world[i].x0;
+		const double ey = world[i].y1 - world[i].y0;
+		const double denom = dx*ey - dy*ex;
+		if (fabs(denom) < 1e-12) continue;
+
+		const double wx = world[i].x0 - px;
+		const double wy = world[i].y0 - py;
+		const double t = (wx*ey - wy*ex) / denom;
+		const double u = (wx*dy - wy*dx) / denom;
+		if (t > 0 && t < nearest && u >= 0 && u <= 1) nearest = t;
+	}
+	return nearest;
+}
+
+/**
+* Erzeugt die Messungen einer Fahrt auf einer Ellipse um ein Hindernis in
+* einem 16x12 m großen Raum. Das Rauschen ist fest initialisiert.
+* \param[out] frames Die Messungen; {\see BENCH_SCANS} Einträge
+*/
+static void simulate(sensorframe_t *frames)
+{
+	worldCount = 0;
+	addBox(-8, -6, 8, 6);
+	addBox(-2, -1, 2, 1);
+	addBox(6, 4, 7, 5);
+	addBox(-7, -5, -6, -4);
+	addWall(0, 6, 0, 4.6);
+	addWall(-8, 0, -6.3, 0);
+	addWall(6.3, 0, 8, 0);
+
+	srand(42);
+	for (int i = 0; i < BENCH_SCANS; ++i)
+	{
+		const double t = i * 2*M_PI / (BENCH_SCANS/2);
+		sensorframe_t *frame = &frames[i];
+		frame->sequence = i+1;
+		frame->count = LASER_SAMPLES;
+		frame->time = i * 0.1;
+		frame->px = 5*cos(t);
+		frame->py = 3.5*sin(t);
+		frame->pa = atan2(3.5*cos(t), -5*sin(t));
+
+		for (int a = 0; a < LASER_SAMPLES; ++a)
+		{
+			const double range = castRay(frame->px, frame->py, frame->pa + a*LASER_ANGULAR_RESOLUTION_RAD + LASER_MIN_ANGLE_RAD);
+			const double noise = 0.01 * ((double)rand()/RAND_MAX - 0.5);
+			frame->ranges[a] = (range >= LASER_RANGE_MAX) ? LASER_RANGE_MAX : range + noise;
+		}
+	}
+}
+
+/**
+* Liest alle Messungen einer Aufzeichnung.
+* \param[in] path Der Dateiname
+* \param[out] count Anzahl der Messungen
+* \return Die Messungen oder NULL, wenn die Aufzeichnung nicht gelesen werden konnte
+*/
+static sensorframe_t* loadLog(const char *path, int *count)
+{
+	scanlog_reader_t log;
+	if (scanlog_open(&log, path)) return (sensorframe_t*)0;
+
+	int capacity = 1024;
+	sensorframe_t *frames = (sensorframe_t*)malloc(capacity * sizeof(sensorframe_t));
+	int status = 0;
+	*count = 0;
+	while (frames != (sensorframe_t*)0 && (status = scanlog_next(&log, &frames[*count])) > 0)
+	{
+		if (++*count == capacity)
+		{
+			capacity *= 2;
+			sensorframe_t *grown = (sensorframe_t*)realloc(frames, capacity * sizeof(sensorframe_t));
+			if (grown == (sensorframe_t*)0) free(frames);
+			frames = grown;
+		}
+	}
+	scanlog_close(&log);
+
+	if (frames != (sensorframe_t*)0 && (status < 0 || *count == 0))
+	{
+		free(frames);
+		frames = (sensorframe_t*)0;
+	}
+	return frames;
+}
+
+/**
+* Misst die Transformation einzelner Strahlen mit {\see transformLaserToMap}
+* sowie ganzer Scans mit {\see transformScanToMap}.
+*/
+static void benchTransforms(const sensorframe_t *frames, const int count)
+{
+	double beam[BENCH_RUNS], scan[BENCH_RUNS];
+	static laserscan_t transformed;
+	uint64_t beams = 0;
+
+	for (int run = 0; run < BENCH_RUNS; ++run)
+	{
+		double sum = 0;
+		beams = 0;
+		double start = now();
+		for (int i = 0; i < count; ++i)
+		{
+			playerc_ranger_t ranger;
+			playerc_position2d_t pos;
+			sensorframe_view(&frames[i], &ranger, &pos);
+			for (uint32_t a = 0; a < frames[i].count; ++a)
+			{
+				double x, y;
+				if (transformLaserToMap(a*LASER_ANGULAR_RESOLUTION_RAD + LASER_MIN_ANGLE_RAD, frames[i].ranges[a], &pos, &x, &y))
+				{
+					sum += x + y;
+				}
+				++beams;
+			}
+		}
+		beam[run] = (now() - start) * 1e9 / (beams ? beams : 1);
+
+		start = now();
+		for (int i = 0; i < count; ++i)
+		{
+			playerc_ranger_t ranger;
+			playerc_position2d_t pos;
+			sensorframe_view(&frames[i], &ranger, &pos);
+			transformScanToMap(&ranger, &pos, &transformed);
+			sum += transformed.x[0] + transformed.y[transformed.count-1];
+		}
+		scan[run] = (now() - start) * 1e6 / count;
+		sink = sum;
+	}
+
+	report("transformLaserToMap", "ns/beam", median(beam, BENCH_RUNS), 0);
+	report("transformScanToMap", "us/scan", median(scan, BENCH_RUNS), 0);
+}
+
+/**
+* Spielt alle Messungen in eine leere Karte ein.
+* \param[in] wait Nicht-null, um nach jeder Messung auf die Suche zu warten
+* \param[out] perScan Mittlere Dauer eines Aufrufs von {\see map_draw} in Sekunden
+* \return Die Gesamtdauer in Sekunden
+*/
+static double runSequence(const sensorframe_t *frames, const int count, const int wait, double *perScan)
+{
+	map_shutdown();
+
+	double mapping = 0;
+	const double start = now();
+	for (int i = 0; i < count; ++i)
+	{
+		playerc_ranger_t ranger;
+		playerc_position2d_t pos;
+		sensorframe_view(&frames[i], &ranger, &pos);
+
+		const double before = now();
+		map_draw(0, &ranger, &pos);
+		mapping += now() - before;
+		if (wait) explorer_wait();
+	}
+	const double total = now() - start;
+
+	*perScan = mapping / count;
+	return total;
+}
+
+/**
+* Misst das Eintragen der Messungen mit {\see map_draw}, während die Suche wie
+* im Betrieb nebenher läuft, sowie den Durchsatz der Kartierung, wenn jede
+* Messung eine eigene Suche erhält.
+*/
+static void benchMapping(const sensorframe_t *frames, const int count)
+{
+	double integrate[BENCH_SEQUENCE_RUNS], throughput[BENCH_SEQUENCE_RUNS];
+	for (int run = 0; run < BENCH_SEQUENCE_RUNS; ++run)
+	{
+		double perScan;
+		runSequence(frames, count, 0, &perScan);
+		explorer_wait();
+		integrate[run] = perScan * 1e6;
+
+		throughput[run] = count / runSequence(frames, count, 1, &perScan);
+	}
+
+	report("map_draw", "us/scan", median(integrate, BENCH_SEQUENCE_RUNS), 0);
+	report("end_to_end", "scans/s", median(throughput, BENCH_SEQUENCE_RUNS), 1);
+}
+
+/**
+* Misst {\see checkForOpenSpaces} und {\see checkForOpenSpacesParallel} auf
+* dem aktuellen Stand von {\see searchgrid} und vergleicht deren Ergebnisse.
+* \param[in] suffix Die Bezeichnung der Karte
+* \param[in] x Die X-Koordinate des Startpunktes in Weltkoordinaten
+* \param[in] y Die Y-Koordinate des Startpunktes in Weltkoordinaten
+*/
+static void benchOpenSpaces(const char *suffix, const double x, const double y)
+{
+	double serial[BENCH_RUNS], parallel[BENCH_RUNS];
+	double serialX = 0, serialY = 0, parallelX = 0, parallelY = 0;
+	int serialOpen = 0, parallelOpen = 0;
+	for (int run = 0; run < BENCH_RUNS; ++run)
+	{
+		double start = now();
+		serialOpen = checkForOpenSpaces(x, y, &serialX, &serialY);
+		serial[run] = (now() - start) * 1e3;
+
+		start = now();
+		parallelOpen = checkForOpenSpacesParallel(x, y, &parallelX, &parallelY);
+		parallel[run] = (now() - start) * 1e3;
+	}
+	sink = serialOpen + parallelOpen;
+
+	char name[BENCH_NAME_LENGTH];
+	snprintf(name, sizeof(name), "checkForOpenSpaces/%s", suffix);
+	report(name, "ms", median(serial, BENCH_RUNS), 0);
+	snprintf(name, sizeof(name), "checkForOpenSpacesParallel/%s", suffix);
+	report(name, "ms", median(parallel, BENCH_RUNS), 0);
+
+	if (serialOpen != parallelOpen || (serialOpen && (serialX != parallelX || serialY != parallelY)))
+	{
+		printf("Abweichung auf %s: seriell %d (%.2f, %.2f), parallel %d (%.2f, %.2f)\n", suffix,
+			serialOpen, serialX, serialY, parallelOpen, parallelX, parallelY);
+		++mismatches;
+	}
+}
+
+/**
+* Füllt {\see searchgrid} mit einer vollständig gesehenen, quadratischen
+* Karte um den Weltursprung, in die zufällige Wandstücke gesetzt werden, bis
+* der gegebene Anteil der Zellen Wand ist. Der Startpunkt bleibt frei.
+* \param[in] size Die Kantenlänge in Zellen
+* \param[in] fill Der Anteil der Wandzellen
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+static int buildSyntheticMap(const int size, const double fill)
+{
+	grid_destroy(&searchgrid);
+	if (grid_create(&searchgrid, MAP_SIZE_X, MAP_SIZE_Y)) return 1;
+
+	const int x0 = MAP_OFFS_X - size/2;
+	const int y0 = MAP_OFFS_Y - size/2;
+	for (int y = y0; y < y0+size; ++y)
+	{
+		for (int x = x0; x < x0+size; ++x)
+		{
+			if (grid_cell_alloc(&searchgrid, x, y) == (const uint8_t*)0) return 1;
+			grid_write(&searchgrid, x, y, GRID_CELL_SEEN);
+		}
+	}
+
+	srand(size);
+	const long target = (long)(fill * size * size);
+	long walls = 0;
+	while (walls < target)
+	{
+		const int horizontal = rand() & 1;
+		const int length = 2 + rand() % 8;
+		int x = x0 + rand() % size;
+		int y = y0 + rand() % size;
+		for (int i = 0; i < length && x < x0+size && y < y0+size; ++i)
+		{
+			if (abs(x - MAP_OFFS_X) > 4 || abs(y - MAP_OFFS_Y) > 4)
+			{
+				if (!(grid_get(&searchgrid, x, y) & GRID_CELL_WALL)) ++walls;
+				grid_write(&searchgrid, x, y, GRID_CELL_WALL | GRID_CELL_SEEN_HIT);
+			}
+			if (horizontal) ++x; else ++y;
+		}
+	}
+	return 0;
+}
+
+/**
+* Misst {\see checkForOpenSpaces} auf künstlichen Karten verschiedener Größe
+* und Wanddichte. Muss vor dem ersten Aufruf von {\see map_draw} erfolgen, da
+* das Suchgitter dabei ohne Such-Thread verwendet wird.
+*/
+static void benchSyntheticMaps()
+{
+	static const int sizes[] = { 256, 512, 1024 };
+	static const int fills[] = { 5, 20 };
+
+	for (unsigned s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s)
+	{
+		for (unsigned f = 0; f < sizeof(fills)/sizeof(fills[0]); ++f)
+		{
+			if (buildSyntheticMap(sizes[s], fills[f] / 100.0))
+			{
+				printf("Kein Speicher für künstliche Karte %d.\n", sizes[s]);
+				continue;
+			}
+
+			char suffix[32];
+			snprintf(suffix, sizeof(suffix), "synthetic_%d_%d", sizes[s], fills[f]);
+			benchOpenSpaces(suffix, 0, 0);
+		}
+	}
+	grid_destroy(&searchgrid);
+}
+
+/**
+* Prüft, dass {\see findBestFrontier} Frontier-Cluster in jedem Block einer
+* Kachel findet. Dazu wird in einer vollständig gesehenen Karte je eine
+* einzelne Frontier in der ersten und in der letzten Blockzeile der Kachel
+* des Startpunktes gesetzt. Wie {\see benchSyntheticMaps} vor dem ersten
+* Aufruf von {\see map_draw}.
+*/
+static void checkFrontierClusters()
+{
+	const int tileX = MAP_OFFS_X & ~GRID_TILE_MASK;
+	const int tileY = MAP_OFFS_Y & ~GRID_TILE_MASK;
+	static const int rows[] = { 0, GRID_TILE_BLOCKS-1 };
+
+	for (unsigned r = 0; r < sizeof(rows)/sizeof(rows[0]); ++r)
+	{
+		if (buildSyntheticMap(2*GRID_TILE_SIZE, 0))
+		{
+			printf("Kein Speicher für die Prüfung der Frontier-Cluster.\n");
+			++missedClusters;
+			continue;
+		}
+
+		const int x = tileX + GRID_BLOCK_SIZE/2;
+		const int y = tileY + rows[r]*GRID_BLOCK_SIZE + GRID_BLOCK_SIZE/2;
+		grid_write(&searchgrid, x, y, GRID_CELL_SEEN | GRID_CELL_FRONTIER);
+
+		double goalX, goalY;
+		const frontiercluster_t *found;
+		if (findBestFrontier(0, 0, &goalX, &goalY, (double*)0) <= 0 || frontier_clusters(&found) != 1)
+		{
+			printf("Frontier in Blockzeile %d der Kachel nicht gefunden.\n", rows[r]);
+			++missedClusters;
+		}
+	}
+	grid_destroy(&searchgrid);
+}
+
+/**
+* Schreibt die Ergebnisse als JSON.
+* \param[in] path Der Dateiname
+* \param[in] source Herkunft der Messungen
+* \param[in] scans Anzahl der Messungen
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+static int writeJson(const char *path, const char *source, const int scans)
+{
+	FILE *file = fopen(path, "w");
+	if (file == (FILE*)0) return 1;
+
+	fprintf(file, "{\n  \"source\": \"%s\",\n  \"scans\": %d,\n  \"runs\": %d,\n  \"results\": [\n", source, scans, BENCH_RUNS);
+	for (int i = 0; i < resultCount; ++i)
+	{
+		fprintf(file, "    {\"name\": \"%s\", \"unit\": \"%s\", \"value\": %.6g, \"better\": \"%s\"}%s\n",
+			results[i].name, results[i].unit, results[i].value,
+			results[i].higherIsBetter ? "higher" : "lower", (i+1 < resultCount) ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+	return fclose(file) != 0;
+}
+
+/**
+* Liest den Wert eines Ergebnisses aus einer mit {\see writeJson} erzeugten Datei.
+* \param[in] json Der Dateiinhalt
+* \param[in] name Die Bezeichnung des Ergebnisses
+* \param[out] value Der Wert
+* \return Null, wenn das Ergebnis nicht enthalten ist, -1, wenn die Bezeichnung
+* zu lang ist, ansonsten nicht-null.
+*/
+static int findBaseline(const char *json, const char *name, double *value)
+{
+	/* Eine gekürzte Bezeichnung fände auch Ergebnisse mit gleichem Anfang */
+	char key[BENCH_NAME_LENGTH + 16];
+	if (strlen(name) >= BENCH_NAME_LENGTH) return -1;
+	snprintf(key, sizeof(key), "\"name\": \"%.*s\"", BENCH_NAME_LENGTH-1, name);
+	const char *entry = strstr(json, key);
+	if (entry == (const char*)0) return 0;
+
+	const char *field = strstr(entry, "\"value\":");
+	const char *next = strchr(entry, '}');
+	if (field == (const char*)0 || (next != (const char*)0 && field > next)) return 0;
+
+	*value = strtod(field + strlen("\"value\":"), NULL);
+	return 1;
+}
+
+/**
+* Vergleicht die Ergebnisse mit einer Vergleichsbasis.
+* \param[in] path Der Dateiname der Vergleichsbasis
+* \param[in] tolerance Die zulässige Verschlechterung in Prozent
+* \return Anzahl der verschlechterten oder nicht vergleichbaren Messgrößen oder -1, wenn die
+* Vergleichsbasis nicht gelesen werden konnte
+*/
+static int compareBaseline(const char *path, const double tolerance)
+{
+	FILE *file = fopen(path, "r");
+	if (file == (FILE*)0) return -1;
+	fseek(file, 0, SEEK_END);
+	const long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	char *json = (char*)malloc(size + 1);
+	if (json == (char*)0 || fread(json, 1, size, file) != (size_t)size)
+	{
+		free(json);
+		fclose(file);
+		return -1;
+	}
+	json[size] = '\0';
+	fclose(file);
+
+	printf("\nVergleich mit %s (Toleranz %.0f%%):\n", path, tolerance);
+	int regressions = 0;
+	for (int i = 0; i < resultCount; ++i)
+	{
+		double baseline;
+		const int found = findBaseline(json, results[i].name, &baseline);
+		if (found < 0)
+		{
+			printf("%-44s Bezeichnung zu lang für den Vergleich\n", results[i].name);
+			++regressions;
+			continue;
+		}
+		if (!found || baseline <= 0)
+		{
+			printf("%-44s %12.3f %-8s (neu)\n", results[i].name, results[i].value, results[i].unit);
+			continue;
+		}
+
+		/* Positiv, wenn die Messgröße schlechter geworden ist */
+		const double change = 100.0 * (results[i].value - baseline) / baseline;
+		const double worse = results[i].higherIsBetter ? -change : change;
+		const int regressed = worse > tolerance;
+		regressions += regressed;
+		printf("%-44s %12.3f %-8s %12.3f %+7.1f%%%s\n", results[i].name, results[i].value, results[i].unit,
+			baseline, change, regressed ? "  VERSCHLECHTERT" : "");
+	}
+	free(json);
+	return regressions;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *program = basename(argv[0]);
+	const char *logPath = (const char*)0;
+	const char *jsonPath = (const char*)0;
+	const char *baselinePath = (const char*)0;
+	double tolerance = BENCH_TOLERANCE;
+
+	/* Optionen */
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--log") == 0 && i+1 < argc)
+		{
+			logPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--json") == 0 && i+1 < argc)
+		{
+			jsonPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--baseline") == 0 && i+1 < argc)
+		{
+			baselinePath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--tolerance") == 0 && i+1 < argc)
+		{
+			tolerance = atof(argv[++i]);
+		}
+		else
+		{
+			printf("Usage: %s [--log <logfile>] [--json <file>] [--baseline <file>] [--tolerance <percent>]\n", program);
+			return 1;
+		}
+	}
+
+	/* Messungen bereitstellen */
+	int count = BENCH_SCANS;
+	sensorframe_t *frames;
+	if (logPath != (const char*)0)
+	{
+		frames = loadLog(logPath, &count);
+		if (frames == (sensorframe_t*)0)
+		{
+			printf("Aufzeichnung %s kann nicht gelesen werden.\n", logPath);
+			return 1;
+		}
+	}
+	else
+	{
+		frames = (sensorframe_t*)malloc(BENCH_SCANS * sizeof(sensorframe_t));
+		if (frames == (sensorframe_t*)0) return 1;
+		simulate(frames);
+	}
+
+	map_set_headless(1);
+	map_set_quiet(1);
+
+	const sensorframe_t *last = &frames[count-1];
+	printf("%d Messungen aus %s, Median aus %d Läufen\n\n", count, logPath ? logPath : "Simulation", BENCH_RUNS);
+
+	checkFrontierClusters();
+	benchSyntheticMaps();
+	benchTransforms(frames, count);
+	benchMapping(frames, count);
+
+	/* Erfahrene Karte der letzten Fahrt; der Such-Thread ruht nach dem Warten */
+	explorer_wait();
+	grid_sync(&searchgrid, &mapgrid);
+	benchOpenSpaces("recorded", last->px, last->py);
+	map_shutdown();
+	free(frames);
+
+	int status = 0;
+	if (mismatches > 0)
+	{
+		printf("%d Abweichungen zwischen serieller und paralleler Flutung.\n", mismatches);
+		status = 2;
+	}
+	if (missedClusters > 0)
+	{
+		printf("%d Frontier-Cluster nicht gefunden.\n", missedClusters);
+		status = 2;
+	}
+
+	if (jsonPath != (const char*)0 && writeJson(jsonPath, logPath ? logPath : "simulation", count))
+	{
+		printf("%s kann nicht geschrieben werden.\n", jsonPath);
+		status = 1;
+	}
+
+	if (baselinePath != (const char*)0)
+	{
+		const int regressions = compareBaseline(baselinePath, tolerance);
+		if (regressions < 0)
+		{
+			printf("Vergleichsbasis %s kann nicht gelesen werden.\n", baselinePath);
+			status = 1;
+		}
+		else if (regressions > 0)
+		{
+			printf("%d Messgrößen verschlechtert.\n", regressions);
+			status = 2;
+		}
+	}
+	return status;
+}
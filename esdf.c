@@ -0,0 +1,415 @@
+/**
+* Inkrementelles euklidisches Distanzfeld über den Wänden der Karte.
+*/
+
+#include "esdf.h"
+#include "stdlib.h"
+#include "string.h"
+#include "math.h"
+
+/**
+* Zellmarke: Die Zelle ist eine Wand
+*/
+#define ESDF_FLAG_WALL		(0x01)
+
+/**
+* Zellmarke: Die Zelle wartet auf die anhebende Welle einer entfernten Wand
+*/
+#define ESDF_FLAG_RAISE		(0x02)
+
+/**
+* Zellmarke: Die Zelle steht mit ihrem aktuellen Abstand in der Warteschlange
+*/
+#define ESDF_FLAG_QUEUED	(0x04)
+
+/**
+* Größter geführter quadrierter Abstand; zugleich Index des letzten Eimers
+*/
+#define ESDF_MAX_SQUARED	(ESDF_MAX_DISTANCE*ESDF_MAX_DISTANCE)
+
+/**
+* Anfängliche Anzahl der Einträge eines Eimers
+*/
+#define ESDF_BUCKET_CAPACITY (64)
+
+/**
+* Mindestanzahl der Kacheln, um die das Verzeichnis je Seite wächst
+*/
+#define ESDF_GROWTH_TILES	(4)
+
+/**
+* Versätze der 8er-Nachbarschaft
+*/
+static const int neighbourX[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+static const int neighbourY[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+
+/**
+* Erzeugt ein leeres Distanzfeld ohne Wände.
+* \param[out] esdf Das Distanzfeld
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int esdf_create(esdf_t *esdf)
+{
+	memset(esdf, 0, sizeof(esdf_t));
+	esdf->buckets = (esdf_bucket_t*)calloc(ESDF_MAX_SQUARED+1, sizeof(esdf_bucket_t));
+	esdf->lowest = ESDF_MAX_SQUARED+1;
+	return esdf->buckets == (esdf_bucket_t*)0;
+}
+
+/**
+* Gibt die Kacheln frei und leert die Warteschlange.
+* \param[inout] esdf Das Distanzfeld
+*/
+static void clearField(esdf_t *esdf)
+{
+	if (esdf->tiles != (esdf_tile_t**)0)
+	{
+		for (int i = 0; i < esdf->tilesX*esdf->tilesY; ++i)
+		{
+			free(esdf->tiles[i]);
+		}
+	}
+	free(esdf->tiles);
+	esdf->tiles = (esdf_tile_t**)0;
+	esdf->tileOriginX = esdf->tileOriginY = 0;
+	esdf->tilesX = esdf->tilesY = 0;
+
+	for (int b = 0; esdf->buckets != (esdf_bucket_t*)0 && b <= ESDF_MAX_SQUARED; ++b)
+	{
+		esdf->buckets[b].count = 0;
+	}
+	esdf->lowest = ESDF_MAX_SQUARED+1;
+	esdf->pending = 0;
+	esdf->failed = 0;
+}
+
+/**
+* Gibt den Speicher des Distanzfeldes frei.
+* \param[inout] esdf Das Distanzfeld
+*/
+void esdf_destroy(esdf_t *esdf)
+{
+	clearField(esdf);
+	for (int b = 0; esdf->buckets != (esdf_bucket_t*)0 && b <= ESDF_MAX_SQUARED; ++b)
+	{
+		free(esdf->buckets[b].entries);
+	}
+	free(esdf->buckets);
+	memset(esdf, 0, sizeof(esdf_t));
+}
+
+/**
+* Vergrößert das Verzeichnis so, dass es die gegebene Kachel enthält.
+* \param[inout] esdf Das Distanzfeld
+* \param[in] tx Die X-Kachelkoordinate
+* \param[in] ty Die Y-Kachelkoordinate
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+static int growDirectory(esdf_t *esdf, const int tx, const int ty)
+{
+	int minX = tx, minY = ty, maxX = tx, maxY = ty;
+	if (esdf->tiles != (esdf_tile_t**)0)
+	{
+		minX = esdf->tileOriginX;
+		minY = esdf->tileOriginY;
+		maxX = esdf->tileOriginX + esdf->tilesX - 1;
+		maxY = esdf->tileOriginY + esdf->tilesY - 1;
+	}
+
+	/* Mit Reserve wachsen, damit Vergrößerungen selten bleiben */
+	if (tx <= minX) minX = tx - ESDF_GROWTH_TILES;
+	if (ty <= minY) minY = ty - ESDF_GROWTH_TILES;
+	if (tx >= maxX) maxX = tx + ESDF_GROWTH_TILES;
+	if (ty >= maxY) maxY = ty + ESDF_GROWTH_TILES;
+
+	const int tilesX = maxX - minX + 1;
+	const int tilesY = maxY - minY + 1;
+	esdf_tile_t **tiles = (esdf_tile_t**)calloc((size_t)tilesX*tilesY, sizeof(esdf_tile_t*));
+	if (tiles == (esdf_tile_t**)0) return 1;
+
+	/* Kacheln in das neue Verzeichnis übertragen */
+	for (int y = 0; y < esdf->tilesY; ++y)
+	{
+		memcpy(&tiles[(y + esdf->tileOriginY - minY)*tilesX + (esdf->tileOriginX - minX)],
+			&esdf->tiles[y*esdf->tilesX], esdf->tilesX*sizeof(esdf_tile_t*));
+	}
+
+	free(esdf->tiles);
+	esdf->tiles = tiles;
+	esdf->tileOriginX = minX;
+	esdf->tileOriginY = minY;
+	esdf->tilesX = tilesX;
+	esdf->tilesY = tilesY;
+	return 0;
+}
+
+/**
+* Liefert eine Zelle zum Schreiben und legt ihre Kachel bei Bedarf an.
+* \param[inout] esdf Das Distanzfeld
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Zeiger auf die Zelle oder NULL, wenn kein Speicher verfügbar war
+*/
+static esdf_cell_t* allocCell(esdf_t *esdf, const int x, const int y)
+{
+	esdf_cell_t *cell = (esdf_cell_t*)esdf_cell(esdf, x, y);
+	if (cell != (esdf_cell_t*)0) return cell;
+
+	const int tx = x >> GRID_TILE_SHIFT;
+	const int ty = y >> GRID_TILE_SHIFT;
+	if (esdf->tiles == (esdf_tile_t**)0
+	 || tx < esdf->tileOriginX || tx >= esdf->tileOriginX + esdf->tilesX
+	 || ty < esdf->tileOriginY || ty >= esdf->tileOriginY + esdf->tilesY)
+	{
+		if (growDirectory(esdf, tx, ty)) return (esdf_cell_t*)0;
+	}
+
+	esdf_tile_t *tile = (esdf_tile_t*)malloc(sizeof(esdf_tile_t));
+	if (tile == (esdf_tile_t*)0) return (esdf_cell_t*)0;
+	for (int i = 0; i < GRID_TILE_CELLS; ++i)
+	{
+		tile->cells[i].distance = ESDF_FAR;
+		tile->cells[i].wallX = ESDF_NONE;
+		tile->cells[i].wallY = ESDF_NONE;
+		tile->cells[i].flags = 0;
+	}
+
+	esdf->tiles[(ty - esdf->tileOriginY)*esdf->tilesX + (tx - esdf->tileOriginX)] = tile;
+	return &tile->cells[grid_tile_index(x, y)];
+}
+
+/**
+* Reiht eine Zelle in die Warteschlange ein.
+* \param[inout] esdf Das Distanzfeld
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \param[in] priority Der quadrierte Abstand, 0..{\see ESDF_MAX_SQUARED}
+*/
+static void push(esdf_t *esdf, const int x, const int y, const int priority)
+{
+	esdf_bucket_t *bucket = &esdf->buckets[priority];
+	if (bucket->count == bucket->capacity)
+	{
+		const int capacity = bucket->capacity ? 2*bucket->capacity : ESDF_BUCKET_CAPACITY;
+		esdf_entry_t *entries = (esdf_entry_t*)realloc(bucket->entries, capacity*sizeof(esdf_entry_t));
+		if (entries == (esdf_entry_t*)0)
+		{
+			esdf->failed = 1;
+			return;
+		}
+		bucket->entries = entries;
+		bucket->capacity = capacity;
+	}
+
+	bucket->entries[bucket->count].x = x;
+	bucket->entries[bucket->count].y = y;
+	++bucket->count;
+	++esdf->pending;
+	if (priority < esdf->lowest) esdf->lowest = priority;
+}
+
+/**
+* Setzt oder entfernt eine Wand.
+* \param[inout] esdf Das Distanzfeld
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \param[in] wall Nicht-null, wenn die Zelle eine Wand ist
+*/
+void esdf_set_wall(esdf_t *esdf, const int x, const int y, const int wall)
+{
+	esdf_cell_t *cell = wall ? allocCell(esdf, x, y) : (esdf_cell_t*)esdf_cell(esdf, x, y);
+	if (cell == (esdf_cell_t*)0)
+	{
+		/* Ohne Kachel gibt es keine zu entfernende Wand */
+		esdf->failed |= wall;
+		return;
+	}
+	if (((cell->flags & ESDF_FLAG_WALL) != 0) == (wall != 0)) return;
+
+	if (wall)
+	{
+		cell->flags = ESDF_FLAG_WALL | ESDF_FLAG_QUEUED;
+		cell->distance = 0;
+		cell->wallX = 0;
+		cell->wallY = 0;
+	}
+	else
+	{
+		cell->flags = ESDF_FLAG_RAISE;
+		cell->distance = ESDF_FAR;
+		cell->wallX = ESDF_NONE;
+		cell->wallY = ESDF_NONE;
+	}
+	push(esdf, x, y, 0);
+}
+
+/**
+* Anhebende Welle: Nachbarn, deren nächste Wand entfernt wurde, werden
+* gelöscht und selbst angehoben; Nachbarn mit gültiger Wand breiten diese
+* anschließend wieder in den gelöschten Bereich aus.
+* \param[inout] esdf Das Distanzfeld
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \param[inout] cell Die Zelle
+*/
+static void raiseWave(esdf_t *esdf, const int x, const int y, esdf_cell_t *cell)
+{
+	for (int n = 0; n < 8; ++n)
+	{
+		const int nx = x + neighbourX[n];
+		const int ny = y + neighbourY[n];
+		esdf_cell_t *neighbour = (esdf_cell_t*)esdf_cell(esdf, nx, ny);
+		if (neighbour == (esdf_cell_t*)0 || neighbour->wallX == ESDF_NONE || (neighbour->flags & ESDF_FLAG_RAISE)) continue;
+
+		const esdf_cell_t *wall = esdf_cell(esdf, nx + neighbour->wallX, ny + neighbour->wallY);
+		if (!(wall->flags & ESDF_FLAG_WALL))
+		{
+			const int distance = neighbour->distance;
+			neighbour->distance = ESDF_FAR;
+			neighbour->wallX = ESDF_NONE;
+			neighbour->wallY = ESDF_NONE;
+			neighbour->flags = (neighbour->flags & ~ESDF_FLAG_QUEUED) | ESDF_FLAG_RAISE;
+			push(esdf, nx, ny, distance);
+		}
+		else if (!(neighbour->flags & ESDF_FLAG_QUEUED))
+		{
+			/* Jede Randzelle nur einmal einreihen, auch wenn mehrere Nachbarn gelöscht wurden */
+			neighbour->flags |= ESDF_FLAG_QUEUED;
+			push(esdf, nx, ny, neighbour->distance);
+		}
+	}
+	cell->flags &= ~ESDF_FLAG_RAISE;
+}
+
+/**
+* Absenkende Welle: Die Wand einer Zelle wird an alle Nachbarn
+* weitergegeben, denen sie näher liegt als ihre bisherige.
+* \param[inout] esdf Das Distanzfeld
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \param[in] cell Die Zelle
+*/
+static void lowerWave(esdf_t *esdf, const int x, const int y, const esdf_cell_t *cell)
+{
+	const int wallX = x + cell->wallX;
+	const int wallY = y + cell->wallY;
+	for (int n = 0; n < 8; ++n)
+	{
+		const int nx = x + neighbourX[n];
+		const int ny = y + neighbourY[n];
+		const int distance = (nx - wallX)*(nx - wallX) + (ny - wallY)*(ny - wallY);
+		if (distance > ESDF_MAX_SQUARED) continue;
+
+		esdf_cell_t *neighbour = allocCell(esdf, nx, ny);
+		if (neighbour == (esdf_cell_t*)0)
+		{
+			esdf->failed = 1;
+			continue;
+		}
+		if ((neighbour->flags & ESDF_FLAG_RAISE) || distance >= neighbour->distance) continue;
+
+		neighbour->distance = (uint16_t)distance;
+		neighbour->wallX = (int8_t)(wallX - nx);
+		neighbour->wallY = (int8_t)(wallY - ny);
+		neighbour->flags |= ESDF_FLAG_QUEUED;
+		push(esdf, nx, ny, distance);
+	}
+}
+
+/**
+* Führt die Abstände nach allen gesetzten oder entfernten Wänden nach.
+* \param[inout] esdf Das Distanzfeld
+* \return Anzahl der bearbeiteten Zellen
+*/
+int esdf_update(esdf_t *esdf)
+{
+	int processed = 0;
+	while (esdf->pending > 0)
+	{
+		/* Kleinsten belegten Eimer suchen; Einträge eines Eimers in beliebiger Reihenfolge */
+		while (esdf->buckets[esdf->lowest].count == 0) ++esdf->lowest;
+		const int priority = esdf->lowest;
+		esdf_bucket_t *bucket = &esdf->buckets[priority];
+		const esdf_entry_t entry = bucket->entries[--bucket->count];
+		--esdf->pending;
+
+		esdf_cell_t *cell = (esdf_cell_t*)esdf_cell(esdf, entry.x, entry.y);
+		if (cell->flags & ESDF_FLAG_RAISE)
+		{
+			raiseWave(esdf, entry.x, entry.y, cell);
+		}
+		else if (cell->wallX != ESDF_NONE && cell->distance == priority)
+		{
+			/* Veraltete Einträge überspringen: Abstand seither verkleinert oder Wand entfernt */
+			cell->flags &= ~ESDF_FLAG_QUEUED;
+			const esdf_cell_t *wall = esdf_cell(esdf, entry.x + cell->wallX, entry.y + cell->wallY);
+			if (wall->flags & ESDF_FLAG_WALL) lowerWave(esdf, entry.x, entry.y, cell);
+		}
+		++processed;
+	}
+	esdf->lowest = ESDF_MAX_SQUARED+1;
+	return processed;
+}
+
+/**
+* Baut das Distanzfeld aus den Wänden eines Gitters neu auf.
+* \param[inout] esdf Das Distanzfeld
+* \param[in] grid Das Gitter
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int esdf_rebuild(esdf_t *esdf, const grid_t *grid)
+{
+	clearField(esdf);
+
+	/* Nur Kacheln mit Wänden betrachten */
+	for (int i = 0; i < grid->tilesX*grid->tilesY; ++i)
+	{
+		const grid_tile_t *tile = grid->tiles[i];
+		if (tile == (const grid_tile_t*)0 || tile->summary.walls == 0) continue;
+
+		const int x0 = (grid->tileOriginX + i % grid->tilesX) * GRID_TILE_SIZE;
+		const int y0 = (grid->tileOriginY + i / grid->tilesX) * GRID_TILE_SIZE;
+		for (int c = 0; c < GRID_TILE_CELLS; ++c)
+		{
+			if (tile->cells[c] & GRID_CELL_WALL)
+			{
+				esdf_set_wall(esdf, x0 + (c & GRID_TILE_MASK), y0 + (c >> GRID_TILE_SHIFT), 1);
+			}
+		}
+	}
+
+	esdf_update(esdf);
+	return esdf->failed;
+}
+
+/**
+* Liefert den Abstand einer Zelle zur nächsten Wand.
+* \param[in] esdf Das Distanzfeld
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Der Abstand in Zellen, höchstens {\see ESDF_MAX_DISTANCE}
+*/
+double esdf_distance(const esdf_t *esdf, const int x, const int y)
+{
+	const uint16_t distance = esdf_distance_squared(esdf, x, y);
+	return (distance == ESDF_FAR) ? ESDF_MAX_DISTANCE : sqrt((double)distance);
+}
+
+/**
+* Liefert die nächstgelegene Wandzelle.
+* \param[in] esdf Das Distanzfeld
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \param[out] wallX Die X-Koordinate der Wand in Kartenkoordinaten
+* \param[out] wallY Die Y-Koordinate der Wand in Kartenkoordinaten
+* \return Null, wenn keine Wand innerhalb von {\see ESDF_MAX_DISTANCE} liegt, ansonsten nicht-null.
+*/
+int esdf_nearest(const esdf_t *esdf, const int x, const int y, int *wallX, int *wallY)
+{
+	const esdf_cell_t *cell = esdf_cell(esdf, x, y);
+	if (cell == (const esdf_cell_t*)0 || cell->wallX == ESDF_NONE) return 0;
+
+	*wallX = x + cell->wallX;
+	*wallY = y + cell->wallY;
+	return 1;
+}
@@ -0,0 +1,187 @@
+/**
+* Inkrementelles euklidisches Distanzfeld über den Wänden der Karte.
+*
+* Jede Zelle kennt die nächstgelegene Wandzelle und das Quadrat ihres
+* Abstandes, so dass der Abstand zur nächsten Wand in O(1) abgefragt werden
+* kann, ohne Strahlen zu verfolgen oder die Umgebung abzusuchen.
+*
+* Wände werden mit {\see esdf_set_wall} gesetzt oder entfernt;
+* {\see esdf_update} führt anschließend nur den betroffenen Bereich nach
+* (Lau, Sprunk & Burgard, "Efficient Grid-Based Spatial Representations for
+* Robot Navigation in Dynamic Environments", 2013). Eine neue Wand breitet
+* sich als absenkende Welle aus, die endet, wo eine andere Wand näher liegt.
+* Eine entfernte Wand löscht als anhebende Welle alle Zellen, die auf sie
+* verwiesen; deren Rand breitet danach die übrigen Wände wieder hinein aus.
+* Die Wellen werden in der Reihenfolge der quadrierten Abstände über eine
+* Eimerwarteschlange abgearbeitet. Abstände über {\see ESDF_MAX_DISTANCE}
+* werden nicht geführt, was die Reichweite jeder Änderung begrenzt.
+*
+* Das Feld ist wie das Belegungsgitter in Kacheln unterteilt, die erst
+* angelegt werden, wenn eine Welle sie erreicht; nicht angelegte Kacheln
+* sind weiter als {\see ESDF_MAX_DISTANCE} von jeder Wand entfernt.
+*
+* Das Feld ist nicht threadsicher.
+*/
+
+#ifndef ESDF_H
+#define ESDF_H
+
+#include <stdint.h>
+
+#include "grid.h"
+
+/**
+* Größter geführter Abstand in Zellen (1 m, die Fluchtdistanz der Regelung)
+*/
+#define ESDF_MAX_DISTANCE (30)
+
+/**
+* Quadrierter Abstand von Zellen ohne Wand innerhalb von {\see ESDF_MAX_DISTANCE}
+*/
+#define ESDF_FAR (UINT16_MAX)
+
+/**
+* Versatz von Zellen ohne Wand innerhalb von {\see ESDF_MAX_DISTANCE}
+*/
+#define ESDF_NONE (-128)
+
+/**
+* Zelle des Distanzfeldes
+*/
+typedef struct {
+	uint16_t distance;		/*! Quadrierter Abstand zur nächsten Wand in Zellen oder {\see ESDF_FAR} */
+	int8_t wallX;			/*! Versatz der nächsten Wand in X oder {\see ESDF_NONE} */
+	int8_t wallY;			/*! Versatz der nächsten Wand in Y */
+	uint8_t flags;			/*! Wand und anhebende Welle */
+} esdf_cell_t;
+
+/**
+* Kachel des Distanzfeldes; deckt dieselben Zellen ab wie die Kachel des Gitters
+*/
+typedef struct {
+	esdf_cell_t cells[GRID_TILE_CELLS];	/*! Zeilenweise abgelegte Zellen */
+} esdf_tile_t;
+
+/**
+* Eintrag der Warteschlange
+*/
+typedef struct {
+	int32_t x;				/*! X-Koordinate in Kartenkoordinaten */
+	int32_t y;				/*! Y-Koordinate in Kartenkoordinaten */
+} esdf_entry_t;
+
+/**
+* Eimer der Warteschlange für einen quadrierten Abstand
+*/
+typedef struct {
+	esdf_entry_t *entries;	/*! Einträge in Einfügereihenfolge */
+	int count;				/*! Anzahl der Einträge */
+	int capacity;			/*! Anzahl der reservierten Einträge */
+} esdf_bucket_t;
+
+/**
+* Distanzfeld
+*/
+typedef struct {
+	int tileOriginX;		/*! X-Kachelkoordinate der ersten Verzeichnisspalte */
+	int tileOriginY;		/*! Y-Kachelkoordinate der ersten Verzeichniszeile */
+	int tilesX;				/*! Breite des Verzeichnisses in Kacheln */
+	int tilesY;				/*! Höhe des Verzeichnisses in Kacheln */
+	esdf_tile_t **tiles;	/*! Kachelverzeichnis, zeilenweise; NULL für nicht angelegte Kacheln */
+	esdf_bucket_t *buckets;	/*! Warteschlange, ein Eimer je quadriertem Abstand */
+	int lowest;				/*! Kleinster möglicherweise belegter Eimer */
+	int pending;			/*! Anzahl der Einträge der Warteschlange */
+	int failed;				/*! Nicht-null, wenn mangels Speicher Änderungen verloren gingen */
+} esdf_t;
+
+/**
+* Erzeugt ein leeres Distanzfeld ohne Wände.
+* \param[out] esdf Das Distanzfeld
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int esdf_create(esdf_t *esdf);
+
+/**
+* Gibt den Speicher des Distanzfeldes frei.
+* \param[inout] esdf Das Distanzfeld
+*/
+void esdf_destroy(esdf_t *esdf);
+
+/**
+* Setzt oder entfernt eine Wand. Die Abstände der Umgebung werden erst mit
+* {\see esdf_update} nachgeführt.
+* \param[inout] esdf Das Distanzfeld
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \param[in] wall Nicht-null, wenn die Zelle eine Wand ist
+*/
+void esdf_set_wall(esdf_t *esdf, const int x, const int y, const int wall);
+
+/**
+* Führt die Abstände nach allen seit dem letzten Aufruf gesetzten oder
+* entfernten Wänden nach.
+* \param[inout] esdf Das Distanzfeld
+* \return Anzahl der bearbeiteten Zellen
+*/
+int esdf_update(esdf_t *esdf);
+
+/**
+* Baut das Distanzfeld aus den Wänden eines Gitters neu auf, z.B. nach dem
+* Laden einer Ablage.
+* \param[inout] esdf Das Distanzfeld
+* \param[in] grid Das Gitter
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int esdf_rebuild(esdf_t *esdf, const grid_t *grid);
+
+/**
+* Liefert die Zelle des Distanzfeldes zu einer Koordinate.
+* \param[in] esdf Das Distanzfeld
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Zeiger auf die Zelle oder NULL, wenn keine Wand innerhalb von {\see ESDF_MAX_DISTANCE} liegt
+*/
+static inline const esdf_cell_t* esdf_cell(const esdf_t *const esdf, const int x, const int y)
+{
+	const unsigned tx = (unsigned)((x >> GRID_TILE_SHIFT) - esdf->tileOriginX);
+	const unsigned ty = (unsigned)((y >> GRID_TILE_SHIFT) - esdf->tileOriginY);
+	if (tx >= (unsigned)esdf->tilesX || ty >= (unsigned)esdf->tilesY) return (const esdf_cell_t*)0;
+	const esdf_tile_t *tile = esdf->tiles[ty*esdf->tilesX + tx];
+	if (tile == (const esdf_tile_t*)0) return (const esdf_cell_t*)0;
+	return &tile->cells[grid_tile_index(x, y)];
+}
+
+/**
+* Liefert den quadrierten Abstand einer Zelle zur nächsten Wand.
+* \param[in] esdf Das Distanzfeld
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Der quadrierte Abstand in Zellen oder {\see ESDF_FAR}
+*/
+static inline uint16_t esdf_distance_squared(const esdf_t *const esdf, const int x, const int y)
+{
+	const esdf_cell_t *cell = esdf_cell(esdf, x, y);
+	return (cell != (const esdf_cell_t*)0) ? cell->distance : (uint16_t)ESDF_FAR;
+}
+
+/**
+* Liefert den Abstand einer Zelle zur nächsten Wand.
+* \param[in] esdf Das Distanzfeld
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Der Abstand in Zellen, höchstens {\see ESDF_MAX_DISTANCE}
+*/
+double esdf_distance(const esdf_t *esdf, const int x, const int y);
+
+/**
+* Liefert die nächstgelegene Wandzelle.
+* \param[in] esdf Das Distanzfeld
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \param[out] wallX Die X-Koordinate der Wand in Kartenkoordinaten
+* \param[out] wallY Die Y-Koordinate der Wand in Kartenkoordinaten
+* \return Null, wenn keine Wand innerhalb von {\see ESDF_MAX_DISTANCE} liegt, ansonsten nicht-null.
+*/
+int esdf_nearest(const esdf_t *esdf, const int x, const int y, int *wallX, int *wallY);
+
+#endif
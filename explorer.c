@@ -0,0 +1,280 @@
+/**
+* Hintergrundsuche nach dem nächsten Erkundungsziel.
+*
+* Kartierung und Such-Thread teilen sich lediglich Standorte, Anfrage und
+* Ergebnisse, die über einen Mutex ausgetauscht werden. Der Schnappschuss der Karte sowie die
+* Zustände von Zielwahl, Wellenfront und Pfadplanung gehören während einer
+* Suche allein dem Such-Thread und werden nur nachgeführt, solange er ruht.
+*/
+
+#include "explorer.h"
+#include "map.h"
+#include "frontier.h"
+#include "planner.h"
+#include "metrics.h"
+#include "pthread.h"
+#include "math.h"
+#include "string.h"
+
+/**
+* Abstand des anzufahrenden Wegpunktes vom Roboter in Pfadpunkten (Zellen)
+*/
+#define EXPLORER_WAYPOINT_LOOKAHEAD 15
+
+static pthread_t searchThread;
+static pthread_mutex_t searchMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t searchCondition = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t searchFinished = PTHREAD_COND_INITIALIZER;
+static int searchRunning = 0;		/* Nicht-null, solange der Such-Thread läuft */
+static int searchPending = 0;		/* Nicht-null, solange eine Suche aussteht oder läuft */
+static double locationX[MAP_MAX_ROBOTS];	/* Zuletzt gemeldete Standorte in Weltkoordinaten */
+static double locationY[MAP_MAX_ROBOTS];
+static int located[MAP_MAX_ROBOTS];		/* Nicht-null, sobald ein Roboter seinen Standort gemeldet hat */
+static explorer_result_t latest[MAP_MAX_ROBOTS];	/* Jüngste vollständige Ergebnisse */
+static int hasResult[MAP_MAX_ROBOTS];
+static uint32_t sequence = 0;
+
+/**
+* Wählt das lohnendste Ziel und plant den Pfad dorthin.
+* \param[in] x Die X-Koordinate des Roboters in Weltkoordinaten
+* \param[in] y Die Y-Koordinate des Roboters in Weltkoordinaten
+* \param[out] result Das Ergebnis
+* \return Null, wenn die Zielwahl mangels Speicher fehlschlug, ansonsten nicht-null.
+*/
+static int explore(const double x, const double y, explorer_result_t *result)
+{
+	const int robotx = MAP_OFFS_X+(int)(MAP_SCALE*x);
+	const int roboty = MAP_OFFS_Y-(int)(MAP_SCALE*y);
+
+	/* Lohnendste erreichbare Grenze nach Informationsgewinn je Wegstrecke
+	 * bestimmen; sind alle Grenzen unerreichbar, gilt die Karte als vollständig. */
+	result->goalX = result->goalY = result->distance = 0;
+	result->frontiers = findBestFrontier(x, y, &result->goalX, &result->goalY, &result->distance);
+
+	/* Ohne Speicher für die Cluster bleiben bisheriges Ziel und Pfad bestehen;
+	 * die nächste Anfrage wiederholt die Zielwahl. */
+	if (result->frontiers < 0)
+	{
+		int goalx, goaly;
+		if (planner_goal(&goalx, &goaly)) frontier_claim(goalx, goaly);
+		return 0;
+	}
+
+	const frontiercluster_t *clusters;
+	result->clusters = frontier_clusters(&clusters);
+
+	/* Pfad zur Grenze planen. Das bisherige Ziel wird beibehalten, solange
+	 * es eine Grenze bleibt und kein anderer Roboter in seiner Nähe ein Ziel
+	 * beansprucht; der Pfad wird dann nur nachgeführt und repariert. */
+	if (result->frontiers)
+	{
+		int goalx, goaly;
+		const int keep = planner_goal(&goalx, &goaly) && (grid_get(&searchgrid, goalx, goaly) & GRID_CELL_FRONTIER)
+		              && !frontier_claimed(goalx, goaly);
+		if (!keep)
+		{
+			goalx = MAP_OFFS_X+(int)lround(MAP_SCALE*result->goalX);
+			goaly = MAP_OFFS_Y-(int)lround(MAP_SCALE*result->goalY);
+		}
+		const int planned = planner_update(robotx, roboty, goalx, goaly);
+		frontier_claim(goalx, goaly);
+
+		/* Beim beibehaltenen Ziel dieses samt verbleibender Pfadlänge melden,
+		 * damit Ausgabe und Veröffentlichung dem befahrenen Pfad entsprechen */
+		if (keep)
+		{
+			const planner_point_t *points;
+			const int length = planned ? planner_path(&points) : 0;
+			result->goalX = (goalx-MAP_OFFS_X)/MAP_SCALE;
+			result->goalY = (MAP_OFFS_Y-goaly)/MAP_SCALE;
+			result->distance = (length > 1) ? (length-1)/MAP_SCALE : 0;
+		}
+	}
+	else
+	{
+		planner_reset();
+	}
+
+	int waypointx, waypointy;
+	result->hasWaypoint = planner_waypoint(EXPLORER_WAYPOINT_LOOKAHEAD, &waypointx, &waypointy);
+	result->waypointX = result->hasWaypoint ? (waypointx-MAP_OFFS_X)/MAP_SCALE : 0;
+	result->waypointY = result->hasWaypoint ? (MAP_OFFS_Y-waypointy)/MAP_SCALE : 0;
+	return 1;
+}
+
+/**
+* Such-Thread. Wartet auf eine Anfrage und wählt außerhalb des Mutex
+* nacheinander für jeden Roboter ein Ziel. Jedes gewählte Ziel wird für die
+* übrigen Roboter beansprucht; die Reihenfolge wechselt von Runde zu Runde,
+* damit kein Roboter dauerhaft den Vorzug erhält. Anschließend werden die
+* Ergebnisse veröffentlicht.
+*/
+static void* explorer_thread(void *arg)
+{
+	pthread_mutex_lock(&searchMutex);
+	while (searchRunning)
+	{
+		if (!searchPending)
+		{
+			pthread_cond_wait(&searchCondition, &searchMutex);
+			continue;
+		}
+
+		int robots[MAP_MAX_ROBOTS];
+		double x[MAP_MAX_ROBOTS], y[MAP_MAX_ROBOTS];
+		int count = 0;
+		for (int r = 0; r < MAP_MAX_ROBOTS; ++r)
+		{
+			if (!located[r]) continue;
+			robots[count] = r;
+			x[count] = locationX[r];
+			y[count] = locationY[r];
+			++count;
+		}
+		const uint32_t round = sequence;
+		pthread_mutex_unlock(&searchMutex);
+
+		explorer_result_t result[MAP_MAX_ROBOTS];
+		int valid[MAP_MAX_ROBOTS];
+		const uint64_t started = metrics_now();
+		frontier_claims_clear();
+		for (int i = 0; i < count; ++i)
+		{
+			const int k = (i + round) % count;
+			planner_select(robots[k]);
+			valid[k] = explore(x[k], y[k], &result[k]);
+		}
+		metrics_since(METRICS_SEARCH, started);
+
+		pthread_mutex_lock(&searchMutex);
+		++sequence;
+		for (int i = 0; i < count; ++i)
+		{
+			/* Fehlgeschlagene Zielwahl: das vorige Ergebnis bleibt gültig */
+			if (!valid[i]) continue;
+			result[i].sequence = sequence;
+			latest[robots[i]] = result[i];
+			hasResult[robots[i]] = 1;
+		}
+		searchPending = 0;
+		pthread_cond_broadcast(&searchFinished);
+	}
+	pthread_mutex_unlock(&searchMutex);
+	return NULL;
+}
+
+/**
+* Startet den Such-Thread.
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int explorer_init(void)
+{
+	if (searchRunning) return 0;
+
+	searchRunning = 1;
+	searchPending = 0;
+	memset(located, 0, sizeof(located));
+	memset(hasResult, 0, sizeof(hasResult));
+	if (pthread_create(&searchThread, NULL, explorer_thread, NULL) != 0)
+	{
+		searchRunning = 0;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+* Beendet den Such-Thread.
+*/
+void explorer_shutdown(void)
+{
+	if (!searchRunning) return;
+
+	pthread_mutex_lock(&searchMutex);
+	searchRunning = 0;
+	pthread_cond_signal(&searchCondition);
+	pthread_mutex_unlock(&searchMutex);
+	pthread_join(searchThread, NULL);
+
+	searchPending = 0;
+	memset(located, 0, sizeof(located));
+	memset(hasResult, 0, sizeof(hasResult));
+}
+
+/**
+* Ermittelt, ob gerade keine Suche läuft.
+* \return Null, wenn eine Suche läuft, ansonsten nicht-null.
+*/
+int explorer_idle(void)
+{
+	pthread_mutex_lock(&searchMutex);
+	const int idle = !searchPending;
+	pthread_mutex_unlock(&searchMutex);
+	return idle;
+}
+
+/**
+* Wartet, bis die laufende Suche abgeschlossen ist.
+*/
+void explorer_wait(void)
+{
+	pthread_mutex_lock(&searchMutex);
+	while (searchPending && searchRunning)
+	{
+		pthread_cond_wait(&searchFinished, &searchMutex);
+	}
+	pthread_mutex_unlock(&searchMutex);
+}
+
+/**
+* Meldet den aktuellen Standort eines Roboters für die nächste Suche.
+* \param[in] robot Der Index des Roboters
+* \param[in] x Die X-Koordinate des Roboters in Weltkoordinaten
+* \param[in] y Die Y-Koordinate des Roboters in Weltkoordinaten
+*/
+void explorer_locate(const int robot, const double x, const double y)
+{
+	if (robot < 0 || robot >= MAP_MAX_ROBOTS) return;
+
+	pthread_mutex_lock(&searchMutex);
+	locationX[robot] = x;
+	locationY[robot] = y;
+	located[robot] = 1;
+	pthread_mutex_unlock(&searchMutex);
+}
+
+/**
+* Fordert eine Suche für alle Roboter an, die ihren Standort gemeldet haben.
+* \return Null, wenn die Anfrage verworfen wurde, ansonsten nicht-null.
+*/
+int explorer_request(void)
+{
+	/* Veraltete Anfragen nicht einreihen */
+	if (!searchRunning || !explorer_idle()) return 0;
+
+	/* Der Such-Thread ruht, der Schnappschuss darf nachgeführt werden */
+	if (grid_sync(&searchgrid, &mapgrid) < 0) return 0;
+
+	pthread_mutex_lock(&searchMutex);
+	searchPending = 1;
+	pthread_cond_signal(&searchCondition);
+	pthread_mutex_unlock(&searchMutex);
+	return 1;
+}
+
+/**
+* Liefert das jüngste vollständige Suchergebnis eines Roboters.
+* \param[in] robot Der Index des Roboters
+* \param[out] result Das Ergebnis
+* \return Null, wenn noch keine Suche für den Roboter abgeschlossen wurde, ansonsten nicht-null.
+*/
+int explorer_result(const int robot, explorer_result_t *result)
+{
+	if (robot < 0 || robot >= MAP_MAX_ROBOTS) return 0;
+
+	pthread_mutex_lock(&searchMutex);
+	const int available = hasResult[robot];
+	if (available) *result = latest[robot];
+	pthread_mutex_unlock(&searchMutex);
+	return available;
+}
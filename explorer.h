@@ -0,0 +1,92 @@
+/**
+* Hintergrundsuche nach dem nächsten Erkundungsziel.
+*
+* Zielwahl und Pfadplanung laufen in einem eigenen Thread auf einem
+* Schnappschuss der Karte ({\see searchgrid}), so dass die Kartierung nie auf
+* eine Suche wartet. Eine neue Suche wird nur gestartet, wenn die vorige
+* abgeschlossen ist; Anfragen während einer laufenden Suche werden verworfen
+* statt eingereiht. Abgefragt wird stets das jüngste vollständige Ergebnis.
+*
+* Eine Suche wählt nacheinander für jeden Roboter, der seinen Standort mit
+* {\see explorer_locate} gemeldet hat, ein eigenes Ziel. Bereits vergebene
+* Ziele werden für die folgenden Roboter beansprucht (\see frontier_claim),
+* so dass sich die Roboter auf verschiedene Grenzen verteilen.
+*/
+
+#ifndef EXPLORER_H
+#define EXPLORER_H
+
+#include <stdint.h>
+
+/**
+* Ergebnis einer abgeschlossenen Suche
+*/
+typedef struct {
+	uint32_t sequence;		/*! Laufende Nummer der Suche */
+	int frontiers;			/*! Anzahl der Frontier-Zellen; Null, wenn keine Grenze erreichbar ist */
+	int clusters;			/*! Anzahl der erreichbaren Cluster */
+	double goalX;			/*! X-Koordinate des gewählten Ziels in Weltkoordinaten */
+	double goalY;			/*! Y-Koordinate des gewählten Ziels in Weltkoordinaten */
+	double distance;		/*! Wegdistanz zum Ziel in Metern */
+	int hasWaypoint;		/*! Nicht-null, wenn ein Pfad zum Ziel existiert */
+	double waypointX;		/*! X-Koordinate des anzufahrenden Wegpunktes in Weltkoordinaten */
+	double waypointY;		/*! Y-Koordinate des anzufahrenden Wegpunktes in Weltkoordinaten */
+} explorer_result_t;
+
+/**
+* Startet den Such-Thread. Das Gitter {\see searchgrid} muss bereits angelegt sein.
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int explorer_init(void);
+
+/**
+* Beendet den Such-Thread; eine laufende Suche wird noch abgeschlossen.
+*/
+void explorer_shutdown(void);
+
+/**
+* Ermittelt, ob gerade keine Suche läuft.
+*
+* Solange dies der Fall ist und keine neue Suche angefordert wird, dürfen die
+* Zustände von Zielwahl, Wellenfront und Pfadplanung (z.B. zur Anzeige)
+* gelesen werden; sie entsprechen dann dem jüngsten Ergebnis.
+* \return Null, wenn eine Suche läuft, ansonsten nicht-null.
+*/
+int explorer_idle(void);
+
+/**
+* Wartet, bis die laufende Suche abgeschlossen ist. Dient der
+* reproduzierbaren Wiedergabe, in der jede Messung eine eigene Suche erhält;
+* im Betrieb wird nie gewartet.
+*/
+void explorer_wait(void);
+
+/**
+* Meldet den aktuellen Standort eines Roboters für die nächste Suche.
+* \param[in] robot Der Index des Roboters, 0..{\see MAP_MAX_ROBOTS}-1
+* \param[in] x Die X-Koordinate des Roboters in Weltkoordinaten
+* \param[in] y Die Y-Koordinate des Roboters in Weltkoordinaten
+*/
+void explorer_locate(const int robot, const double x, const double y);
+
+/**
+* Fordert eine Suche für alle Roboter an, die ihren Standort gemeldet haben.
+*
+* Ist der Such-Thread frei, wird der Schnappschuss auf den Stand von
+* {\see mapgrid} nachgeführt und die Suche gestartet. Läuft noch eine Suche,
+* wird die Anfrage verworfen. Die Funktion wartet in keinem Fall. Schreiben
+* mehrere Threads in die Karte, muss der Aufrufer sie für die Dauer des
+* Nachführens ausschließen.
+* \return Null, wenn die Anfrage verworfen wurde, ansonsten nicht-null.
+*/
+int explorer_request(void);
+
+/**
+* Liefert das jüngste vollständige Suchergebnis eines Roboters.
+* \param[in] robot Der Index des Roboters
+* \param[out] result Das Ergebnis
+* \return Null, wenn noch keine Suche für den Roboter abgeschlossen wurde, ansonsten nicht-null.
+*/
+int explorer_result(const int robot, explorer_result_t *result);
+
+#endif
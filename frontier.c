@@ -5,18 +5,44 @@
 * wie er z.B. unter http://www.codeproject.com/Articles/16405/Queue-Linear-Flood-Fill-A-Fast-Flood-Fill-Algorith
 * beschrieben wird.
 *
-* Hierbei wird ein zusätzliches OpenCV-Bild als Backend verwendet, in welchem auf Grenzen 
-* abgescannte Bereiche blau, sowie gefundene Grenzen weiß markiert werden.
+* Besuchte Zellen werden in einem gepackten Bitset mit einem Bit je Zelle vermerkt.
+* Jedes 64-Bit-Wort trägt eine Generationsnummer; ein Wort, dessen Generation
+* nicht der aktuellen entspricht, gilt als leer. Das Zurücksetzen vor einer Suche
+* ist damit ein einfaches Hochzählen der Generation.
+*
+* Für die Wahl des nächsten Ziels wird die inkrementell gepflegte Frontier-Menge
+* zusammen mit einem Wellenfront-Distanzfeld verwendet, so dass die Frontier mit
+* der kürzesten Wegstrecke statt der kürzesten Luftlinie gewählt wird.
 */
 
 #include "map.h"
+#include "laser.h"
+#include "frontier.h"
+#include "wavefront.h"
 #include "opencv/cv.h"
 #include "stdio.h"
 #include "stdlib.h"
 #include "math.h"
 #include "limits.h"
 
-extern IplImage* maptest;     /* Bild für den Scan-Algorithmus */
+/**
+* Bitset der im aktuellen Suchlauf besuchten Zellen
+*/
+typedef struct {
+	uint64_t *words;		/*! Ein Bit je Zelle, zeilenweise */
+	uint16_t *epochs;		/*! Generation je Wort */
+	uint16_t epoch;			/*! Aktuelle Generation */
+	int wordsPerRow;		/*! Anzahl der Wörter je Zeile */
+	int originX;			/*! X-Koordinate der ersten abgedeckten Zelle */
+	int originY;			/*! Y-Koordinate der ersten abgedeckten Zelle */
+	int width;				/*! Breite des abgedeckten Bereiches in Zellen */
+	int height;				/*! Höhe des abgedeckten Bereiches in Zellen */
+} visitedset_t;
+
+/**
+* Die besuchten Zellen des letzten Suchlaufs
+*/
+static visitedset_t visited = { (uint64_t*)0, (uint16_t*)0, 0, 0, 0, 0, 0, 0 };
 
 /**
 * Beschreibung eines Scanline-Segmentes
@@ -30,13 +56,130 @@ typedef struct {
 } scanlinerange_t;
 
 /**
-* Beschreibung einer Scanline-Kette
+* Warteschlange der noch zu erweiternden Scanlines.
+*
+* Die Warteschlange ist ein über alle Aufrufe wiederverwendetes Array, das
+* zu Beginn jeder Suche lediglich zurückgesetzt wird. Nach der ersten Suche
+* finden daher keine Heap-Allokationen mehr statt.
+*/
+typedef struct {
+	scanlinerange_t *items;	/*! Die Scanlines */
+	int head;				/*! Index der nächsten zu bearbeitenden Scanline */
+	int tail;				/*! Index hinter der zuletzt eingefügten Scanline */
+	int capacity;			/*! Kapazität des Arrays */
+} scanlinequeue_t;
+
+/**
+* Die wiederverwendete Warteschlange
+*/
+static scanlinequeue_t scanlineQueue = { (scanlinerange_t*)0, 0, 0, 0 };
+
+/**
+* Hängt eine Scanline an die Warteschlange an und vergrößert sie bei Bedarf.
+* \param[inout] queue Die Warteschlange
+* \param[in] range Die Scanline
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+static inline int enqueueScanLine(scanlinequeue_t *queue, const scanlinerange_t *range)
+{
+	if (queue->tail == queue->capacity)
+	{
+		const int capacity = (queue->capacity > 0) ? queue->capacity*2 : 4096;
+		scanlinerange_t *items = (scanlinerange_t*)realloc(queue->items, capacity*sizeof(scanlinerange_t));
+		if (items == (scanlinerange_t*)0) return 1;
+		queue->items = items;
+		queue->capacity = capacity;
+	}
+	queue->items[queue->tail++] = *range;
+	return 0;
+}
+
+
+/**
+* Ermittelt, ob eine Zelle des Suchgitters kartiert ist.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Null, wenn die Zelle unkartiert ist, ansonsten nicht-null.
+*/
+static inline int isSearchCharted(const int x, const int y)
+{
+	return (grid_get(&searchgrid, x, y) & GRID_CELL_CHARTED) != 0;
+}
+
+/**
+* Ermittelt, ob eine Zelle des Suchgitters eine Wand ist.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Null, wenn die Zelle keine Wand ist, ansonsten nicht-null.
+*/
+static inline int isSearchWall(const int x, const int y)
+{
+	return (grid_get(&searchgrid, x, y) & GRID_CELL_WALL) != 0;
+}
+
+/**
+* Passt das Bitset an die aktuelle Ausdehnung des Gitters an.
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+static int fitVisitedToGrid()
+{
+	if (visited.words != (uint64_t*)0
+	 && visited.originX == searchgrid.originX && visited.originY == searchgrid.originY
+	 && visited.width == searchgrid.width && visited.height == searchgrid.height)
+	{
+		return 0;
+	}
+
+	free(visited.words);
+	free(visited.epochs);
+	visited.originX = searchgrid.originX;
+	visited.originY = searchgrid.originY;
+	visited.width   = searchgrid.width;
+	visited.height  = searchgrid.height;
+	visited.wordsPerRow = (visited.width + 63) / 64;
+	visited.words  = (uint64_t*)malloc((size_t)visited.wordsPerRow*visited.height*sizeof(uint64_t));
+	visited.epochs = (uint16_t*)calloc((size_t)visited.wordsPerRow*visited.height, sizeof(uint16_t));
+	visited.epoch  = 0;
+	return visited.words == (uint64_t*)0 || visited.epochs == (uint16_t*)0;
+}
+
+/**
+* Setzt alle Zellen auf unbesucht zurück, indem die Generation erhöht wird.
+*/
+static inline void clearVisited()
+{
+	if (++visited.epoch == 0)
+	{
+		/* Überlauf: Generationen einmalig tatsächlich löschen */
+		memset(visited.epochs, 0, (size_t)visited.wordsPerRow*visited.height*sizeof(uint16_t));
+		visited.epoch = 1;
+	}
+}
+
+/**
+* Ermittelt, ob eine Koordinate innerhalb des Bitsets liegt.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Null, wenn die Koordinate außerhalb liegt, ansonsten nicht-null.
 */
-typedef struct _scanlinerange_chain {
-	scanlinerange_t scanline;		/*! Die Scanline */
-	_scanlinerange_chain *next;	/*! Zeiger auf die nächste Scanline */
-} scanlinerange_chain_t;
+static inline int isInVisitedSet(const int x, const int y)
+{
+	return (unsigned)(x - visited.originX) < (unsigned)visited.width
+		&& (unsigned)(y - visited.originY) < (unsigned)visited.height;
+}
 
+/**
+* Ermittelt, ob eine Zelle im aktuellen Suchlauf besucht wurde (ohne Bereichsprüfung).
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Null, wenn die Zelle unbesucht ist, ansonsten nicht-null.
+*/
+static inline int isVisited(const int x, const int y)
+{
+	const int rx = x - visited.originX;
+	const int word = (y - visited.originY)*visited.wordsPerRow + (rx >> 6);
+	return (visited.epochs[word] == visited.epoch) && ((visited.words[word] >> (rx & 63)) & 1);
+}
 
 /**
 * Ermittelt, ob eine Koordinate betrachtet werden muss.
@@ -46,30 +189,54 @@ typedef struct _scanlinerange_chain {
 */
 static inline int shouldBeVisited(const int x, const int y)
 {
-	if (x < 0 || x >= MAP_SIZE_X) return 0;
-	if (y < 0 || y >= MAP_SIZE_Y) return 0;
-	const CvScalar s = cvGet2D(maptest, y, x);
-	return (s.val[0] == 0) && !isWall(x, y);
+	if (!isInVisitedSet(x, y)) return 0;
+	return !isVisited(x, y) && !isSearchWall(x, y);
 }
 
 /**
-* Ermittelt, ob eine Koordinate betrachtet werden muss.
+* Markiert eine Koordinate als besucht.
 * \param[in] x Die X-Koordinate in Kartenkoordinaten
 * \param[in] y Die Y-Koordinate in Kartenkoordinaten
 * \return Null, wenn die Koordinate ungültig war, ansonsten nicht-null.
 */
-static inline int markAsVisited(const int x, const int y, const int isCharted)
+static inline int markAsVisited(const int x, const int y)
 {
-	if (x < 0 || x >= MAP_SIZE_X) return 0;
-	if (y < 0 || y >= MAP_SIZE_Y) return 0;
-	cvSet2D(maptest, y, x, CV_RGB((isCharted == 0 ? MAX_GRAY : 0), (isCharted == 0 ? MAX_GRAY : 0), (isCharted == 0 ? MAX_GRAY : 64)));
+	if (!isInVisitedSet(x, y)) return 0;
 
-#if 0
-	cvShowImage(testwin, maptest);
-	cvWaitKey(1);
-#endif
+	const int rx = x - visited.originX;
+	const int word = (y - visited.originY)*visited.wordsPerRow + (rx >> 6);
+	if (visited.epochs[word] != visited.epoch)
+	{
+		visited.epochs[word] = visited.epoch;
+		visited.words[word] = 0;
+	}
+	visited.words[word] |= (uint64_t)1 << (rx & 63);
+	return 1;
+}
 
-	return 0;
+/**
+* Markiert einen vollständigen, am Block ausgerichteten Zellbereich einer Zeile
+* als besucht, sofern keine seiner Zellen bereits besucht wurde.
+* \param[in] x Die X-Koordinate der ersten Zelle (Vielfaches von {\see GRID_BLOCK_SIZE})
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Null, wenn bereits eine Zelle besucht war, ansonsten nicht-null.
+*/
+static inline int markBlockRowAsVisited(const int x, const int y)
+{
+	const int rx = x - visited.originX;
+	const int word = (y - visited.originY)*visited.wordsPerRow + (rx >> 6);
+	const uint64_t mask = (((uint64_t)1 << GRID_BLOCK_SIZE) - 1) << (rx & 63);
+	if (visited.epochs[word] != visited.epoch)
+	{
+		visited.epochs[word] = visited.epoch;
+		visited.words[word] = 0;
+	}
+	else if (visited.words[word] & mask)
+	{
+		return 0;
+	}
+	visited.words[word] |= mask;
+	return 1;
 }
 
 /**
@@ -87,18 +254,27 @@ int buildScanLine(const int scanStartX, const int scanStartY, scanlinerange_t *r
 	int rightUncharted = 0;
 
 	/* Links scannen für Beginn der Scanline */
-	for (int x = scanStartX; x >= 0; --x)
+	for (int x = scanStartX; x >= visited.originX; --x)
 	{
+		/* Vollständig kartierte, wandfreie Blöcke in einem Schritt übernehmen */
+		if ((x & GRID_BLOCK_MASK) == GRID_BLOCK_MASK
+		 && grid_block_is_open(&searchgrid, x, scanStartY) && markBlockRowAsVisited(x-GRID_BLOCK_MASK, scanStartY))
+		{
+			x -= GRID_BLOCK_MASK;
+			startX = x;
+			continue;
+		}
+
 		if (!shouldBeVisited(x, scanStartY)) 
 		{
 			break;
 		}
 
 		/* überprüfen, ob Ort unkartiert */
-		int charted = isCharted(x, scanStartY);
+		int charted = isSearchCharted(x, scanStartY);
 
 		/* als besucht markieren und fortfahren */
-		markAsVisited(x, scanStartY, charted);
+		markAsVisited(x, scanStartY);
 
 		if (!charted)
 		{
@@ -109,18 +285,27 @@ int buildScanLine(const int scanStartX, const int scanStartY, scanlinerange_t *r
 	}
 
 	/* Rechts scannen für Beginn der Scanline */
-	for (int x = scanStartX+1; x < MAP_SIZE_X; ++x)
+	for (int x = scanStartX+1; x < visited.originX + visited.width; ++x)
 	{
+		/* Vollständig kartierte, wandfreie Blöcke in einem Schritt übernehmen */
+		if ((x & GRID_BLOCK_MASK) == 0
+		 && grid_block_is_open(&searchgrid, x, scanStartY) && markBlockRowAsVisited(x, scanStartY))
+		{
+			x += GRID_BLOCK_MASK;
+			endX = x;
+			continue;
+		}
+
 		if (!shouldBeVisited(x, scanStartY)) 
 		{
 			break;
 		}
 
 		/* überprüfen, ob Ort unkartiert */
-		int charted = isCharted(x, scanStartY);
+		int charted = isSearchCharted(x, scanStartY);
 
 		/* als besucht markieren und fortfahren */
-		markAsVisited(x, scanStartY, charted);
+		markAsVisited(x, scanStartY);
 
 		if (!charted)
 		{
@@ -156,6 +341,7 @@ static inline int getDistance(const int referenceX, const int referenceY, const
 
 /**
 * Vergleicht zwei Punkte bezüglich eines Referenzpunktes und liefert den näheren, sowie die Distanz.
+* Bei gleicher Distanz gilt der Punkt mit kleinerer Y-, dann X-Koordinate als näher.
 * \param[in] referenceX Referenz-X-Koordinate
 * \param[in] referenceY Referenz-Y-Koordinate
 * \param[in] testX X-Koordinate 1
@@ -168,7 +354,11 @@ static inline int getNearest(const int referenceX, const int referenceY, const i
 {
 	const int testDistance = getDistance(referenceX, referenceY, testX, testY);
 	const int distance     = getDistance(referenceX, referenceY, secondX, secondY);
-	if (testDistance < distance)
+
+	/* Bei gleicher Distanz gewinnt der Punkt mit kleinerem {y,x}, damit das
+	 * Ergebnis nicht von der Besuchsreihenfolge abhängt */
+	if (testDistance < distance
+	 || (testDistance == distance && (testY < secondY || (testY == secondY && testX < secondX))))
 	{
 		secondX = testX;
 		secondY = testY;
@@ -179,27 +369,39 @@ static inline int getNearest(const int referenceX, const int referenceY, const i
 
 /**
 * Erzeugt neue Scanlines im Bereich {\see startX}..{\see endX} in der gegebenen Y-Koordinate
-* und hängt sie in die gegebene linked list ein.
+* und hängt sie an die gegebene Warteschlange an.
 * \param[in] startX Start-X-Koordinate
 * \param[in] endX   End-X-Koordinate
 * \param[in] y      Neue Y-Koordinate
 * \param[in] mapx   Aktuelle X-Koordinate des Roboters auf der Karte
 * \param[in] mapy   Aktuelle Y-Koordinate des Roboters auf der Karte
-* \param[inout] tail Tail der linked list
+* \param[inout] queue Die Warteschlange
 * \param[inout] nearestUnchartedX X-Koordinate des nähesten unkartierten Punktes
 * \param[inout] nearestUnchartedY Y-Koordinate des nähesten unkartierten Punktes
 * \param[out]   distanceToNearestUncharted Distanz zum nähesten unkartierten Punkt
-* \return Anzahl der gefundenen, unkartierten Punkte in den neuen Scanline-Segmenten.
+* \return Anzahl der gefundenen, unkartierten Punkte in den neuen Scanline-Segmenten
+*         oder -1, wenn die Warteschlange nicht vergrößert werden konnte.
 */
-uint32_t extendScanLine(const int startX, const int endX, const int y, const int mapx, const int mapy, scanlinerange_chain_t **tail, int *nearestUnchartedX, int *nearestUnchartedY, int *distanceToNearestUncharted)
+int extendScanLine(const int startX, const int endX, const int y, const int mapx, const int mapy, scanlinequeue_t *queue, int *nearestUnchartedX, int *nearestUnchartedY, int *distanceToNearestUncharted)
 {
 	scanlinerange_t range;
-	uint32_t foundUncharted = 0;
+	int foundUncharted = 0;
 
 	for (int x = startX; x <= endX; ++x)
 	{
 		/* neue Scanline bilden, wenn noch nicht besucht */
 		if (!shouldBeVisited(x, y)) continue;
+
+		/* Unkartierte Nachbarn werden nur gezählt; eine dort beginnende
+		 * Scanline würde die Flutung durch das Unbekannte fortsetzen */
+		if (!isSearchCharted(x, y))
+		{
+			markAsVisited(x, y);
+			++foundUncharted;
+			*distanceToNearestUncharted = getNearest(mapx, mapy, x, y, *nearestUnchartedX, *nearestUnchartedY);
+			continue;
+		}
+
 		uint32_t unchartedCount = buildScanLine(x, y, &range);
 		assert(range.y == y);
 
@@ -210,23 +412,16 @@ uint32_t extendScanLine(const int startX, const int endX, const int y, const int
 
 			if (range.leftUncharted)
 			{
-				*distanceToNearestUncharted = getNearest(mapx, mapy, range.startx, range.y, *nearestUnchartedX, *nearestUnchartedY);
+				*distanceToNearestUncharted = getNearest(mapx, mapy, range.startx-1, range.y, *nearestUnchartedX, *nearestUnchartedY);
 			}
 			if (range.rightUncharted)
 			{
-				*distanceToNearestUncharted = getNearest(mapx, mapy, range.endx, range.y, *nearestUnchartedX, *nearestUnchartedY);
+				*distanceToNearestUncharted = getNearest(mapx, mapy, range.endx+1, range.y, *nearestUnchartedX, *nearestUnchartedY);
 			}
 		}
 
-		/* Registrierung verhindern, da sonst bleedout in vertikaler Richtung*/
-		if (range.startx == range.endx) continue;
-
 		/* Scanline eintüten */
-		scanlinerange_chain_t *item = (scanlinerange_chain_t*)malloc(sizeof(scanlinerange_chain_t));
-		memcpy(&item->scanline, &range, sizeof(scanlinerange_t));
-		item->next = (*tail)->next;
-		(*tail)->next = item;
-		(*tail) = item;
+		if (enqueueScanLine(queue, &range)) return -1;
 	}
 
 	return foundUncharted;
@@ -243,8 +438,9 @@ uint32_t extendScanLine(const int startX, const int endX, const int y, const int
 *
 * \param[in] startX Die X-Koordinate des Startpunktes in Weltkoordinaten
 * \param[in] startY Die Y-Koordinate des Startpunktes in Weltkoordinaten
-* \return Null, wenn die Karte voll abgedeckt ist oder nicht-Null, 
-*         wenn offene Bereiche existieren.
+* \return Null, wenn die Karte voll abgedeckt ist, -1, wenn kein Speicher
+*         verfügbar war, oder die Anzahl der unkartierten Zellen, wenn offene
+*         Bereiche existieren.
 */
 int checkForOpenSpaces(const double startX, const double startY, double *outNearestX, double* outNearestY)
 {
@@ -258,8 +454,23 @@ int checkForOpenSpaces(const double startX, const double startY, double *outNear
 	int nearestUnchartedY = INT_MAX/4;
 	int distanceToNearestUncharted = 0;
 
-	/* Testtabelle leeren */
-	cvZero(maptest);
+	/* Besuchte Zellen zurücksetzen */
+	if (fitVisitedToGrid()) return -1;
+	clearVisited();
+
+	/* Außerhalb der Karte oder in einer Wand wird nicht geflutet */
+	if (!shouldBeVisited(mapx, mapy)) return 0;
+
+	/* Steht der Roboter selbst im Unbekannten, ist er an der Grenze */
+	if (!isSearchCharted(mapx, mapy))
+	{
+		if (outNearestX != (double*)0 && outNearestY != (double*)0)
+		{
+			*outNearestX = (mapx-MAP_OFFS_X)/MAP_SCALE;
+			*outNearestY = (MAP_OFFS_Y-mapy)/MAP_SCALE;
+		}
+		return 1;
+	}
 
 	/* Erste Scanline erzeugen */
 	scanlinerange_t range;
@@ -275,46 +486,41 @@ int checkForOpenSpaces(const double startX, const double startY, double *outNear
 
 		if (range.leftUncharted)
 		{
-			distanceToNearestUncharted = getNearest(mapx, mapy, range.startx, range.y, nearestUnchartedX, nearestUnchartedY);
+			distanceToNearestUncharted = getNearest(mapx, mapy, range.startx-1, range.y, nearestUnchartedX, nearestUnchartedY);
 		}
 		if (range.rightUncharted)
 		{
-			distanceToNearestUncharted = getNearest(mapx, mapy, range.endx, range.y, nearestUnchartedX, nearestUnchartedY);
+			distanceToNearestUncharted = getNearest(mapx, mapy, range.endx+1, range.y, nearestUnchartedX, nearestUnchartedY);
 		}
 	}
 
-	/* Ersten Scanline-Queueintrag erzeugen */
-	scanlinerange_chain_t *head = (scanlinerange_chain_t*)malloc(sizeof(scanlinerange_chain_t));
-	memcpy(&head->scanline, &range, sizeof(scanlinerange_t));
-	head->next = (scanlinerange_chain_t*)0x0;
-	scanlinerange_chain_t *tail = head;
+	/* Warteschlange zurücksetzen und ersten Eintrag erzeugen */
+	scanlinequeue_t *queue = &scanlineQueue;
+	queue->head = queue->tail = 0;
+	if (enqueueScanLine(queue, &range)) return -1;
 
 	/* solange durchlaufen, bis queue leer wird */
-	while (head != (scanlinerange_chain_t*)0x0)
+	while (queue->head != queue->tail)
 	{
-		/* Scanline-Werte extrahieren */		
-		const int startX = head->scanline.startx;
-		const int endX   = head->scanline.endx;
-		const int y      = head->scanline.y;
+		/* Scanline-Werte extrahieren; das Array kann beim Erweitern verschoben werden */		
+		const scanlinerange_t current = queue->items[queue->head++];
+		const int startX = current.startx;
+		const int endX   = current.endx;
+		const int y      = current.y;
 
 		/* Obere Scanline erweitern */
-		foundUncharted += extendScanLine(startX, endX, y-1, mapx, mapy, &tail, 
+		const int above = extendScanLine(startX, endX, y-1, mapx, mapy, queue, 
 										 &nearestUnchartedX, &nearestUnchartedY, &distanceToNearestUncharted);
+		if (above < 0) return -1;
 		
 		/* Untere Scanline erweitern */
-		foundUncharted += extendScanLine(startX, endX, y+1, mapx, mapy, &tail, 
+		const int below = extendScanLine(startX, endX, y+1, mapx, mapy, queue, 
 										 &nearestUnchartedX, &nearestUnchartedY, &distanceToNearestUncharted);
+		if (below < 0) return -1;
 
-		/* Nächste Scanline sichern und head freigeben */
-		scanlinerange_chain_t* next = head->next;
-		memset(head, 0, sizeof(scanlinerange_chain_t));
-		free(head);
-		head = next;
+		foundUncharted += above + below;
 	}
 
-	/* Aufräumen */
-	assert (head == (scanlinerange_chain_t*)0x0);
-
 	/* Punkte ausgeben */
 	if (foundUncharted)
 	{
@@ -346,3 +552,1074 @@ int checkForOpenSpaces(const double startX, const double startY, double *outNear
 	return foundUncharted;
 }
 
+
+/**
+* Beschriftung der Zusammenhangskomponenten für {\see checkForOpenSpacesParallel}.
+*
+* Jede Zelle des Kachelverzeichnisses besitzt einen Eintrag; die Einträge einer
+* Kachel liegen zusammenhängend, so dass beim Beschriften jeder Thread nur
+* seinen eigenen Speicherbereich beschreibt. Nicht begehbare Zellen tragen -1.
+*/
+typedef struct {
+	int32_t *parent;		/*! Union-Find-Vorgänger je Zelle */
+	int32_t *component;		/*! Wurzel der Komponente je Zelle nach dem Zusammenführen */
+	int capacity;			/*! Anzahl der Einträge */
+} componentlabels_t;
+
+/**
+* Die wiederverwendete Beschriftung
+*/
+static componentlabels_t labels = { (int32_t*)0, (int32_t*)0, 0 };
+
+/**
+* Passt die Beschriftung an die aktuelle Größe des Kachelverzeichnisses an.
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+static int fitLabelsToGrid()
+{
+	const int cells = searchgrid.tilesX*searchgrid.tilesY*GRID_TILE_CELLS;
+	if (cells <= labels.capacity) return 0;
+
+	free(labels.parent);
+	free(labels.component);
+	labels.parent    = (int32_t*)malloc((size_t)cells*sizeof(int32_t));
+	labels.component = (int32_t*)malloc((size_t)cells*sizeof(int32_t));
+	labels.capacity  = cells;
+	if (labels.parent == (int32_t*)0 || labels.component == (int32_t*)0)
+	{
+		free(labels.parent);
+		free(labels.component);
+		labels.parent = labels.component = (int32_t*)0;
+		labels.capacity = 0;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+* Ermittelt die Wurzel eines Eintrages und halbiert dabei den Pfad.
+* \param[in] i Der Eintrag
+* \return Die Wurzel
+*/
+static inline int32_t findLabelRoot(int32_t i)
+{
+	while (labels.parent[i] != i)
+	{
+		labels.parent[i] = labels.parent[labels.parent[i]];
+		i = labels.parent[i];
+	}
+	return i;
+}
+
+/**
+* Vereinigt die Komponenten zweier Einträge; die kleinere Wurzel bleibt erhalten.
+* \param[in] a Der erste Eintrag
+* \param[in] b Der zweite Eintrag
+*/
+static inline void uniteLabels(const int32_t a, const int32_t b)
+{
+	const int32_t rootA = findLabelRoot(a);
+	const int32_t rootB = findLabelRoot(b);
+	if (rootA < rootB) labels.parent[rootB] = rootA;
+	else if (rootB < rootA) labels.parent[rootA] = rootB;
+}
+
+/**
+* Ermittelt, ob eine Zelle begehbar, d.h. kartiert und keine Wand ist.
+* \param[in] cell Der Zellzustand
+* \return Null, wenn die Zelle nicht begehbar ist, ansonsten nicht-null.
+*/
+static inline int isPassableCell(const uint8_t cell)
+{
+	return (cell & GRID_CELL_CHARTED) && !(cell & GRID_CELL_WALL);
+}
+
+/**
+* Beschriftet die begehbaren Zellen einer Kachel nach ihrem Zusammenhang
+* innerhalb der Kachel. Beschreibt nur die Einträge der eigenen Kachel und
+* kann daher parallel für alle Kacheln aufgerufen werden.
+* \param[in] t Der Index der Kachel im Verzeichnis
+*/
+static void labelTile(const int t)
+{
+	const grid_tile_t *tile = searchgrid.tiles[t];
+	if (tile == (const grid_tile_t*)0) return;
+
+	const int32_t base = t*GRID_TILE_CELLS;
+	int32_t *parent = &labels.parent[base];
+
+	/* Vollständig kartierte, wandfreie Kacheln bilden eine einzige Komponente */
+	if (tile->summary.charted == GRID_TILE_CELLS && tile->summary.walls == 0)
+	{
+		for (int i = 0; i < GRID_TILE_CELLS; ++i) parent[i] = base;
+		return;
+	}
+
+	for (int i = 0; i < GRID_TILE_CELLS; ++i)
+	{
+		if (!isPassableCell(tile->cells[i]))
+		{
+			parent[i] = -1;
+			continue;
+		}
+
+		/* Innerhalb einer Zeile genügt der Verweis auf den linken Nachbarn */
+		const int hasLeft = (i & GRID_TILE_MASK) != 0 && parent[i-1] >= 0;
+		parent[i] = hasLeft ? parent[i-1] : base + i;
+		if (i >= GRID_TILE_SIZE && parent[i-GRID_TILE_SIZE] >= 0)
+		{
+			uniteLabels(base + i, base + i - GRID_TILE_SIZE);
+		}
+	}
+}
+
+/**
+* Vereinigt die Komponenten benachbarter Kacheln entlang ihrer Ränder.
+*/
+static void mergeTileBorders()
+{
+	for (int ty = 0; ty < searchgrid.tilesY; ++ty)
+	{
+		for (int tx = 0; tx < searchgrid.tilesX; ++tx)
+		{
+			const int t = ty*searchgrid.tilesX + tx;
+			if (searchgrid.tiles[t] == (grid_tile_t*)0) continue;
+			const int32_t base = t*GRID_TILE_CELLS;
+
+			/* Rechter Rand gegen linken Rand der rechten Nachbarkachel */
+			if (tx+1 < searchgrid.tilesX && searchgrid.tiles[t+1] != (grid_tile_t*)0)
+			{
+				const int32_t right = base + GRID_TILE_CELLS;
+				for (int y = 0; y < GRID_TILE_SIZE; ++y)
+				{
+					const int32_t a = base + y*GRID_TILE_SIZE + GRID_TILE_MASK;
+					const int32_t b = right + y*GRID_TILE_SIZE;
+					if (labels.parent[a] >= 0 && labels.parent[b] >= 0) uniteLabels(a, b);
+				}
+			}
+
+			/* Unterer Rand gegen oberen Rand der unteren Nachbarkachel */
+			if (ty+1 < searchgrid.tilesY && searchgrid.tiles[t+searchgrid.tilesX] != (grid_tile_t*)0)
+			{
+				const int32_t below = (t+searchgrid.tilesX)*GRID_TILE_CELLS;
+				for (int x = 0; x < GRID_TILE_SIZE; ++x)
+				{
+					const int32_t a = base + GRID_TILE_MASK*GRID_TILE_SIZE + x;
+					const int32_t b = below + x;
+					if (labels.parent[a] >= 0 && labels.parent[b] >= 0) uniteLabels(a, b);
+				}
+			}
+		}
+	}
+}
+
+/**
+* Überträgt die Wurzel jedes Eintrages einer Kachel in {\see componentlabels_t::component}.
+* Liest die Vorgänger nur und kann daher parallel für alle Kacheln aufgerufen werden.
+* \param[in] t Der Index der Kachel im Verzeichnis
+*/
+static void resolveTile(const int t)
+{
+	if (searchgrid.tiles[t] == (grid_tile_t*)0) return;
+
+	const int32_t base = t*GRID_TILE_CELLS;
+	for (int32_t i = base; i < base + GRID_TILE_CELLS; ++i)
+	{
+		int32_t root = labels.parent[i];
+		if (root >= 0)
+		{
+			while (labels.parent[root] != root) root = labels.parent[root];
+		}
+		labels.component[i] = root;
+	}
+}
+
+/**
+* Liefert die Komponente einer Zelle.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Die Wurzel der Komponente oder -1, wenn die Zelle nicht begehbar ist
+*/
+static inline int32_t componentAt(const int x, const int y)
+{
+	const unsigned tx = (unsigned)((x >> GRID_TILE_SHIFT) - searchgrid.tileOriginX);
+	const unsigned ty = (unsigned)((y >> GRID_TILE_SHIFT) - searchgrid.tileOriginY);
+	if (tx >= (unsigned)searchgrid.tilesX || ty >= (unsigned)searchgrid.tilesY) return -1;
+
+	const int t = ty*searchgrid.tilesX + tx;
+	if (searchgrid.tiles[t] == (grid_tile_t*)0) return -1;
+	return labels.component[t*GRID_TILE_CELLS + grid_tile_index(x, y)];
+}
+
+/**
+* Zählt die unkartierten Zellen einer Kachel, die an die gegebene Komponente grenzen.
+* \param[in] t Der Index der Kachel im Verzeichnis
+* \param[in] root Die Wurzel der Komponente
+* \param[in] mapx Die X-Koordinate des Startpunktes in Kartenkoordinaten
+* \param[in] mapy Die Y-Koordinate des Startpunktes in Kartenkoordinaten
+* \param[inout] nearestX X-Koordinate des nähesten unkartierten Punktes
+* \param[inout] nearestY Y-Koordinate des nähesten unkartierten Punktes
+* \return Anzahl der angrenzenden unkartierten Zellen
+*/
+static int countTileBoundary(const int t, const int32_t root, const int mapx, const int mapy, int *nearestX, int *nearestY)
+{
+	const grid_tile_t *tile = searchgrid.tiles[t];
+	if (tile != (const grid_tile_t*)0 && tile->summary.charted == GRID_TILE_CELLS) return 0;
+
+	const int originX = (searchgrid.tileOriginX + t % searchgrid.tilesX) << GRID_TILE_SHIFT;
+	const int originY = (searchgrid.tileOriginY + t / searchgrid.tilesX) << GRID_TILE_SHIFT;
+
+	int found = 0;
+	for (int y = 0; y < GRID_TILE_SIZE; ++y)
+	{
+		for (int x = 0; x < GRID_TILE_SIZE; ++x)
+		{
+			/* Das Innere nicht angelegter Kacheln grenzt an keine begehbare Zelle */
+			if (tile == (const grid_tile_t*)0 && x == 1 && y > 0 && y < GRID_TILE_MASK)
+			{
+				x = GRID_TILE_MASK;
+			}
+			else if (tile != (const grid_tile_t*)0 && (tile->cells[(y << GRID_TILE_SHIFT) | x] & GRID_CELL_CHARTED))
+			{
+				continue;
+			}
+
+			const int cx = originX + x;
+			const int cy = originY + y;
+			if (componentAt(cx-1, cy) == root || componentAt(cx+1, cy) == root
+			 || componentAt(cx, cy-1) == root || componentAt(cx, cy+1) == root)
+			{
+				++found;
+				getNearest(mapx, mapy, cx, cy, *nearestX, *nearestY);
+			}
+		}
+	}
+	return found;
+}
+
+/**
+* Überprüft parallel, ob die Karte offene Bereiche beinhaltet.
+* \param[in] startX Die X-Koordinate des Startpunktes in Weltkoordinaten
+* \param[in] startY Die Y-Koordinate des Startpunktes in Weltkoordinaten
+* \param[out] outNearestX Die X-Koordinate des nähesten unkartierten Punktes in Weltkoordinaten
+* \param[out] outNearestY Die Y-Koordinate des nähesten unkartierten Punktes in Weltkoordinaten
+* \return Die Anzahl der an den erreichbaren Bereich grenzenden unkartierten Zellen
+*/
+int checkForOpenSpacesParallel(const double startX, const double startY, double *outNearestX, double *outNearestY)
+{
+	const int mapy = MAP_OFFS_Y-(int)(MAP_SCALE*startY);
+	const int mapx = MAP_OFFS_X+(int)(MAP_SCALE*startX);
+
+	/* Außerhalb der Karte oder in einer Wand wird nicht geflutet */
+	if ((unsigned)(mapx - searchgrid.originX) >= (unsigned)searchgrid.width
+	 || (unsigned)(mapy - searchgrid.originY) >= (unsigned)searchgrid.height
+	 || isSearchWall(mapx, mapy))
+	{
+		return 0;
+	}
+
+	/* Steht der Roboter selbst im Unbekannten, ist er an der Grenze */
+	if (!isSearchCharted(mapx, mapy))
+	{
+		if (outNearestX != (double*)0 && outNearestY != (double*)0)
+		{
+			*outNearestX = (mapx-MAP_OFFS_X)/MAP_SCALE;
+			*outNearestY = (MAP_OFFS_Y-mapy)/MAP_SCALE;
+		}
+		return 1;
+	}
+
+	if (fitLabelsToGrid()) return 0;
+	const int tiles = searchgrid.tilesX*searchgrid.tilesY;
+
+	/* Kacheln unabhängig voneinander beschriften */
+	#pragma omp parallel for schedule(dynamic)
+	for (int t = 0; t < tiles; ++t)
+	{
+		labelTile(t);
+	}
+
+	/* Komponenten über die Kachelränder hinweg vereinigen */
+	mergeTileBorders();
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int t = 0; t < tiles; ++t)
+	{
+		resolveTile(t);
+	}
+
+	/* Unkartierte Zellen am Rand der Komponente des Startpunktes zählen */
+	const int32_t root = componentAt(mapx, mapy);
+	int foundUncharted = 0;
+	int nearestUnchartedX = INT_MAX/4;
+	int nearestUnchartedY = INT_MAX/4;
+
+	#pragma omp parallel
+	{
+		int nearestX = INT_MAX/4;
+		int nearestY = INT_MAX/4;
+
+		#pragma omp for schedule(dynamic) reduction(+:foundUncharted)
+		for (int t = 0; t < tiles; ++t)
+		{
+			foundUncharted += countTileBoundary(t, root, mapx, mapy, &nearestX, &nearestY);
+		}
+
+		#pragma omp critical(frontier_nearest)
+		getNearest(mapx, mapy, nearestX, nearestY, nearestUnchartedX, nearestUnchartedY);
+	}
+
+	if (foundUncharted && outNearestX != (double*)0 && outNearestY != (double*)0)
+	{
+		*outNearestX = (nearestUnchartedX-MAP_OFFS_X)/MAP_SCALE;
+		*outNearestY = (MAP_OFFS_Y-nearestUnchartedY)/MAP_SCALE;
+	}
+
+	return foundUncharted;
+}
+
+/**
+* Anzahl der Frontier-Zellen; wird von mehreren Kartierungs-Threads atomar gepflegt
+*/
+static int frontierCount = 0;
+
+/**
+* Kandidat der hierarchischen Suche nach der nähesten Frontier
+*/
+typedef struct {
+	int bound;				/*! Untere Schranke der Distanz zum Startpunkt */
+	const grid_tile_t *tile;	/*! Die Kachel */
+	int originX;			/*! X-Koordinate der ersten Zelle der Kachel */
+	int originY;			/*! Y-Koordinate der ersten Zelle der Kachel */
+} frontiertile_t;
+
+/**
+* Wiederverwendetes Array der Kachelkandidaten
+*/
+static frontiertile_t *frontierTiles = (frontiertile_t*)0;
+static int frontierTilesCapacity = 0;
+
+/**
+* Wiederverwendete Cluster-Liste und Warteschlange der Clustersuche
+*/
+static frontiercluster_t *clusters = (frontiercluster_t*)0;
+static int clusterCount = 0;
+static int clustersCapacity = 0;
+static int *clusterQueue = (int*)0;		/* Koordinatenpaare {x,y} */
+static int clusterQueueCapacity = 0;
+
+/**
+* Initialisiert die inkrementelle Frontier-Erkennung.
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int frontier_init(void)
+{
+	if (fitVisitedToGrid()) return 1;
+	frontierCount = 0;
+	return 0;
+}
+
+/**
+* Gibt die Ressourcen der inkrementellen Frontier-Erkennung frei.
+*/
+void frontier_shutdown(void)
+{
+	free(visited.words);
+	free(visited.epochs);
+	visited.words = (uint64_t*)0;
+	visited.epochs = (uint16_t*)0;
+
+	free(scanlineQueue.items);
+	scanlineQueue.items = (scanlinerange_t*)0;
+	scanlineQueue.head = scanlineQueue.tail = scanlineQueue.capacity = 0;
+
+	wavefront_shutdown();
+
+	free(labels.parent);
+	free(labels.component);
+	labels.parent = labels.component = (int32_t*)0;
+	labels.capacity = 0;
+
+	free(frontierTiles);
+	frontierTiles = (frontiertile_t*)0;
+	frontierTilesCapacity = 0;
+	frontierCount = 0;
+
+	free(clusters);
+	clusters = (frontiercluster_t*)0;
+	clusterCount = clustersCapacity = 0;
+	free(clusterQueue);
+	clusterQueue = (int*)0;
+	clusterQueueCapacity = 0;
+}
+
+/**
+* Ermittelt, ob eine Zelle eine Frontier-Zelle ist, d.h. kartiert, keine Wand
+* und mindestens einen unkartierten Nachbarn besitzt.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Null, wenn die Zelle keine Frontier ist, ansonsten nicht-null.
+*/
+static inline int isFrontier(const int x, const int y)
+{
+	const uint8_t cell = grid_get(&mapgrid, x, y);
+	if (!(cell & GRID_CELL_CHARTED) || (cell & GRID_CELL_WALL)) return 0;
+
+	/* Die Karte ist unbegrenzt, jeder Nachbar kann erforscht werden */
+	return !isCharted(x-1, y) || !isCharted(x+1, y) || !isCharted(x, y-1) || !isCharted(x, y+1);
+}
+
+/**
+* Bewertet eine einzelne Zelle neu und pflegt Frontier-Bit und Zähler.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+*/
+static void updateFrontierCell(const int x, const int y)
+{
+	const uint8_t *cell = grid_cell(&mapgrid, x, y);
+	if (cell == (const uint8_t*)0) return;
+
+	const int wasFrontier = (*cell & GRID_CELL_FRONTIER) != 0;
+	const int nowFrontier = isFrontier(x, y);
+	if (wasFrontier == nowFrontier) return;
+
+	/* Über grid_write, damit die Zusammenfassungen mitgezählt werden */
+	if (nowFrontier)
+	{
+		grid_write(&mapgrid, x, y, *cell | GRID_CELL_FRONTIER);
+		__atomic_add_fetch(&frontierCount, 1, __ATOMIC_RELAXED);
+	}
+	else
+	{
+		grid_write(&mapgrid, x, y, *cell & ~GRID_CELL_FRONTIER);
+		__atomic_sub_fetch(&frontierCount, 1, __ATOMIC_RELAXED);
+	}
+}
+
+/**
+* Aktualisiert die Frontier-Menge, nachdem sich der Kartierungszustand
+* einer Zelle geändert hat.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+*/
+void frontier_touch(const int x, const int y)
+{
+	updateFrontierCell(x, y);
+	updateFrontierCell(x-1, y);
+	updateFrontierCell(x+1, y);
+	updateFrontierCell(x, y-1);
+	updateFrontierCell(x, y+1);
+}
+
+/**
+* Bestimmt die Anzahl der Frontier-Zellen aus den Zusammenfassungen der Kacheln neu.
+*/
+void frontier_recount(void)
+{
+	int count = 0;
+	for (int i = 0; i < mapgrid.tilesX*mapgrid.tilesY; ++i)
+	{
+		if (mapgrid.tiles[i] != (grid_tile_t*)0) count += mapgrid.tiles[i]->summary.frontiers;
+	}
+	__atomic_store_n(&frontierCount, count, __ATOMIC_RELAXED);
+}
+
+/**
+* Liefert die Anzahl der Frontier-Zellen in O(1).
+* \return Anzahl der kartierten, begehbaren Zellen mit unkartiertem Nachbarn
+*/
+int frontier_count(void)
+{
+	return __atomic_load_n(&frontierCount, __ATOMIC_RELAXED);
+}
+
+/**
+* Zählt die Frontier-Zellen des Suchgitters anhand der Kachelzusammenfassungen.
+* \return Anzahl der Frontier-Zellen im Schnappschuss
+*/
+static int countSearchFrontiers()
+{
+	int count = 0;
+	for (int t = 0; t < searchgrid.tilesX*searchgrid.tilesY; ++t)
+	{
+		const grid_tile_t *tile = searchgrid.tiles[t];
+		if (tile != (grid_tile_t*)0) count += tile->summary.frontiers;
+	}
+	return count;
+}
+
+/**
+* Untere Schranke der Manhattan-Distanz von einem Punkt zu einem Rechteck.
+* \param[in] x Die X-Koordinate des Punktes
+* \param[in] y Die Y-Koordinate des Punktes
+* \param[in] originX Die X-Koordinate der ersten Zelle des Rechtecks
+* \param[in] originY Die Y-Koordinate der ersten Zelle des Rechtecks
+* \param[in] size Die Kantenlänge des Rechtecks
+* \return Die Distanz
+*/
+static inline int getRectDistance(const int x, const int y, const int originX, const int originY, const int size)
+{
+	const int dx = (x < originX) ? originX - x : ((x >= originX+size) ? x - (originX+size-1) : 0);
+	const int dy = (y < originY) ? originY - y : ((y >= originY+size) ? y - (originY+size-1) : 0);
+	return dx + dy;
+}
+
+/**
+* Vergleicht zwei Kachelkandidaten anhand ihrer unteren Schranke.
+*/
+static int compareFrontierTiles(const void *a, const void *b)
+{
+	return ((const frontiertile_t*)a)->bound - ((const frontiertile_t*)b)->bound;
+}
+
+/**
+* Ermittelt anhand der inkrementell gepflegten Frontier-Menge die näheste
+* Frontier-Zelle.
+*
+* Die Suche verläuft von grob nach fein über die Zusammenfassungen des Gitters:
+* Kacheln und Blöcke ohne Frontier-Zellen werden übersprungen, die übrigen
+* werden nach ihrer unteren Distanzschranke abgearbeitet, bis keine Kachel
+* bzw. kein Block mehr näher liegen kann als der bisher beste Treffer.
+*
+* \param[in] startX Die X-Koordinate des Startpunktes in Weltkoordinaten
+* \param[in] startY Die Y-Koordinate des Startpunktes in Weltkoordinaten
+* \param[out] outNearestX Die X-Koordinate der nähesten Frontier in Weltkoordinaten
+* \param[out] outNearestY Die Y-Koordinate der nähesten Frontier in Weltkoordinaten
+* \return Null, wenn keine Frontier existiert, -1, wenn kein Speicher verfügbar war,
+*         ansonsten die Anzahl der Frontier-Zellen.
+*/
+int findNearestFrontier(const double startX, const double startY, double *outNearestX, double *outNearestY)
+{
+	const int frontiers = countSearchFrontiers();
+	const int mapy = MAP_OFFS_Y-(int)(MAP_SCALE*startY);
+	const int mapx = MAP_OFFS_X+(int)(MAP_SCALE*startX);
+
+	/* Steht der Roboter selbst im Unbekannten, ist er an der Grenze */
+	if (!isSearchCharted(mapx, mapy))
+	{
+		if (outNearestX != (double*)0 && outNearestY != (double*)0)
+		{
+			*outNearestX = startX;
+			*outNearestY = startY;
+		}
+		return frontiers + 1;
+	}
+
+	if (frontiers == 0)
+	{
+		return 0;
+	}
+
+	/* Kacheln mit Frontier-Zellen sammeln */
+	int tileCount = 0;
+	for (int ty = 0; ty < searchgrid.tilesY; ++ty)
+	{
+		for (int tx = 0; tx < searchgrid.tilesX; ++tx)
+		{
+			const grid_tile_t *tile = searchgrid.tiles[ty*searchgrid.tilesX + tx];
+			if (tile == (grid_tile_t*)0 || tile->summary.frontiers == 0) continue;
+
+			if (tileCount == frontierTilesCapacity)
+			{
+				const int capacity = (frontierTilesCapacity > 0) ? frontierTilesCapacity*2 : 64;
+				frontiertile_t *tiles = (frontiertile_t*)realloc(frontierTiles, capacity*sizeof(frontiertile_t));
+				if (tiles == (frontiertile_t*)0) return -1;
+				frontierTiles = tiles;
+				frontierTilesCapacity = capacity;
+			}
+
+			frontiertile_t *candidate = &frontierTiles[tileCount++];
+			candidate->tile    = tile;
+			candidate->originX = searchgrid.originX + tx*GRID_TILE_SIZE;
+			candidate->originY = searchgrid.originY + ty*GRID_TILE_SIZE;
+			candidate->bound   = getRectDistance(mapx, mapy, candidate->originX, candidate->originY, GRID_TILE_SIZE);
+		}
+	}
+	qsort(frontierTiles, tileCount, sizeof(frontiertile_t), compareFrontierTiles);
+
+	/* Kacheln, dann Blöcke, dann Zellen mit Schranke durchsuchen */
+	int nearestUnchartedX = INT_MAX/4;
+	int nearestUnchartedY = INT_MAX/4;
+	int distance = INT_MAX;
+	for (int i = 0; i < tileCount && frontierTiles[i].bound < distance; ++i)
+	{
+		const frontiertile_t *candidate = &frontierTiles[i];
+		for (int b = 0; b < GRID_TILE_BLOCKS*GRID_TILE_BLOCKS; ++b)
+		{
+			if (candidate->tile->blocks[b].frontiers == 0) continue;
+
+			const int blockX = candidate->originX + (b % GRID_TILE_BLOCKS)*GRID_BLOCK_SIZE;
+			const int blockY = candidate->originY + (b / GRID_TILE_BLOCKS)*GRID_BLOCK_SIZE;
+			if (getRectDistance(mapx, mapy, blockX, blockY, GRID_BLOCK_SIZE) >= distance) continue;
+
+			for (int y = blockY; y < blockY + GRID_BLOCK_SIZE; ++y)
+			{
+				const uint8_t *row = &candidate->tile->cells[grid_tile_index(blockX, y)];
+				for (int x = 0; x < GRID_BLOCK_SIZE; ++x)
+				{
+					if (!(row[x] & GRID_CELL_FRONTIER)) continue;
+					distance = getNearest(mapx, mapy, blockX+x, y, nearestUnchartedX, nearestUnchartedY);
+				}
+			}
+		}
+	}
+
+	if (outNearestX != (double*)0 && outNearestY != (double*)0)
+	{
+		*outNearestX = (nearestUnchartedX-MAP_OFFS_X)/MAP_SCALE;
+		*outNearestY = (MAP_OFFS_Y-nearestUnchartedY)/MAP_SCALE;
+	}
+
+	return frontiers;
+}
+
+/**
+* Ermittelt die im Sinne der Wegdistanz näheste erreichbare Frontier-Zelle.
+* \param[in] startX Die X-Koordinate des Startpunktes in Weltkoordinaten
+* \param[in] startY Die Y-Koordinate des Startpunktes in Weltkoordinaten
+* \param[out] outNearestX Die X-Koordinate der nähesten Frontier in Weltkoordinaten
+* \param[out] outNearestY Die Y-Koordinate der nähesten Frontier in Weltkoordinaten
+* \param[out] outDistance (Optional) Die Wegdistanz in Metern; Kann NULL sein.
+* \return Null, wenn keine Frontier erreichbar ist, ansonsten die Anzahl der Frontier-Zellen.
+*/
+int findNearestReachableFrontier(const double startX, const double startY, double *outNearestX, double *outNearestY, double *outDistance)
+{
+	const int frontiers = countSearchFrontiers();
+	const int mapy = MAP_OFFS_Y-(int)(MAP_SCALE*startY);
+	const int mapx = MAP_OFFS_X+(int)(MAP_SCALE*startX);
+
+	/* Steht der Roboter selbst im Unbekannten, ist er an der Grenze; das
+	 * Distanzfeld der letzten Suche gilt dann nicht mehr */
+	if (!isSearchCharted(mapx, mapy))
+	{
+		wavefront_invalidate();
+		if (outNearestX != (double*)0 && outNearestY != (double*)0)
+		{
+			*outNearestX = startX;
+			*outNearestY = startY;
+		}
+		if (outDistance != (double*)0) *outDistance = 0;
+		return frontiers + 1;
+	}
+
+	/* Ohne Frontier-Zellen ist keine Ausbreitung nötig */
+	if (frontiers == 0)
+	{
+		return 0;
+	}
+
+	int nearestX, nearestY;
+	if (!wavefront_expand(mapx, mapy, GRID_CELL_FRONTIER, &nearestX, &nearestY))
+	{
+		return 0;
+	}
+
+	if (outNearestX != (double*)0 && outNearestY != (double*)0)
+	{
+		*outNearestX = (nearestX-MAP_OFFS_X)/MAP_SCALE;
+		*outNearestY = (MAP_OFFS_Y-nearestY)/MAP_SCALE;
+	}
+	if (outDistance != (double*)0)
+	{
+		*outDistance = wavefront_distance(nearestX, nearestY)/MAP_SCALE;
+	}
+
+	return frontiers;
+}
+
+/**
+* Mindestgröße eines Clusters in Zellen; kleinere Cluster (z.B. einzelne
+* Lücken in Wänden) werden nur angefahren, wenn kein größerer erreichbar ist
+*/
+#define FRONTIER_CLUSTER_MIN_SIZE (4)
+
+/**
+* Konstanter Anteil der Wegkosten in Zellen, damit nahe Ziele nicht allein
+* aufgrund ihrer geringen Distanz gewinnen
+*/
+#define FRONTIER_TRAVEL_OFFSET ((uint32_t)MAP_SCALE)
+
+/**
+* Jeder wievielte Strahl des Lasermodells bei der Gewinnabschätzung verfolgt wird
+*/
+#define FRONTIER_GAIN_BEAM_STEP (8)
+
+/**
+* Radius in Zellen, innerhalb dessen das Ziel eines anderen Roboters den
+* Informationsgewinn eines Clusters mindert; entspricht der Laserreichweite,
+* da sich die Messungen beider Roboter sonst überdecken
+*/
+#define FRONTIER_CLAIM_RADIUS (LASER_RANGE_MAX*MAP_SCALE)
+
+/**
+* Von anderen Robotern in dieser Suchrunde beanspruchte Ziele in Kartenkoordinaten
+*/
+static int claimX[MAP_MAX_ROBOTS];
+static int claimY[MAP_MAX_ROBOTS];
+static int claimCount = 0;
+
+/**
+* Hängt einen Cluster an die Liste an und vergrößert sie bei Bedarf.
+* \return Zeiger auf den neuen Cluster oder NULL, wenn kein Speicher verfügbar war
+*/
+static frontiercluster_t* appendCluster()
+{
+	if (clusterCount == clustersCapacity)
+	{
+		const int capacity = (clustersCapacity > 0) ? clustersCapacity*2 : 64;
+		frontiercluster_t *items = (frontiercluster_t*)realloc(clusters, capacity*sizeof(frontiercluster_t));
+		if (items == (frontiercluster_t*)0) return (frontiercluster_t*)0;
+		clusters = items;
+		clustersCapacity = capacity;
+	}
+	return &clusters[clusterCount++];
+}
+
+/**
+* Fasst alle Frontier-Zellen zu 8-fach zusammenhängenden Clustern zusammen.
+*
+* Kacheln und Blöcke ohne Frontier-Zellen werden anhand der Zusammenfassungen
+* übersprungen. Als Ziel eines Clusters dient die per Wellenfront erreichbare
+* Zelle, die dem Schwerpunkt am nächsten liegt; Cluster ohne erreichbare Zelle
+* werden verworfen.
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+static int buildClusters()
+{
+	const int frontiers = countSearchFrontiers();
+	clusterCount = 0;
+	if (fitVisitedToGrid()) return 1;
+	clearVisited();
+
+	/* Jede Frontier-Zelle wird genau einmal eingereiht */
+	if (clusterQueueCapacity < frontiers)
+	{
+		free(clusterQueue);
+		clusterQueueCapacity = frontiers*2;
+		clusterQueue = (int*)malloc(clusterQueueCapacity*2*sizeof(int));
+		if (clusterQueue == (int*)0) { clusterQueueCapacity = 0; return 1; }
+	}
+
+	int tail = 0;
+	for (int t = 0; t < searchgrid.tilesX*searchgrid.tilesY; ++t)
+	{
+		const grid_tile_t *tile = searchgrid.tiles[t];
+		if (tile == (grid_tile_t*)0 || tile->summary.frontiers == 0) continue;
+
+		const int tileX = (searchgrid.tileOriginX + t % searchgrid.tilesX) * GRID_TILE_SIZE;
+		const int tileY = (searchgrid.tileOriginY + t / searchgrid.tilesX) * GRID_TILE_SIZE;
+		for (int b = 0; b < GRID_TILE_BLOCKS*GRID_TILE_BLOCKS; ++b)
+		{
+			if (tile->blocks[b].frontiers == 0) continue;
+
+			const int blockX = tileX + (b % GRID_TILE_BLOCKS) * GRID_BLOCK_SIZE;
+			const int blockY = tileY + (b / GRID_TILE_BLOCKS) * GRID_BLOCK_SIZE;
+			for (int i = 0; i < GRID_BLOCK_CELLS; ++i)
+			{
+				const int seedX = blockX + (i & GRID_BLOCK_MASK);
+				const int seedY = blockY + (i >> GRID_BLOCK_SHIFT);
+				if (!(grid_get(&searchgrid, seedX, seedY) & GRID_CELL_FRONTIER) || isVisited(seedX, seedY)) continue;
+
+				/* Cluster per Breitensuche über die 8er-Nachbarschaft sammeln */
+				const int first = tail;
+				int head = tail;
+				markAsVisited(seedX, seedY);
+				clusterQueue[2*tail] = seedX;
+				clusterQueue[2*tail+1] = seedY;
+				++tail;
+
+				long sumX = 0, sumY = 0;
+				while (head != tail)
+				{
+					const int x = clusterQueue[2*head];
+					const int y = clusterQueue[2*head+1];
+					++head;
+					sumX += x;
+					sumY += y;
+
+					for (int ny = y-1; ny <= y+1; ++ny)
+					{
+						for (int nx = x-1; nx <= x+1; ++nx)
+						{
+							if (!isInVisitedSet(nx, ny) || isVisited(nx, ny)) continue;
+							if (!(grid_get(&searchgrid, nx, ny) & GRID_CELL_FRONTIER)) continue;
+
+							markAsVisited(nx, ny);
+							clusterQueue[2*tail] = nx;
+							clusterQueue[2*tail+1] = ny;
+							++tail;
+						}
+					}
+				}
+
+				const int size = tail - first;
+				const double centroidX = (double)sumX / size;
+				const double centroidY = (double)sumY / size;
+
+				/* Erreichbare Zelle nahe dem Schwerpunkt als Ziel wählen */
+				int goal = -1;
+				double goalDistance = HUGE_VAL;
+				for (int m = first; m < tail; ++m)
+				{
+					const int x = clusterQueue[2*m];
+					const int y = clusterQueue[2*m+1];
+					if (wavefront_distance(x, y) == WAVEFRONT_UNREACHABLE) continue;
+
+					const double d = (x-centroidX)*(x-centroidX) + (y-centroidY)*(y-centroidY);
+					if (d < goalDistance)
+					{
+						goalDistance = d;
+						goal = m;
+					}
+				}
+				if (goal < 0) continue;
+
+				frontiercluster_t *cluster = appendCluster();
+				if (cluster == (frontiercluster_t*)0) return 1;
+				cluster->size      = size;
+				cluster->centroidX = centroidX;
+				cluster->centroidY = centroidY;
+				cluster->goalX     = clusterQueue[2*goal];
+				cluster->goalY     = clusterQueue[2*goal+1];
+				cluster->distance  = wavefront_distance(cluster->goalX, cluster->goalY);
+				cluster->gain      = 0;
+				cluster->score     = 0;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+* Schätzt den Informationsgewinn einer Messung an der Zielzelle eines Clusters ab.
+*
+* Das Lasermodell aus laser.h wird, in Fahrtrichtung vom Roboter zum Ziel
+* ausgerichtet, in die Karte projiziert. Gezählt werden die unkartierten
+* Zellen, die die Strahlen bis zur maximalen Reichweite oder bis zur ersten
+* Wand überstreichen; Zellen, die mehrere Strahlen schneiden, zählen mehrfach.
+* Die Funktion liest die Karte nur und kann parallel aufgerufen werden.
+* \param[in] cluster Der Cluster
+* \param[in] robotX Die X-Koordinate des Roboters in Kartenkoordinaten
+* \param[in] robotY Die Y-Koordinate des Roboters in Kartenkoordinaten
+* \return Die Anzahl der erwartet neu gesehenen Zellen
+*/
+static int estimateGain(const frontiercluster_t *cluster, const int robotX, const int robotY)
+{
+	const double heading = (cluster->goalX == robotX && cluster->goalY == robotY)
+		? 0 : atan2((double)(cluster->goalY - robotY), (double)(cluster->goalX - robotX));
+	const int range = (int)(LASER_RANGE_MAX*MAP_SCALE);
+	const double originX = cluster->goalX + 0.5;
+	const double originY = cluster->goalY + 0.5;
+
+	int gain = 0;
+	for (int beam = 0; beam < LASER_SAMPLES; beam += FRONTIER_GAIN_BEAM_STEP)
+	{
+		const double angle = heading + LASER_MIN_ANGLE_RAD + beam*LASER_ANGULAR_RESOLUTION_RAD;
+		const double dx = cos(angle);
+		const double dy = sin(angle);
+
+		int lastX = cluster->goalX, lastY = cluster->goalY;
+		for (int r = 1; r <= range; ++r)
+		{
+			const int x = (int)floor(originX + r*dx);
+			const int y = (int)floor(originY + r*dy);
+			if (x == lastX && y == lastY) continue;
+			lastX = x;
+			lastY = y;
+
+			const uint8_t cell = grid_get(&searchgrid, x, y);
+			if (cell & GRID_CELL_WALL) break;
+			if (!(cell & GRID_CELL_CHARTED)) ++gain;
+		}
+	}
+	return gain;
+}
+
+/**
+* Ermittelt, wie stark ein Ziel durch die beanspruchten Ziele anderer
+* Roboter entwertet wird.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return 1, wenn kein beanspruchtes Ziel näher als {\see FRONTIER_CLAIM_RADIUS} liegt,
+*         ansonsten die Distanz zum nähesten beanspruchten Ziel relativ zum Radius
+*/
+static double claimFactor(const int x, const int y)
+{
+	double factor = 1;
+	for (int i = 0; i < claimCount; ++i)
+	{
+		const double dx = x - claimX[i];
+		const double dy = y - claimY[i];
+		const double relative = sqrt(dx*dx + dy*dy) / FRONTIER_CLAIM_RADIUS;
+		if (relative < factor) factor = relative;
+	}
+	return factor;
+}
+
+/**
+* Verwirft alle beanspruchten Ziele; zu Beginn jeder Suchrunde.
+*/
+void frontier_claims_clear(void)
+{
+	claimCount = 0;
+}
+
+/**
+* Beansprucht ein Ziel für den Rest der Suchrunde.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+*/
+void frontier_claim(const int x, const int y)
+{
+	if (claimCount >= MAP_MAX_ROBOTS) return;
+	claimX[claimCount] = x;
+	claimY[claimCount] = y;
+	++claimCount;
+}
+
+/**
+* Ermittelt, ob ein Ziel näher als der halbe Radius an einem beanspruchten Ziel liegt.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Null, wenn das Ziel frei ist, ansonsten nicht-null.
+*/
+int frontier_claimed(const int x, const int y)
+{
+	return claimFactor(x, y) < 0.5;
+}
+
+/**
+* Ermittelt das lohnendste erreichbare Frontier-Cluster.
+* \param[in] startX Die X-Koordinate des Startpunktes in Weltkoordinaten
+* \param[in] startY Die Y-Koordinate des Startpunktes in Weltkoordinaten
+* \param[out] outGoalX Die X-Koordinate des Ziels in Weltkoordinaten
+* \param[out] outGoalY Die Y-Koordinate des Ziels in Weltkoordinaten
+* \param[out] outDistance (Optional) Die Wegdistanz in Metern; Kann NULL sein.
+* \return Null, wenn keine Frontier erreichbar ist, -1, wenn für die Cluster kein
+* Speicher verfügbar war, ansonsten die Anzahl der Frontier-Zellen.
+*/
+int findBestFrontier(const double startX, const double startY, double *outGoalX, double *outGoalY, double *outDistance)
+{
+	const int frontiers = countSearchFrontiers();
+	const int mapy = MAP_OFFS_Y-(int)(MAP_SCALE*startY);
+	const int mapx = MAP_OFFS_X+(int)(MAP_SCALE*startX);
+	clusterCount = 0;
+
+	/* Steht der Roboter selbst im Unbekannten, ist er an der Grenze. Das
+	 * Distanzfeld wird dann nicht neu ausgebreitet; das der letzten Suche
+	 * darf der Planer nicht als Heuristik verwenden. */
+	if (!isSearchCharted(mapx, mapy))
+	{
+		wavefront_invalidate();
+		if (outGoalX != (double*)0 && outGoalY != (double*)0)
+		{
+			*outGoalX = startX;
+			*outGoalY = startY;
+		}
+		if (outDistance != (double*)0) *outDistance = 0;
+		return frontiers + 1;
+	}
+
+	if (frontiers == 0)
+	{
+		return 0;
+	}
+
+	/* Vollständiges Distanzfeld, damit alle Cluster bewertet werden können */
+	int unusedX, unusedY;
+	wavefront_expand(mapx, mapy, 0, &unusedX, &unusedY);
+	if (buildClusters())
+	{
+		return -1;
+	}
+	if (clusterCount == 0)
+	{
+		return 0;
+	}
+
+	/* Die Bewertung liest die Karte nur und wird auf alle Kerne verteilt */
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < clusterCount; ++i)
+	{
+		clusters[i].gain  = estimateGain(&clusters[i], mapx, mapy);
+		clusters[i].score = clusters[i].gain * claimFactor(clusters[i].goalX, clusters[i].goalY)
+		                  / (double)(clusters[i].distance + FRONTIER_TRAVEL_OFFSET);
+	}
+
+	/* Bestes Cluster wählen; kleine Cluster nur, wenn es keine großen gibt */
+	int best = -1;
+	for (int i = 0; i < clusterCount; ++i)
+	{
+		if (best < 0) { best = i; continue; }
+
+		const int large = clusters[i].size >= FRONTIER_CLUSTER_MIN_SIZE;
+		const int bestLarge = clusters[best].size >= FRONTIER_CLUSTER_MIN_SIZE;
+		if (large != bestLarge)
+		{
+			if (large) best = i;
+			continue;
+		}
+		if (clusters[i].score > clusters[best].score
+		 || (clusters[i].score == clusters[best].score && clusters[i].distance < clusters[best].distance))
+		{
+			best = i;
+		}
+	}
+
+	if (outGoalX != (double*)0 && outGoalY != (double*)0)
+	{
+		*outGoalX = (clusters[best].goalX-MAP_OFFS_X)/MAP_SCALE;
+		*outGoalY = (MAP_OFFS_Y-clusters[best].goalY)/MAP_SCALE;
+	}
+	if (outDistance != (double*)0)
+	{
+		*outDistance = clusters[best].distance/MAP_SCALE;
+	}
+
+	return frontiers;
+}
+
+/**
+* Liefert die Cluster der letzten Zielwahl.
+* \param[out] outClusters Zeiger auf die Cluster
+* \return Anzahl der Cluster
+*/
+int frontier_clusters(const frontiercluster_t **outClusters)
+{
+	*outClusters = clusters;
+	return clusterCount;
+}
+
+/**
+* Überträgt das Ergebnis der letzten Wellenfront-Ausbreitung in ein Anzeigebild.
+* Erreichte Bereiche werden blau, Frontier-Zellen weiß dargestellt.
+* \param[out] img Das Zielbild (8 Bit, 3 Kanäle, BGR)
+*/
+void frontier_render(IplImage *img)
+{
+	for (int py = 0; py < img->height; ++py)
+	{
+		const int y = mapgrid.originY + py;
+		uint8_t *pixel = (uint8_t*)(img->imageData + py*img->widthStep);
+		for (int px = 0; px < img->width; ++px, pixel += 3)
+		{
+			const int x = mapgrid.originX + px;
+			if (grid_get(&mapgrid, x, y) & GRID_CELL_FRONTIER)
+			{
+				pixel[0] = pixel[1] = pixel[2] = MAX_GRAY;
+				continue;
+			}
+
+			const uint32_t distance = wavefront_distance(x, y);
+			if (distance == WAVEFRONT_UNREACHABLE)
+			{
+				pixel[0] = pixel[1] = pixel[2] = 0;
+				continue;
+			}
+
+			/* Helligkeit nimmt mit der Wegdistanz ab */
+			pixel[0] = (uint8_t)(MAX_GRAY - (distance % 192));
+			pixel[1] = pixel[2] = 0;
+		}
+	}
+}
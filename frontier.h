@@ -1,10 +1,31 @@
 /**
 * Erkennung von noch nicht erforschten Bereichen.
+*
+* Die Frontier-Bits werden mit {\see frontier_touch} im Belegungsgitter der
+* Kartierung gepflegt. Sämtliche Suchfunktionen lesen hingegen den
+* Schnappschuss {\see searchgrid} und laufen im Such-Thread (\see explorer.h).
 */
 
 #ifndef FRONTIER_H
 #define FRONTIER_H
 
+#include <opencv/cv.h>
+#include <stdint.h>
+
+/**
+* Zusammenhängende Gruppe von Frontier-Zellen
+*/
+typedef struct {
+	int size;				/*! Anzahl der Zellen */
+	double centroidX;		/*! X-Koordinate des Schwerpunktes in Kartenkoordinaten */
+	double centroidY;		/*! Y-Koordinate des Schwerpunktes in Kartenkoordinaten */
+	int goalX;				/*! X-Koordinate der anzufahrenden Zelle in Kartenkoordinaten */
+	int goalY;				/*! Y-Koordinate der anzufahrenden Zelle in Kartenkoordinaten */
+	uint32_t distance;		/*! Wegdistanz zur anzufahrenden Zelle in Zellen */
+	int gain;				/*! Erwarteter Informationsgewinn in Zellen */
+	double score;			/*! Informationsgewinn je Wegkosten */
+} frontiercluster_t;
+
 /**
 * Überprüft, ob die Karte offene Bereiche beinhaltet.
 *
@@ -14,11 +35,161 @@
 * Wird kein leerer Bereich gefunden, ist die gesamte (erreichbare) Karte 
 * gesehen worden.
 *
+* Geflutet werden die vom Startpunkt aus über kartierte, wandfreie Zellen
+* erreichbaren Zellen (4er-Nachbarschaft); gezählt werden die unkartierten
+* Zellen, die an diesen Bereich grenzen. Unter gleich weit entfernten
+* unkartierten Zellen gilt die mit kleinerer Y-, dann X-Koordinate als näheste.
+*
 * \param[in] startX Die X-Koordinate des Startpunktes in Weltkoordinaten
 * \param[in] startY Die Y-Koordinate des Startpunktes in Weltkoordinaten
-* \return Null, wenn die Karte voll abgedeckt ist oder nicht-Null, 
-*         wenn offene Bereiche existieren.
+* \return Null, wenn die Karte voll abgedeckt ist, -1, wenn kein Speicher
+*         verfügbar war, oder die Anzahl der unkartierten Zellen, wenn offene
+*         Bereiche existieren.
 */
 int checkForOpenSpaces(const double startX, const double startY, double *outNearestX, double* outNearestY);
 
+/**
+* Überprüft wie {\see checkForOpenSpaces}, ob die Karte offene Bereiche
+* beinhaltet, verteilt die Arbeit jedoch auf alle Kerne.
+*
+* Statt einer Flutung werden die begehbaren Zellen jeder Kachel parallel
+* nach ihrem Zusammenhang beschriftet. Anschließend werden die Komponenten
+* entlang der Kachelränder per Union-Find vereinigt und die unkartierten
+* Zellen am Rand der Komponente des Startpunktes wiederum parallel gezählt.
+* Anzahl und näheste Zelle stimmen mit {\see checkForOpenSpaces} überein.
+*
+* \param[in] startX Die X-Koordinate des Startpunktes in Weltkoordinaten
+* \param[in] startY Die Y-Koordinate des Startpunktes in Weltkoordinaten
+* \param[out] outNearestX (Optional) Die X-Koordinate der nähesten unkartierten Zelle in Weltkoordinaten
+* \param[out] outNearestY (Optional) Die Y-Koordinate der nähesten unkartierten Zelle in Weltkoordinaten
+* \return Die Anzahl der an den erreichbaren Bereich grenzenden unkartierten Zellen
+*/
+int checkForOpenSpacesParallel(const double startX, const double startY, double *outNearestX, double *outNearestY);
+
+/**
+* Initialisiert die inkrementelle Frontier-Erkennung.
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int frontier_init(void);
+
+/**
+* Gibt die Ressourcen der inkrementellen Frontier-Erkennung frei.
+*/
+void frontier_shutdown(void);
+
+/**
+* Aktualisiert die Frontier-Menge, nachdem sich der Kartierungszustand
+* einer Zelle geändert hat. Die Zelle sowie ihre vier Nachbarn werden
+* neu bewertet.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+*/
+void frontier_touch(const int x, const int y);
+
+/**
+* Bestimmt die Anzahl der Frontier-Zellen aus den Zusammenfassungen der
+* Kacheln neu, nachdem die Karte ohne {\see frontier_touch} gefüllt wurde,
+* z.B. beim Laden einer Ablage. Erfordert exklusiven Zugriff auf die Karte.
+*/
+void frontier_recount(void);
+
+/**
+* Liefert die Anzahl der Frontier-Zellen in O(1).
+* \return Anzahl der kartierten, begehbaren Zellen mit unkartiertem Nachbarn
+*/
+int frontier_count(void);
+
+/**
+* Ermittelt anhand der inkrementell gepflegten Frontier-Menge, ob die Karte
+* offene Bereiche beinhaltet, sowie die näheste Frontier-Zelle.
+*
+* Im Gegensatz zu {\see checkForOpenSpaces} wird die Karte nicht geflutet;
+* der Aufwand wächst lediglich mit der Anzahl der Frontier-Zellen. Die
+* Erreichbarkeit der Zellen wird dabei nicht geprüft.
+*
+* \param[in] startX Die X-Koordinate des Startpunktes in Weltkoordinaten
+* \param[in] startY Die Y-Koordinate des Startpunktes in Weltkoordinaten
+* \param[out] outNearestX Die X-Koordinate der nähesten Frontier in Weltkoordinaten
+* \param[out] outNearestY Die Y-Koordinate der nähesten Frontier in Weltkoordinaten
+* \return Null, wenn keine Frontier existiert, -1, wenn kein Speicher verfügbar war,
+*         ansonsten die Anzahl der Frontier-Zellen.
+*/
+int findNearestFrontier(const double startX, const double startY, double *outNearestX, double *outNearestY);
+
+/**
+* Ermittelt die im Sinne der Wegdistanz näheste erreichbare Frontier-Zelle.
+*
+* Von der Roboterposition aus wird eine Wellenfront über kartierte, wandfreie
+* Zellen ausgebreitet, bis die erste Frontier-Zelle erreicht ist. Umwege um
+* Wände werden somit berücksichtigt. Wird keine Frontier erreicht, sind alle
+* verbliebenen Grenzen unerreichbar und die Karte gilt als vollständig.
+*
+* \param[in] startX Die X-Koordinate des Startpunktes in Weltkoordinaten
+* \param[in] startY Die Y-Koordinate des Startpunktes in Weltkoordinaten
+* \param[out] outNearestX Die X-Koordinate der nähesten Frontier in Weltkoordinaten
+* \param[out] outNearestY Die Y-Koordinate der nähesten Frontier in Weltkoordinaten
+* \param[out] outDistance (Optional) Die Wegdistanz in Metern; Kann NULL sein.
+* \return Null, wenn keine Frontier erreichbar ist, ansonsten die Anzahl der Frontier-Zellen.
+*/
+int findNearestReachableFrontier(const double startX, const double startY, double *outNearestX, double *outNearestY, double *outDistance);
+
+/**
+* Ermittelt das lohnendste erreichbare Frontier-Cluster.
+*
+* Die Frontier-Zellen werden zu zusammenhängenden Clustern gruppiert. Für
+* jedes erreichbare Cluster wird der Informationsgewinn einer Messung an
+* seiner Zielzelle per Strahlverfolgung des Lasermodells abgeschätzt und durch
+* die Wegkosten geteilt; die Bewertung erfolgt parallel über alle Kerne.
+* Cluster unterhalb einer Mindestgröße werden nur gewählt, wenn kein
+* größeres Cluster erreichbar ist. Liegt ein Cluster innerhalb der
+* Laserreichweite eines mit {\see frontier_claim} beanspruchten Ziels, wird
+* sein Gewinn anteilig zur Distanz gemindert, so dass sich mehrere Roboter
+* auf verschiedene Grenzen verteilen.
+*
+* \param[in] startX Die X-Koordinate des Startpunktes in Weltkoordinaten
+* \param[in] startY Die Y-Koordinate des Startpunktes in Weltkoordinaten
+* \param[out] outGoalX Die X-Koordinate des Ziels in Weltkoordinaten
+* \param[out] outGoalY Die Y-Koordinate des Ziels in Weltkoordinaten
+* \param[out] outDistance (Optional) Die Wegdistanz in Metern; Kann NULL sein.
+* \return Null, wenn keine Frontier erreichbar ist, -1, wenn für die Cluster kein
+* Speicher verfügbar war, ansonsten die Anzahl der Frontier-Zellen.
+*/
+int findBestFrontier(const double startX, const double startY, double *outGoalX, double *outGoalY, double *outDistance);
+
+/**
+* Verwirft alle beanspruchten Ziele. Wird zu Beginn jeder Suchrunde über
+* alle Roboter aufgerufen.
+*/
+void frontier_claims_clear(void);
+
+/**
+* Beansprucht das Ziel eines Roboters für den Rest der Suchrunde; die
+* folgenden Zielwahlen meiden seine Umgebung.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+*/
+void frontier_claim(const int x, const int y);
+
+/**
+* Ermittelt, ob ein Ziel näher als die halbe Laserreichweite an einem
+* beanspruchten Ziel liegt, z.B. um ein beibehaltenes Ziel aufzugeben.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Null, wenn das Ziel frei ist, ansonsten nicht-null.
+*/
+int frontier_claimed(const int x, const int y);
+
+/**
+* Liefert die erreichbaren Cluster der letzten Zielwahl.
+* \param[out] outClusters Zeiger auf die Cluster; gültig bis zum nächsten Aufruf von {\see findBestFrontier}
+* \return Anzahl der Cluster
+*/
+int frontier_clusters(const frontiercluster_t **outClusters);
+
+/**
+* Überträgt das Ergebnis der letzten Wellenfront-Ausbreitung in ein Anzeigebild.
+* \param[out] img Das Zielbild (8 Bit, 3 Kanäle, BGR)
+*/
+void frontier_render(IplImage *img);
+
 #endif
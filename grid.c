@@ -0,0 +1,252 @@
+/**
+* Belegungsgitter der Karte.
+*/
+
+#include "grid.h"
+#include "stdlib.h"
+#include "string.h"
+
+/**
+* Mindestanzahl der Kacheln, um die das Verzeichnis je Seite wächst
+*/
+#define GRID_GROWTH_TILES (4)
+
+/**
+* Aktualisiert den abgedeckten Zellbereich aus den Verzeichnisdaten.
+* \param[inout] grid Das Gitter
+*/
+static void updateExtent(grid_t *grid)
+{
+	grid->originX = grid->tileOriginX * GRID_TILE_SIZE;
+	grid->originY = grid->tileOriginY * GRID_TILE_SIZE;
+	grid->width   = grid->tilesX * GRID_TILE_SIZE;
+	grid->height  = grid->tilesY * GRID_TILE_SIZE;
+}
+
+/**
+* Erzeugt ein leeres Gitter.
+* \param[out] grid Das zu initialisierende Gitter
+* \param[in] width Anfängliche Breite in Zellen
+* \param[in] height Anfängliche Höhe in Zellen
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int grid_create(grid_t *grid, const int width, const int height)
+{
+	grid->tileOriginX = 0;
+	grid->tileOriginY = 0;
+	grid->tilesX = (width  + GRID_TILE_SIZE-1) / GRID_TILE_SIZE;
+	grid->tilesY = (height + GRID_TILE_SIZE-1) / GRID_TILE_SIZE;
+	grid->tileCount = 0;
+	grid->tiles = (grid_tile_t**)calloc((size_t)grid->tilesX*grid->tilesY, sizeof(grid_tile_t*));
+	updateExtent(grid);
+	return grid->tiles == (grid_tile_t**)0;
+}
+
+/**
+* Gibt den Speicher des Gitters frei.
+* \param[inout] grid Das Gitter
+*/
+void grid_destroy(grid_t *grid)
+{
+	if (grid->tiles != (grid_tile_t**)0)
+	{
+		for (int i = 0; i < grid->tilesX*grid->tilesY; ++i)
+		{
+			free(grid->tiles[i]);
+		}
+	}
+	free(grid->tiles);
+	grid->tiles = (grid_tile_t**)0;
+	grid->tilesX = grid->tilesY = 0;
+	grid->tileCount = 0;
+	updateExtent(grid);
+}
+
+/**
+* Setzt alle Zellen auf {\see GRID_CELL_UNKNOWN} zurück.
+* \param[inout] grid Das Gitter
+*/
+void grid_clear(grid_t *grid)
+{
+	for (int i = 0; i < grid->tilesX*grid->tilesY; ++i)
+	{
+		if (grid->tiles[i] != (grid_tile_t*)0)
+		{
+			memset(grid->tiles[i], 0, sizeof(grid_tile_t));
+			grid->tiles[i]->dirty = GRID_DIRTY_ALL;
+		}
+	}
+}
+
+/**
+* Vergrößert das Verzeichnis so, dass es die gegebene Kachel samt
+* umgebendem Rand enthält.
+* \param[inout] grid Das Gitter
+* \param[in] tx Die X-Kachelkoordinate
+* \param[in] ty Die Y-Kachelkoordinate
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+static int growDirectory(grid_t *grid, const int tx, const int ty)
+{
+	int minX = grid->tileOriginX;
+	int minY = grid->tileOriginY;
+	int maxX = grid->tileOriginX + grid->tilesX - 1;
+	int maxY = grid->tileOriginY + grid->tilesY - 1;
+
+	/* Mit Reserve wachsen, damit Vergrößerungen selten bleiben */
+	if (tx-1 < minX) minX = tx-1 - GRID_GROWTH_TILES;
+	if (ty-1 < minY) minY = ty-1 - GRID_GROWTH_TILES;
+	if (tx+1 > maxX) maxX = tx+1 + GRID_GROWTH_TILES;
+	if (ty+1 > maxY) maxY = ty+1 + GRID_GROWTH_TILES;
+
+	const int tilesX = maxX - minX + 1;
+	const int tilesY = maxY - minY + 1;
+	grid_tile_t **tiles = (grid_tile_t**)calloc((size_t)tilesX*tilesY, sizeof(grid_tile_t*));
+	if (tiles == (grid_tile_t**)0) return 1;
+
+	/* Kacheln in das neue Verzeichnis übertragen */
+	for (int y = 0; y < grid->tilesY; ++y)
+	{
+		memcpy(&tiles[(y + grid->tileOriginY - minY)*tilesX + (grid->tileOriginX - minX)],
+			&grid->tiles[y*grid->tilesX], grid->tilesX*sizeof(grid_tile_t*));
+	}
+
+	free(grid->tiles);
+	grid->tiles = tiles;
+	grid->tileOriginX = minX;
+	grid->tileOriginY = minY;
+	grid->tilesX = tilesX;
+	grid->tilesY = tilesY;
+	updateExtent(grid);
+	return 0;
+}
+
+/**
+* Legt die Kachel der gegebenen Koordinate an und vergrößert das Verzeichnis
+* bei Bedarf.
+* \param[inout] grid Das Gitter
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Zeiger auf das Zustandsbyte oder NULL, wenn kein Speicher verfügbar war
+*/
+const uint8_t* grid_cell_alloc(grid_t *grid, const int x, const int y)
+{
+	grid_tile_t *tile = grid_tile(grid, x, y);
+	if (tile != (grid_tile_t*)0) return &tile->cells[grid_tile_index(x, y)];
+
+	/* Rand um die neue Kachel sicherstellen */
+	const int tx = x >> GRID_TILE_SHIFT;
+	const int ty = y >> GRID_TILE_SHIFT;
+	if (tx-1 < grid->tileOriginX || tx+1 >= grid->tileOriginX + grid->tilesX
+	 || ty-1 < grid->tileOriginY || ty+1 >= grid->tileOriginY + grid->tilesY)
+	{
+		if (growDirectory(grid, tx, ty)) return (const uint8_t*)0;
+	}
+
+	tile = (grid_tile_t*)calloc(1, sizeof(grid_tile_t));
+	if (tile == (grid_tile_t*)0) return (const uint8_t*)0;
+
+	grid->tiles[(ty - grid->tileOriginY)*grid->tilesX + (tx - grid->tileOriginX)] = tile;
+	++grid->tileCount;
+	return &tile->cells[grid_tile_index(x, y)];
+}
+
+/**
+* Berechnet die Zusammenfassungen von Blöcken und Kachel aus den Zellen neu.
+* \param[inout] tile Die Kachel
+*/
+void grid_tile_summarize(grid_tile_t *tile)
+{
+	memset(tile->blocks, 0, sizeof(tile->blocks));
+	memset(&tile->summary, 0, sizeof(tile->summary));
+
+	for (int i = 0; i < GRID_TILE_CELLS; ++i)
+	{
+		const uint8_t cell = tile->cells[i];
+		if (!(cell & (GRID_CELL_CHARTED | GRID_CELL_FRONTIER))) continue;
+
+		grid_summary_t *block = &tile->blocks[grid_block_index(i & GRID_TILE_MASK, i >> GRID_TILE_SHIFT)];
+		block->charted   += (cell & GRID_CELL_CHARTED) != 0;
+		block->walls     += (cell & GRID_CELL_WALL) != 0;
+		block->frontiers += (cell & GRID_CELL_FRONTIER) != 0;
+	}
+
+	for (int b = 0; b < GRID_TILE_BLOCKS*GRID_TILE_BLOCKS; ++b)
+	{
+		tile->summary.charted   += tile->blocks[b].charted;
+		tile->summary.walls     += tile->blocks[b].walls;
+		tile->summary.frontiers += tile->blocks[b].frontiers;
+	}
+}
+
+/**
+* Führt einen Schnappschuss auf den Stand eines Gitters nach.
+* \param[inout] snapshot Der Schnappschuss
+* \param[inout] grid Das Quellgitter; {\see GRID_DIRTY_SNAPSHOT} wird zurückgesetzt
+* \return Anzahl der kopierten Kacheln oder -1, wenn kein Speicher verfügbar war
+*/
+int grid_sync(grid_t *snapshot, grid_t *grid)
+{
+	/* Verzeichnis übernehmen; vorhandene Kacheln werden nur umgehängt */
+	if (snapshot->tileOriginX != grid->tileOriginX || snapshot->tileOriginY != grid->tileOriginY
+	 || snapshot->tilesX != grid->tilesX || snapshot->tilesY != grid->tilesY)
+	{
+		grid_tile_t **tiles = (grid_tile_t**)calloc((size_t)grid->tilesX*grid->tilesY, sizeof(grid_tile_t*));
+		if (tiles == (grid_tile_t**)0) return -1;
+
+		for (int y = 0; y < snapshot->tilesY; ++y)
+		{
+			for (int x = 0; x < snapshot->tilesX; ++x)
+			{
+				grid_tile_t *tile = snapshot->tiles[y*snapshot->tilesX + x];
+				if (tile == (grid_tile_t*)0) continue;
+
+				const unsigned tx = (unsigned)(snapshot->tileOriginX + x - grid->tileOriginX);
+				const unsigned ty = (unsigned)(snapshot->tileOriginY + y - grid->tileOriginY);
+				if (tx < (unsigned)grid->tilesX && ty < (unsigned)grid->tilesY)
+				{
+					tiles[ty*grid->tilesX + tx] = tile;
+				}
+				else
+				{
+					free(tile);
+					--snapshot->tileCount;
+				}
+			}
+		}
+
+		free(snapshot->tiles);
+		snapshot->tiles = tiles;
+		snapshot->tileOriginX = grid->tileOriginX;
+		snapshot->tileOriginY = grid->tileOriginY;
+		snapshot->tilesX = grid->tilesX;
+		snapshot->tilesY = grid->tilesY;
+		updateExtent(snapshot);
+	}
+
+	/* Neue und veränderte Kacheln kopieren */
+	int copied = 0;
+	for (int i = 0; i < grid->tilesX*grid->tilesY; ++i)
+	{
+		grid_tile_t *tile = grid->tiles[i];
+		if (tile == (grid_tile_t*)0) continue;
+
+		grid_tile_t *copy = snapshot->tiles[i];
+		if (copy == (grid_tile_t*)0)
+		{
+			copy = (grid_tile_t*)malloc(sizeof(grid_tile_t));
+			if (copy == (grid_tile_t*)0) return -1;
+			snapshot->tiles[i] = copy;
+			++snapshot->tileCount;
+		}
+		else if (!(tile->dirty & GRID_DIRTY_SNAPSHOT))
+		{
+			continue;
+		}
+
+		tile->dirty &= ~GRID_DIRTY_SNAPSHOT;
+		memcpy(copy, tile, sizeof(grid_tile_t));
+		++copied;
+	}
+	return copied;
+}
@@ -0,0 +1,455 @@
+/**
+* Belegungsgitter der Karte.
+*
+* Jede Zelle wird durch ein einzelnes Zustandsbyte beschrieben, dessen Bits
+* die Zustände "gesehen", "Wand" und "befahren" kodieren. Die OpenCV-Bilder
+* werden ausschließlich zur Anzeige aus diesem Gitter erzeugt.
+*
+* Das Gitter ist in Kacheln fester Größe unterteilt, die erst beim ersten
+* Schreibzugriff angelegt werden. Ein Verzeichnis von Kachelzeigern deckt den
+* bisher benötigten Bereich ab und wächst bei Bedarf in jede Richtung, so dass
+* Kartenkoordinaten auch negativ werden dürfen. Nicht angelegte Kacheln gelten
+* als unbekannt.
+*
+* Über den Zellen wird eine Pyramide aus Zusammenfassungen gepflegt: Jede
+* Kachel und jeder 8x8-Block innerhalb einer Kachel zählt seine kartierten
+* Zellen, Wände und Frontier-Zellen. Damit lässt sich ohne Blick auf die
+* einzelnen Zellen entscheiden, ob ein Bereich vollständig bekannt ist,
+* Unbekanntes oder Wände enthält, so dass Abfragen ganze Bereiche
+* überspringen können. Zustandsänderungen müssen daher über
+* {\see grid_write} erfolgen.
+*
+* Neben dem Zustandsbyte trägt jede Zelle die Log-Odds ihrer Belegung als
+* 8-Bit-Festkommazahl. Treffer und Durchgänge eines Strahls werden sättigend
+* aufaddiert; das Wand-Bit des Zustandsbytes ist das Ergebnis einer
+* Schwellwertabfrage mit Hysterese auf diesen Werten, so dass Wände durch
+* spätere Messungen (Rauschen, bewegte Objekte) auch wieder verschwinden.
+*
+* Geänderte Kacheln werden markiert, so dass ein Schnappschuss des Gitters
+* mit {\see grid_sync} kachelweise nachgeführt werden kann. Jeder Abnehmer
+* von Änderungen besitzt ein eigenes Bit der Marke.
+*
+* Das Gitter selbst ist nicht threadsicher. Parallele Schreiber auf
+* verschiedenen Kacheln synchronisieren sich über die Sperre je Kachel
+* ({\see grid_tile_lock}); Anlegen von Kacheln, Wachstum des Verzeichnisses
+* und {\see grid_sync} müssen exklusiv erfolgen.
+*/
+
+#ifndef GRID_H
+#define GRID_H
+
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+
+/**
+* Zelle ist unbekannt
+*/
+#define GRID_CELL_UNKNOWN	(0x00)
+
+/**
+* Zelle liegt auf einer Sichtlinie, deren Strahl keine Wand getroffen hat
+*/
+#define GRID_CELL_SEEN		(0x01)
+
+/**
+* Zelle liegt auf einer Sichtlinie, deren Strahl eine Wand getroffen hat
+*/
+#define GRID_CELL_SEEN_HIT	(0x02)
+
+/**
+* Zelle ist eine Wand
+*/
+#define GRID_CELL_WALL		(0x04)
+
+/**
+* Zelle wurde vom Roboter befahren
+*/
+#define GRID_CELL_TRACK		(0x08)
+
+/**
+* Zelle ist kartiert, begehbar und grenzt an unkartierten Raum
+*/
+#define GRID_CELL_FRONTIER	(0x10)
+
+/**
+* Maske der Verwaltungsbits der Frontier-Erkennung
+*/
+#define GRID_CELL_FRONTIER_MASK	(GRID_CELL_FRONTIER)
+
+/**
+* Maske aller Zustände, die eine Zelle als kartiert kennzeichnen
+*/
+#define GRID_CELL_CHARTED	(GRID_CELL_SEEN | GRID_CELL_SEEN_HIT | GRID_CELL_WALL | GRID_CELL_TRACK)
+
+/**
+* Log-Odds-Änderung einer Zelle, in der ein Strahl endet (1/16 Festkomma, ~0.85)
+*/
+#define GRID_ODDS_HIT		(14)
+
+/**
+* Log-Odds-Änderung einer Zelle, die ein Strahl durchquert (1/16 Festkomma, ~-0.4)
+*/
+#define GRID_ODDS_MISS		(-6)
+
+/**
+* Untere Sättigungsgrenze der Log-Odds
+*/
+#define GRID_ODDS_MIN		(-48)
+
+/**
+* Obere Sättigungsgrenze der Log-Odds; begrenzt die Anzahl der Durchgänge,
+* die eine sicher belegte Zelle wieder freigeben
+*/
+#define GRID_ODDS_MAX		(64)
+
+/**
+* Log-Odds, ab denen eine Zelle als Wand gilt
+*/
+#define GRID_ODDS_OCCUPIED	(8)
+
+/**
+* Log-Odds, bei und unter denen eine Wand wieder als frei gilt
+*/
+#define GRID_ODDS_FREE		(-4)
+
+/**
+* Zweierlogarithmus der Kantenlänge einer Kachel
+*/
+#define GRID_TILE_SHIFT		(6)
+
+/**
+* Kantenlänge einer Kachel in Zellen
+*/
+#define GRID_TILE_SIZE		(1 << GRID_TILE_SHIFT)
+
+/**
+* Maske der Zellkoordinate innerhalb einer Kachel
+*/
+#define GRID_TILE_MASK		(GRID_TILE_SIZE - 1)
+
+/**
+* Zweierlogarithmus der Kantenlänge eines Blockes
+*/
+#define GRID_BLOCK_SHIFT	(3)
+
+/**
+* Kantenlänge eines Blockes in Zellen
+*/
+#define GRID_BLOCK_SIZE		(1 << GRID_BLOCK_SHIFT)
+
+/**
+* Maske der Zellkoordinate innerhalb eines Blockes
+*/
+#define GRID_BLOCK_MASK		(GRID_BLOCK_SIZE - 1)
+
+/**
+* Anzahl der Zellen eines Blockes
+*/
+#define GRID_BLOCK_CELLS	(GRID_BLOCK_SIZE * GRID_BLOCK_SIZE)
+
+/**
+* Kantenlänge einer Kachel in Blöcken
+*/
+#define GRID_TILE_BLOCKS	(GRID_TILE_SIZE / GRID_BLOCK_SIZE)
+
+/**
+* Anzahl der Zellen einer Kachel
+*/
+#define GRID_TILE_CELLS		(GRID_TILE_SIZE * GRID_TILE_SIZE)
+
+/**
+* Änderungsmarke: Kachel seit dem letzten {\see grid_sync} verändert
+*/
+#define GRID_DIRTY_SNAPSHOT	(0x01)
+
+/**
+* Änderungsmarke: Kachel seit der letzten Veröffentlichung verändert (\see mapshm.h)
+*/
+#define GRID_DIRTY_PUBLISH	(0x02)
+
+/**
+* Alle Änderungsmarken; wird bei jeder Änderung gesetzt
+*/
+#define GRID_DIRTY_ALL		(GRID_DIRTY_SNAPSHOT | GRID_DIRTY_PUBLISH)
+
+/**
+* Zusammenfassung eines Bereiches der Karte
+*/
+typedef struct {
+	uint16_t charted;	/*! Anzahl der kartierten Zellen */
+	uint16_t walls;		/*! Anzahl der Wandzellen */
+	uint16_t frontiers;	/*! Anzahl der Frontier-Zellen */
+} grid_summary_t;
+
+/**
+* Kachel des Gitters
+*/
+typedef struct {
+	uint8_t cells[GRID_TILE_SIZE*GRID_TILE_SIZE];					/*! Zeilenweise abgelegte Zellzustände */
+	int8_t odds[GRID_TILE_SIZE*GRID_TILE_SIZE];						/*! Log-Odds der Belegung je Zelle, zeilenweise */
+	grid_summary_t blocks[GRID_TILE_BLOCKS*GRID_TILE_BLOCKS];		/*! Zusammenfassung je Block, zeilenweise */
+	grid_summary_t summary;											/*! Zusammenfassung der Kachel */
+	uint8_t dirty;													/*! Änderungsmarken je Abnehmer, z.B. {\see GRID_DIRTY_SNAPSHOT} */
+	uint32_t lock;													/*! Sperre paralleler Schreiber (\see grid_tile_lock) */
+} grid_tile_t;
+
+/**
+* Belegungsgitter
+*/
+typedef struct {
+	int tileOriginX;	/*! X-Kachelkoordinate der ersten Verzeichnisspalte */
+	int tileOriginY;	/*! Y-Kachelkoordinate der ersten Verzeichniszeile */
+	int tilesX;			/*! Breite des Verzeichnisses in Kacheln */
+	int tilesY;			/*! Höhe des Verzeichnisses in Kacheln */
+	int originX;		/*! X-Koordinate der ersten abgedeckten Zelle */
+	int originY;		/*! Y-Koordinate der ersten abgedeckten Zelle */
+	int width;			/*! Breite des abgedeckten Bereiches in Zellen */
+	int height;			/*! Höhe des abgedeckten Bereiches in Zellen */
+	grid_tile_t **tiles;	/*! Kachelverzeichnis, zeilenweise; NULL für nicht angelegte Kacheln */
+	int tileCount;		/*! Anzahl der angelegten Kacheln */
+} grid_t;
+
+/**
+* Erzeugt ein leeres Gitter, dessen Verzeichnis zunächst den Bereich
+* {0,0}..{width,height} abdeckt.
+* \param[out] grid Das zu initialisierende Gitter
+* \param[in] width Anfängliche Breite in Zellen
+* \param[in] height Anfängliche Höhe in Zellen
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int grid_create(grid_t *grid, const int width, const int height);
+
+/**
+* Gibt den Speicher des Gitters frei.
+* \param[inout] grid Das Gitter
+*/
+void grid_destroy(grid_t *grid);
+
+/**
+* Setzt alle Zellen auf {\see GRID_CELL_UNKNOWN} zurück.
+* \param[inout] grid Das Gitter
+*/
+void grid_clear(grid_t *grid);
+
+/**
+* Führt einen Schnappschuss auf den Stand eines Gitters nach.
+*
+* Verzeichnis und Ausdehnung werden übernommen; kopiert werden nur Kacheln,
+* die seit dem letzten Abgleich neu angelegt oder über {\see grid_write}
+* verändert wurden. Die Marke {\see GRID_DIRTY_SNAPSHOT} der Quelle wird
+* dabei zurückgesetzt, je Quelle darf es daher nur einen Schnappschuss geben.
+* \param[inout] snapshot Der Schnappschuss
+* \param[inout] grid Das Quellgitter
+* \return Anzahl der kopierten Kacheln oder -1, wenn kein Speicher verfügbar war
+*/
+int grid_sync(grid_t *snapshot, grid_t *grid);
+
+/**
+* Legt die Kachel der gegebenen Koordinate an und vergrößert das Verzeichnis
+* bei Bedarf. Um jede angelegte Kachel bleibt stets ein Rand nicht angelegter
+* Kacheln im Verzeichnis, so dass der abgedeckte Bereich immer von
+* unbekannten Zellen umschlossen ist.
+* \param[inout] grid Das Gitter
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Zeiger auf das Zustandsbyte oder NULL, wenn kein Speicher verfügbar war
+*/
+const uint8_t* grid_cell_alloc(grid_t *grid, const int x, const int y);
+
+/**
+* Berechnet die Zusammenfassungen von Blöcken und Kachel aus den Zellen neu,
+* z.B. nachdem die Zellen ohne {\see grid_write} gefüllt wurden.
+* \param[inout] tile Die Kachel
+*/
+void grid_tile_summarize(grid_tile_t *tile);
+
+/**
+* Ermittelt, ob eine Koordinate innerhalb des vom Verzeichnis abgedeckten Bereiches liegt.
+* \param[in] grid Das Gitter
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Null, wenn die Koordinate außerhalb liegt, ansonsten nicht-null.
+*/
+static inline int grid_contains(const grid_t *const grid, const int x, const int y)
+{
+	return (unsigned)(x - grid->originX) < (unsigned)grid->width
+		&& (unsigned)(y - grid->originY) < (unsigned)grid->height;
+}
+
+/**
+* Liefert die Kachel einer Koordinate.
+* \param[in] grid Das Gitter
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Zeiger auf die Kachel oder NULL, wenn sie nicht angelegt ist
+*/
+static inline grid_tile_t* grid_tile(const grid_t *const grid, const int x, const int y)
+{
+	const unsigned tx = (unsigned)((x >> GRID_TILE_SHIFT) - grid->tileOriginX);
+	const unsigned ty = (unsigned)((y >> GRID_TILE_SHIFT) - grid->tileOriginY);
+	if (tx >= (unsigned)grid->tilesX || ty >= (unsigned)grid->tilesY) return (grid_tile_t*)0;
+	return grid->tiles[ty*grid->tilesX + tx];
+}
+
+/**
+* Index einer Zelle innerhalb ihrer Kachel
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Der Index
+*/
+static inline int grid_tile_index(const int x, const int y)
+{
+	return ((y & GRID_TILE_MASK) << GRID_TILE_SHIFT) | (x & GRID_TILE_MASK);
+}
+
+/**
+* Liefert den Zustand einer Zelle.
+* \param[in] grid Das Gitter
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Das Zustandsbyte oder {\see GRID_CELL_UNKNOWN} außerhalb angelegter Kacheln
+*/
+static inline uint8_t grid_get(const grid_t *const grid, const int x, const int y)
+{
+	const grid_tile_t *tile = grid_tile(grid, x, y);
+	if (tile == (grid_tile_t*)0) return GRID_CELL_UNKNOWN;
+	return tile->cells[grid_tile_index(x, y)];
+}
+
+/**
+* Liefert einen Zeiger auf eine Zelle, ohne Kacheln anzulegen.
+* Der Zeiger darf nur gelesen werden; Änderungen erfolgen über {\see grid_write}.
+* \param[in] grid Das Gitter
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Zeiger auf das Zustandsbyte oder NULL außerhalb angelegter Kacheln
+*/
+static inline const uint8_t* grid_cell(const grid_t *const grid, const int x, const int y)
+{
+	const grid_tile_t *tile = grid_tile(grid, x, y);
+	if (tile == (grid_tile_t*)0) return (const uint8_t*)0;
+	return &tile->cells[grid_tile_index(x, y)];
+}
+
+/**
+* Liefert die Log-Odds der Belegung einer Zelle.
+* \param[in] grid Das Gitter
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Die Log-Odds oder 0 außerhalb angelegter Kacheln
+*/
+static inline int8_t grid_odds(const grid_t *const grid, const int x, const int y)
+{
+	const grid_tile_t *tile = grid_tile(grid, x, y);
+	if (tile == (grid_tile_t*)0) return 0;
+	return tile->odds[grid_tile_index(x, y)];
+}
+
+/**
+* Addiert eine Änderung sättigend auf Log-Odds. Die Begrenzung erfolgt über
+* Minimum und Maximum ohne Sprünge.
+* \param[in] odds Die bisherigen Log-Odds
+* \param[in] delta Die Änderung, z.B. {\see GRID_ODDS_HIT} oder {\see GRID_ODDS_MISS}
+* \return Die auf {\see GRID_ODDS_MIN}..{\see GRID_ODDS_MAX} begrenzte Summe
+*/
+static inline int8_t grid_odds_add(const int8_t odds, const int delta)
+{
+	int sum = odds + delta;
+	sum = (sum < GRID_ODDS_MIN) ? GRID_ODDS_MIN : sum;
+	sum = (sum > GRID_ODDS_MAX) ? GRID_ODDS_MAX : sum;
+	return (int8_t)sum;
+}
+
+/**
+* Sperrt eine Kachel für parallele Schreiber. Wer mehrere Kacheln sperrt,
+* muss dies in aufsteigender Reihenfolge der Verzeichnisindizes tun.
+* \param[inout] tile Die Kachel
+*/
+static inline void grid_tile_lock(grid_tile_t *const tile)
+{
+	while (__atomic_exchange_n(&tile->lock, 1, __ATOMIC_ACQUIRE))
+	{
+		/* Sperren werden nur für die Dauer eines Scans gehalten */
+		while (__atomic_load_n(&tile->lock, __ATOMIC_RELAXED)) sched_yield();
+	}
+}
+
+/**
+* Gibt eine mit {\see grid_tile_lock} gesperrte Kachel frei.
+* \param[inout] tile Die Kachel
+*/
+static inline void grid_tile_unlock(grid_tile_t *const tile)
+{
+	__atomic_store_n(&tile->lock, 0, __ATOMIC_RELEASE);
+}
+
+/**
+* Index des Blockes einer Zelle innerhalb ihrer Kachel
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Der Index
+*/
+static inline int grid_block_index(const int x, const int y)
+{
+	return ((y & GRID_TILE_MASK) >> GRID_BLOCK_SHIFT) * GRID_TILE_BLOCKS + ((x & GRID_TILE_MASK) >> GRID_BLOCK_SHIFT);
+}
+
+/**
+* Liefert die Zusammenfassung des Blockes einer Zelle.
+* \param[in] grid Das Gitter
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Die Zusammenfassung oder NULL außerhalb angelegter Kacheln
+*/
+static inline const grid_summary_t* grid_block(const grid_t *const grid, const int x, const int y)
+{
+	const grid_tile_t *tile = grid_tile(grid, x, y);
+	if (tile == (grid_tile_t*)0) return (const grid_summary_t*)0;
+	return &tile->blocks[grid_block_index(x, y)];
+}
+
+/**
+* Ermittelt, ob der Block einer Zelle vollständig kartiert ist und keine Wand enthält.
+* \param[in] grid Das Gitter
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Null, wenn der Block Unbekanntes oder Wände enthält, ansonsten nicht-null.
+*/
+static inline int grid_block_is_open(const grid_t *const grid, const int x, const int y)
+{
+	const grid_summary_t *block = grid_block(grid, x, y);
+	return block != (const grid_summary_t*)0 && block->charted == GRID_BLOCK_CELLS && block->walls == 0;
+}
+
+/**
+* Setzt den Zustand einer Zelle und pflegt die Zusammenfassungen von Block
+* und Kachel. Die Kachel muss bereits angelegt sein (\see grid_cell_alloc).
+* \param[inout] grid Das Gitter
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \param[in] value Der neue Zustand
+*/
+static inline void grid_write(grid_t *const grid, const int x, const int y, const uint8_t value)
+{
+	grid_tile_t *tile = grid_tile(grid, x, y);
+	uint8_t *cell = &tile->cells[grid_tile_index(x, y)];
+	const uint8_t old = *cell;
+	*cell = value;
+	tile->dirty = GRID_DIRTY_ALL;
+
+	const int charted   = ((value & GRID_CELL_CHARTED) != 0)  - ((old & GRID_CELL_CHARTED) != 0);
+	const int walls     = ((value & GRID_CELL_WALL) != 0)     - ((old & GRID_CELL_WALL) != 0);
+	const int frontiers = ((value & GRID_CELL_FRONTIER) != 0) - ((old & GRID_CELL_FRONTIER) != 0);
+	if ((charted | walls | frontiers) == 0) return;
+
+	grid_summary_t *block = &tile->blocks[grid_block_index(x, y)];
+	block->charted   += charted;
+	block->walls     += walls;
+	block->frontiers += frontiers;
+	tile->summary.charted   += charted;
+	tile->summary.walls     += walls;
+	tile->summary.frontiers += frontiers;
+}
+
+#endif
@@ -1,5 +1,9 @@
 #include "map.h"
 #include "opencv/cv.h"
+#ifndef MAP_HEADLESS
+#include "opencv/highgui.h"
+#endif
+#include "pthread.h"
 #include "stdio.h"
 #include "stdlib.h"
 #include "math.h"
@@ -10,247 +14,1042 @@
 #include "laser.h"
 #include "frontier.h"
 #include "transforms.h"
+#include "planner.h"
+#include "explorer.h"
+#include "mapfile.h"
+#include "mapshm.h"
+#include "scanmatch.h"
+#include "esdf.h"
+#include "metrics.h"
+
+/**
+* Anzeigeintervall des Darstellungs-Threads in Millisekunden
+*/
+#define MAP_DISPLAY_INTERVAL_MS 40
+
+/**
+* Seitenlänge des Fensters um den Roboter in Zellen, in dem die Zellen eines
+* Scans entdoppelt werden; deckt die Laserreichweite samt Wandstärke ab
+*/
+#define MAP_WINDOW_SIZE 256
+
+/**
+* Anzeigebilder eines Frames
+*/
+typedef struct {
+	IplImage *map;			/*! Karte mit Markierungen */
+	IplImage *frontier;		/*! Frontier-Zellen und Wellenfront */
+} mapframe_t;
 
+#ifndef MAP_HEADLESS
 static const char* mapwin = "Robot Map";
 static const char* testwin = "Frontier Detection";
-static IplImage* mapimg  = NULL;     // Image of the map
-static IplImage* mapimga = NULL;     /* Annotations für die Karte */
-IplImage* maptest = NULL;     /* Bild für den Scan-Algorithmus */
+#endif
+grid_t mapgrid;               /* Belegungsgitter der Karte */
+grid_t searchgrid;            /* Schnappschuss für die Hintergrundsuche */
 static int initialized = 0;
+static int headless = 0;      /* Nicht-null, wenn keine Anzeige erfolgt */
+static int quiet = 0;         /* Nicht-null, wenn keine Suchergebnisse ausgegeben werden */
+static const char *publishName = (const char*)0;  /* Name des Segmentes für andere Prozesse oder NULL */
+static mapshm_writer_t publisher;       /* Veröffentlichung der Karte (\see mapshm.h) */
+static int scanmatching = 0;  /* Nicht-null, wenn Scans vor dem Eintragen abgeglichen werden */
 
-int map_init();
-int map_show(void);
+/**
+* Vorgemerkte Beobachtung einer Zelle
+*/
+typedef struct {
+	int x;				/*! X-Koordinate in Kartenkoordinaten */
+	int y;				/*! Y-Koordinate in Kartenkoordinaten */
+	int8_t delta;		/*! {\see GRID_ODDS_HIT} oder {\see GRID_ODDS_MISS} */
+	uint8_t seen;		/*! Zu setzende Sichtbits */
+	uint8_t wall;		/*! Nach dem Eintragen nicht-null, wenn sich das Wand-Bit geändert hat */
+} mapupdate_t;
 
 /**
-* Ermittelt, ob eine Koordinate auf der Karte kartierter Raum ist.
-* \param[in] x Die X-Koordinate in Kartenkoordinaten
-* \param[in] y Die Y-Koordinate in Kartenkoordinaten
-* \return Null, wenn die Koordinate unkartiert ist, ansonsten nicht-null.
+* Kartierungszustand eines Roboters.
+*
+* Ein Scan wird zunächst ohne Sperre in die Liste der Beobachtungen
+* übersetzt; jede Zelle wird dabei über das Fenster um den Roboter nur
+* einmal vorgemerkt. Erst das Eintragen der Liste sperrt die betroffenen
+* Kacheln, so dass Roboter in verschiedenen Bereichen parallel kartieren.
+*/
+typedef struct {
+	laserscan_t scan;			/*! Der zuletzt transformierte Scan */
+	mapupdate_t *updates;		/*! Vorgemerkte Beobachtungen, Treffer zuerst */
+	int updateCount;			/*! Anzahl der vorgemerkten Beobachtungen */
+	int updateCapacity;			/*! Kapazität der Liste */
+	uint64_t window[MAP_WINDOW_SIZE*MAP_WINDOW_SIZE/64];	/*! Ein Bit je vorgemerkter Zelle, zeilenweise */
+	int windowX;				/*! X-Koordinate der ersten Zelle des Fensters */
+	int windowY;				/*! Y-Koordinate der ersten Zelle des Fensters */
+	int minX;					/*! Umschließendes Rechteck der Beobachtungen in Kartenkoordinaten */
+	int minY;
+	int maxX;
+	int maxY;
+	double px;					/*! Letzte X-Position in Weltkoordinaten; für die Anzeige */
+	double py;					/*! Letzte Y-Position in Weltkoordinaten; für die Anzeige */
+	double pa;					/*! Letzte Orientierung; für die Ablage */
+	int posed;					/*! Nicht-null, sobald die Pose bekannt ist (Messung oder Ablage) */
+	int active;					/*! Nicht-null, sobald der Roboter eine Messung eingetragen hat */
+	scanmatch_t matcher;		/*! Abgleich der Scans mit der Karte; nur bei {\see scanmatching} */
+	scanmatch_correction_t correction;	/*! Korrektur der Odometrie für die Regelung; unter {\see correctionLock} */
+	uint32_t reportedSearch;	/*! Nummer des zuletzt ausgegebenen Suchergebnisses */
+} maprobot_t;
+
+static maprobot_t robots[MAP_MAX_ROBOTS];
+static int activeRobots = 0;         /* Anzahl der Roboter, die bereits kartiert haben */
+
+/* Lesend gehalten, solange Roboter Kacheln beschreiben; schreibend beim
+ * Anlegen von Kacheln, beim Nachführen des Schnappschusses und beim Zeichnen */
+static pthread_rwlock_t directoryLock = PTHREAD_RWLOCK_INITIALIZER;
+
+/* Schützt die Korrekturen der Odometrie, die die Regelung parallel liest */
+static pthread_mutex_t correctionLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Schützt die Posen beim Schreiben gegen {\see map_pose}, das nur unter
+ * dieser Sperre liest; Leser unter der Schreibsperre von directoryLock
+ * benötigen sie nicht. Wird zuletzt gesperrt. */
+static pthread_mutex_t poseLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Abstand jeder Zelle zur nächsten Wand (\see esdf.h). Wandwechsel werden
+ * unter den Sperren ihrer Kacheln gemeldet, damit die Reihenfolge der
+ * Meldungen je Zelle der des Gitters entspricht; nachgeführt wird danach.
+ * Sperrfolge: directoryLock, Kacheln, esdfLock */
+static esdf_t esdf;
+static pthread_mutex_t esdfLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Doppelpuffer: frames[front] wird angezeigt, der andere vom Kartierungs-
+ * Thread beschrieben. frameReady kennzeichnet einen fertigen, noch nicht
+ * übernommenen hinteren Puffer. */
+static mapframe_t frames[2] = { { (IplImage*)0, (IplImage*)0 }, { (IplImage*)0, (IplImage*)0 } };
+static int front = 0;
+static int frameReady = 0;
+
+#ifndef MAP_HEADLESS
+static pthread_t displayThread;
+static pthread_mutex_t displayMutex = PTHREAD_MUTEX_INITIALIZER;
+static int displayRunning = 0;
+
+/**
+* Darstellungs-Thread. Übernimmt in festem Takt den zuletzt fertiggestellten
+* Frame und bedient die Fensterereignisse; sämtliche HighGUI-Aufrufe erfolgen
+* in diesem Thread.
 */
-int isCharted(const int x, const int y)
+static void* map_display(void *arg)
 {
-	const CvScalar s = cvGet2D(mapimg, y, x);
-	
-	/* - Grün-Komponente (0x00FF00) entspricht gesehenen Orten 
-	 * - Weiß (0xFFFFFF) entspricht Wänden.
-	 * Da weiß grün beinhaltet, reicht ein Test auf Grün.
-	 *
-	 * FIX:
-	 * Der befahrene Pfad wird allerdings verbucht, daher muss ein zusätzlicher
-	 * Test auf ROT (0x0000FF) erfolgen.
-     */
-	return s.val[1] > 0 || s.val[2] > 0;
+	cvNamedWindow( mapwin, 1 );
+	cvNamedWindow( testwin, 1 );
+
+	pthread_mutex_lock(&displayMutex);
+	while (displayRunning)
+	{
+		/* Puffer tauschen, sofern ein neuer Frame vorliegt */
+		const mapframe_t *frame = (mapframe_t*)0;
+		if (frameReady)
+		{
+			front = 1-front;
+			frameReady = 0;
+			frame = &frames[front];
+		}
+		pthread_mutex_unlock(&displayMutex);
+
+		/* Der vordere Puffer wird bis zum nächsten Tausch nicht beschrieben */
+		if (frame != (mapframe_t*)0)
+		{
+			cvShowImage(mapwin, frame->map);
+			cvShowImage(testwin, frame->frontier);
+		}
+		cvWaitKey(MAP_DISPLAY_INTERVAL_MS);
+
+		pthread_mutex_lock(&displayMutex);
+	}
+	pthread_mutex_unlock(&displayMutex);
+
+	cvDestroyWindow(mapwin);
+	cvDestroyWindow(testwin);
+	return (void*)0;
 }
+#endif
 
 /**
-* Ermittelt, ob eine Koordinate auf der Karte eine Wand ist.
-* \param[in] x Die X-Koordinate in Kartenkoordinaten
-* \param[in] y Die Y-Koordinate in Kartenkoordinaten
-* \return Null, wenn die Koordinate keine Wand ist, ansonsten nicht-null.
+* Legt fest, ob die Karte ohne Anzeige (und damit ohne X11) betrieben wird.
+* Muss vor dem ersten Aufruf von {\see map_draw} erfolgen.
+* \param[in] enable Nicht-null, um die Anzeige abzuschalten
 */
-int isWall(const int x, const int y)
+void map_set_headless(const int enable)
 {
-	if (x < 0 || x >= MAP_SIZE_X) return 0;
-	if (y < 0 || y >= MAP_SIZE_Y) return 0;
-	const CvScalar s = cvGet2D(mapimg, y, x);
-	return (s.val[0] > 0) && (s.val[1] > 0) && (s.val[2] > 0);
+	if (initialized) return;
+	headless = enable;
 }
 
-int map_init()
+/**
+* Unterdrückt die Ausgabe der Suchergebnisse auf stdout.
+* \param[in] enable Nicht-null, um die Ausgabe abzuschalten
+*/
+void map_set_quiet(const int enable)
+{
+	quiet = enable;
+}
+
+/**
+* Veröffentlicht die Karte für andere Prozesse im gemeinsamen Speicher.
+* Muss vor dem ersten Aufruf von {\see map_draw} erfolgen.
+* \param[in] name Der Name des Segmentes oder NULL, um nicht zu veröffentlichen
+*/
+void map_set_publish(const char *name)
+{
+	if (initialized) return;
+	publishName = name;
+}
+
+/**
+* Gleicht Scans vor dem Eintragen mit der Karte ab, um die Drift der
+* Odometrie zu korrigieren. Muss vor dem ersten Aufruf von {\see map_draw}
+* erfolgen.
+* \param[in] enable Nicht-null, um den Abgleich einzuschalten
+*/
+void map_set_scanmatch(const int enable)
+{
+	if (initialized) return;
+	scanmatching = enable;
+}
+
+/**
+* Legt Karte, Such-Thread und Anzeige an.
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int map_init(void)
 {
 	if (initialized) { return 1; }
-	mapimg  = cvCreateImage(cvSize(MAP_SIZE_X,MAP_SIZE_Y),8,3);
-	mapimga = cvCreateImage(cvSize(MAP_SIZE_X,MAP_SIZE_Y),8,3);
-	maptest = cvCreateImage(cvSize(MAP_SIZE_X,MAP_SIZE_Y),8,3);
-	cvZero(mapimg);
-	// create window
-	cvNamedWindow( mapwin, 1 );
-	cvNamedWindow( testwin, 1 );
+#ifdef MAP_HEADLESS
+	headless = 1;
+#endif
+	if (grid_create(&mapgrid, MAP_SIZE_X, MAP_SIZE_Y)) { return 1; }
+	if (grid_create(&searchgrid, MAP_SIZE_X, MAP_SIZE_Y)) { grid_destroy(&mapgrid); return 1; }
+	if (esdf_create(&esdf)) { esdf_destroy(&esdf); grid_destroy(&searchgrid); grid_destroy(&mapgrid); return 1; }
+	if (frontier_init() || explorer_init())
+	{
+		frontier_shutdown();
+		esdf_destroy(&esdf);
+		grid_destroy(&searchgrid);
+		grid_destroy(&mapgrid);
+		return 1;
+	}
+
+	for (int i = 0; scanmatching && i < MAP_MAX_ROBOTS; ++i)
+	{
+		if (scanmatch_init(&robots[i].matcher))
+		{
+			for (int j = 0; j < i; ++j) scanmatch_free(&robots[j].matcher);
+			explorer_shutdown();
+			frontier_shutdown();
+			esdf_destroy(&esdf);
+			grid_destroy(&searchgrid);
+			grid_destroy(&mapgrid);
+			return 1;
+		}
+	}
+
+	/* Ohne Segment wird nur nicht veröffentlicht; die Kartierung läuft trotzdem */
+	if (publishName != (const char*)0 && mapshm_create(&publisher, publishName))
+	{
+		fprintf(stderr, "Karte kann nicht unter %s veröffentlicht werden.\n", publishName);
+	}
+
+#ifndef MAP_HEADLESS
+	/* Anzeige in eigenem Thread, damit die Regelung nicht auf die GUI wartet */
+	if (!headless)
+	{
+		displayRunning = 1;
+		if (pthread_create(&displayThread, (const pthread_attr_t*)0, map_display, (void*)0) != 0)
+		{
+			displayRunning = 0;
+			mapshm_destroy(&publisher);
+			for (int i = 0; scanmatching && i < MAP_MAX_ROBOTS; ++i) scanmatch_free(&robots[i].matcher);
+			explorer_shutdown();
+			frontier_shutdown();
+			esdf_destroy(&esdf);
+			grid_destroy(&searchgrid);
+			grid_destroy(&mapgrid);
+			return 1;
+		}
+	}
+#endif
+
 	initialized=1;
 	return 0;
 }
 
 /**
-* Addiert einen Farbwert {r,g,b} auf den gegebenen Pixel {x,y}
-* \param[in] x Die X-Koordinate
-* \param[in] y Die Y-Koordinate
-* \param[in] r Der R-Wert
-* \param[in] g Der G-Wert
-* \param[in] b Der B-Wert
+* Trägt eine Beobachtung in die Log-Odds einer Zelle ein und leitet daraus
+* ihren Zustand ab. Die Kachel der Zelle und ihrer Nachbarn muss gesperrt sein.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \param[in] delta {\see GRID_ODDS_HIT} oder {\see GRID_ODDS_MISS}
+* \param[in] seen Zu setzende Sichtbits ({\see GRID_CELL_SEEN}, {\see GRID_CELL_SEEN_HIT} oder 0)
+* \return Nicht-null, wenn sich das Wand-Bit geändert hat
+*/
+static inline int beobachte_zelle(const int x, const int y, const int delta, const uint8_t seen)
+{
+	grid_tile_t *tile = grid_tile(&mapgrid, x, y);
+	if (tile == (grid_tile_t*)0)
+		return 0;
+
+	const uint8_t *cell = &tile->cells[grid_tile_index(x, y)];
+	int8_t *odds = &tile->odds[grid_tile_index(x, y)];
+	*odds = grid_odds_add(*odds, delta);
+	tile->dirty |= GRID_DIRTY_PUBLISH;
+
+	/* Wand-Bit mit Hysterese aus den Log-Odds ableiten */
+	uint8_t state = *cell | seen;
+	if (*odds >= GRID_ODDS_OCCUPIED)
+		state |= GRID_CELL_WALL;
+	else if (*odds <= GRID_ODDS_FREE)
+		state &= ~GRID_CELL_WALL;
+
+	const uint8_t old = *cell;
+	if (state == old)
+		return 0;
+	grid_write(&mapgrid, x, y, state);
+
+	/* Frontier nur bei Übergang unkartiert -> kartiert oder bei Wandwechsel neu bewerten */
+	const int wall = ((old ^ state) & GRID_CELL_WALL) != 0;
+	if (!(old & GRID_CELL_CHARTED) || wall)
+		frontier_touch(x, y);
+	return wall;
+}
+
+/**
+* Merkt eine Beobachtung für das spätere Eintragen vor. Jede Zelle wird je
+* Scan höchstens einmal vorgemerkt, so dass eine getroffene Wand nicht im
+* selben Scan von streifenden Strahlen wieder freigegeben wird. Zellen
+* außerhalb des Fensters um den Roboter werden nicht entdoppelt.
+* \param[inout] robot Der Roboter
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \param[in] delta {\see GRID_ODDS_HIT} oder {\see GRID_ODDS_MISS}
+* \param[in] seen Zu setzende Sichtbits
+*/
+static inline void merke_zelle(maprobot_t *robot, const int x, const int y, const int delta, const uint8_t seen)
+{
+	const unsigned wx = (unsigned)(x - robot->windowX);
+	const unsigned wy = (unsigned)(y - robot->windowY);
+	if (wx < MAP_WINDOW_SIZE && wy < MAP_WINDOW_SIZE)
+	{
+		const unsigned bit = wy*MAP_WINDOW_SIZE + wx;
+		uint64_t *word = &robot->window[bit >> 6];
+		const uint64_t mask = (uint64_t)1 << (bit & 63);
+		if (*word & mask)
+			return;
+		*word |= mask;
+	}
+
+	if (robot->updateCount == robot->updateCapacity)
+	{
+		const int capacity = robot->updateCapacity ? 2*robot->updateCapacity : 4096;
+		mapupdate_t *updates = (mapupdate_t*)realloc(robot->updates, capacity*sizeof(mapupdate_t));
+		if (updates == (mapupdate_t*)0)
+			return;
+		robot->updates = updates;
+		robot->updateCapacity = capacity;
+	}
+
+	mapupdate_t *update = &robot->updates[robot->updateCount++];
+	update->x = x;
+	update->y = y;
+	update->delta = (int8_t)delta;
+	update->seen = seen;
+	update->wall = 0;
+
+	if (x < robot->minX) robot->minX = x;
+	if (x > robot->maxX) robot->maxX = x;
+	if (y < robot->minY) robot->minY = y;
+	if (y > robot->maxY) robot->maxY = y;
+}
+
+/**
+* Trägt einen Treffer in die Zellen um den gegebenen Punkt {mapx,mapy} ein
+* \param[inout] robot Der Roboter
+* \param[in] mapx Die X-Koordinate in Kartenkoordinaten
+* \param[in] mapy Die Y-Koordinate in Kartenkoordinaten
 */
-void setze_wand_dick(double x, double y)
+static void setze_wand_dick(maprobot_t *robot, const int mapx, const int mapy)
 {
 	const int width = 2;
 	for (int pady = -width/2; pady < width; ++pady) 
 	{
 		for (int padx = -width/2; padx < width; ++padx)
 		{
-			cvSet2D( mapimg,
-			    MAP_OFFS_Y-(int)(MAP_SCALE*y)+pady,
-			    MAP_OFFS_X+(int)(MAP_SCALE*x)+padx,
-			    CV_RGB(MAX_GRAY, MAX_GRAY, MAX_GRAY)
-			  );
+			merke_zelle(robot, mapx+padx, mapy+pady, GRID_ODDS_HIT, 0);
+		}
+	}
+}
+
+/**
+* Trägt einen Durchgang in eine einzelne Zelle ein
+* \param[inout] robot Der Roboter
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \param[in] seen {\see GRID_CELL_SEEN} oder {\see GRID_CELL_SEEN_HIT}
+*/
+static inline void setze_gesehen(maprobot_t *robot, const int x, const int y, const uint8_t seen)
+{
+	merke_zelle(robot, x, y, GRID_ODDS_MISS, seen);
+}
+
+/**
+* Markiert die Sichtlinie von {x0,y0} nach {x1,y1} als gesehen.
+*
+* Das Gitter wird nach Amanatides & Woo ("A Fast Voxel Traversal Algorithm
+* for Ray Tracing", 1987) traversiert, so dass jede vom Strahl geschnittene
+* Zelle genau einmal besucht wird. Die Zielzelle selbst wird nicht markiert,
+* da sie bei einem Treffer die Wand enthält.
+* \param[inout] robot Der Roboter
+* \param[in] x0 Die X-Koordinate des Startpunktes in Weltkoordinaten
+* \param[in] y0 Die Y-Koordinate des Startpunktes in Weltkoordinaten
+* \param[in] x1 Die X-Koordinate des Endpunktes in Weltkoordinaten
+* \param[in] y1 Die Y-Koordinate des Endpunktes in Weltkoordinaten
+* \param[in] is_frontier Nicht-null, wenn der Strahl eine Wand getroffen hat
+*/
+static void setze_sichtlinie(maprobot_t *robot, double x0, double y0, double x1, double y1, int is_frontier)
+{
+	const uint8_t seen = is_frontier ? GRID_CELL_SEEN_HIT : GRID_CELL_SEEN;
+
+	/* Kontinuierliche Kartenkoordinaten */
+	const double fx0 = MAP_OFFS_X + MAP_SCALE*x0;
+	const double fy0 = MAP_OFFS_Y - MAP_SCALE*y0;
+	const double fx1 = MAP_OFFS_X + MAP_SCALE*x1;
+	const double fy1 = MAP_OFFS_Y - MAP_SCALE*y1;
+
+	int cx = (int)floor(fx0);
+	int cy = (int)floor(fy0);
+	const int ex = (int)floor(fx1);
+	const int ey = (int)floor(fy1);
+
+	const double dx = fx1 - fx0;
+	const double dy = fy1 - fy0;
+
+	/* Schrittrichtung, Parameterabstand zwischen Zellgrenzen und nächste Grenze */
+	const int stepX = (dx > 0) ? 1 : -1;
+	const int stepY = (dy > 0) ? 1 : -1;
+	const double tDeltaX = (dx != 0) ? fabs(1.0/dx) : HUGE_VAL;
+	const double tDeltaY = (dy != 0) ? fabs(1.0/dy) : HUGE_VAL;
+	double tMaxX = (dx > 0) ? (cx + 1 - fx0)*tDeltaX : (fx0 - cx)*tDeltaX;
+	double tMaxY = (dy > 0) ? (cy + 1 - fy0)*tDeltaY : (fy0 - cy)*tDeltaY;
+	if (dx == 0) tMaxX = HUGE_VAL;
+	if (dy == 0) tMaxY = HUGE_VAL;
+
+	/* Die Anzahl der Schritte steht vorab fest */
+	const int steps = abs(ex - cx) + abs(ey - cy);
+	for (int i = 0; i < steps; ++i)
+	{
+		setze_gesehen(robot, cx, cy, seen);
+
+		if (tMaxX < tMaxY)
+		{
+			tMaxX += tDeltaX;
+			cx += stepX;
+		}
+		else
+		{
+			tMaxY += tDeltaY;
+			cy += stepY;
+		}
+	}
+}
+
+/**
+* Stellt sicher, dass die Kacheln aller vorgemerkten Zellen und der
+* Roboterzelle angelegt sind. Wird mit gehaltener Lesesperre aufgerufen;
+* nur wenn Kacheln fehlen, wird sie vorübergehend gegen die Schreibsperre
+* getauscht, da das Anlegen das Verzeichnis vergrößern kann.
+* \param[in] robot Der Roboter
+* \param[in] robotx Die X-Koordinate des Roboters in Kartenkoordinaten
+* \param[in] roboty Die Y-Koordinate des Roboters in Kartenkoordinaten
+*/
+static void ensureTiles(const maprobot_t *robot, const int robotx, const int roboty)
+{
+	int missing = grid_tile(&mapgrid, robotx, roboty) == (grid_tile_t*)0;
+	for (int i = 0; !missing && i < robot->updateCount; ++i)
+	{
+		missing = grid_tile(&mapgrid, robot->updates[i].x, robot->updates[i].y) == (grid_tile_t*)0;
+	}
+	if (!missing) return;
+
+	pthread_rwlock_unlock(&directoryLock);
+	pthread_rwlock_wrlock(&directoryLock);
+	grid_cell_alloc(&mapgrid, robotx, roboty);
+	for (int i = 0; i < robot->updateCount; ++i)
+	{
+		grid_cell_alloc(&mapgrid, robot->updates[i].x, robot->updates[i].y);
+	}
+	pthread_rwlock_unlock(&directoryLock);
+	pthread_rwlock_rdlock(&directoryLock);
+}
+
+/**
+* Sperrt oder entsperrt alle Kacheln, die das Eintragen eines Scans berührt.
+*
+* Neben den beobachteten Zellen beschreibt {\see frontier_touch} deren
+* Nachbarn und liest wiederum deren Nachbarn; das Rechteck wird daher um
+* zwei Zellen erweitert. Gesperrt wird zeilenweise und damit in aufsteigender
+* Reihenfolge der Verzeichnisindizes, so dass sich Roboter nicht verklemmen.
+* \param[in] robot Der Roboter
+* \param[in] lock Nicht-null zum Sperren, Null zum Entsperren
+*/
+static void lockTiles(const maprobot_t *robot, const int lock)
+{
+	const int tx0 = (robot->minX-2) >> GRID_TILE_SHIFT;
+	const int ty0 = (robot->minY-2) >> GRID_TILE_SHIFT;
+	const int tx1 = (robot->maxX+2) >> GRID_TILE_SHIFT;
+	const int ty1 = (robot->maxY+2) >> GRID_TILE_SHIFT;
+
+	for (int ty = ty0; ty <= ty1; ++ty)
+	{
+		for (int tx = tx0; tx <= tx1; ++tx)
+		{
+			grid_tile_t *tile = grid_tile(&mapgrid, tx << GRID_TILE_SHIFT, ty << GRID_TILE_SHIFT);
+			if (tile == (grid_tile_t*)0) continue;
+
+			if (lock)
+				grid_tile_lock(tile);
+			else
+				grid_tile_unlock(tile);
 		}
 	}
 }
 
 /**
-* Addiert einen Farbwert {r,g,b} auf den gegebenen Pixel {x,y}
-* \param[in] x Die X-Koordinate
-* \param[in] y Die Y-Koordinate
-* \param[in] r Der R-Wert
-* \param[in] g Der G-Wert
-* \param[in] b Der B-Wert
+* Passt ein Anzeigebild an die aktuelle Ausdehnung des Gitters an.
+* \param[inout] img Das Bild; wird bei abweichender Größe oder NULL neu angelegt
 */
-void setze_gesehen_dick(double x, double y, int is_frontier)
+static void fitImageToGrid(IplImage **img)
+{
+	if (*img != (IplImage*)0 && (*img)->width == mapgrid.width && (*img)->height == mapgrid.height) return;
+	if (*img != (IplImage*)0) cvReleaseImage(img);
+	*img = cvCreateImage(cvSize(mapgrid.width,mapgrid.height),8,3);
+	cvZero(*img);
+}
+
+/**
+* Erzeugt das Anzeigebild aus dem Belegungsgitter.
+*
+* Wände werden weiß, gesehene Bereiche grün und der befahrene
+* Pfad rot dargestellt. Der Bildursprung entspricht dem Ursprung
+* des vom Gitter abgedeckten Bereiches.
+* \param[out] img Das Zielbild (8 Bit, 3 Kanäle, BGR)
+*/
+static void map_render(IplImage *img)
 {
 	const int frontier_value = 92;
 	const int seen_value = 64;
 
-	const int width = 2;
-	for (int pady = -width/2; pady < width; ++pady) 
+	for (int ty = 0; ty < mapgrid.tilesY; ++ty)
 	{
-		for (int padx = -width/2; padx < width; ++padx)
+		for (int tx = 0; tx < mapgrid.tilesX; ++tx)
 		{
-			CvScalar s = cvGet2D( mapimg,
-    	        MAP_OFFS_Y-(int)(MAP_SCALE*y)+pady,
-	            MAP_OFFS_X+(int)(MAP_SCALE*x)+padx
-				);
-
-			/* Wenn Wand, ignorieren */
-			if (s.val[1] == MAX_GRAY)
-				continue;
-
-			/* Wenn bereits markiert, ignorieren */
-			int green = s.val[1];
-			if (green > seen_value)
-				continue;
-
-			/* Stärke der Enfärbung */
-			if (is_frontier)
-				green = frontier_value;
-			else
-				green = seen_value;
+			const grid_tile_t *tile = mapgrid.tiles[ty*mapgrid.tilesX + tx];
+			for (int y = 0; y < GRID_TILE_SIZE; ++y)
+			{
+				uint8_t *pixel = (uint8_t*)(img->imageData + (ty*GRID_TILE_SIZE + y)*img->widthStep) + tx*GRID_TILE_SIZE*3;
+
+				/* Nicht angelegte Kacheln sind unbekannt */
+				if (tile == (grid_tile_t*)0)
+				{
+					memset(pixel, 0, GRID_TILE_SIZE*3);
+					continue;
+				}
 
-			cvSet2D( mapimg,
-			    MAP_OFFS_Y-(int)(MAP_SCALE*y)+pady,
-			    MAP_OFFS_X+(int)(MAP_SCALE*x)+padx,
-			    CV_RGB(s.val[2], green, s.val[0])
-			  );
+				const uint8_t *row = &tile->cells[y << GRID_TILE_SHIFT];
+				for (int x = 0; x < GRID_TILE_SIZE; ++x, pixel += 3)
+				{
+					const uint8_t cell = row[x];
+					if (cell & GRID_CELL_WALL)
+					{
+						pixel[0] = pixel[1] = pixel[2] = MAX_GRAY;
+						continue;
+					}
+
+					pixel[0] = 0;
+					pixel[1] = (cell & GRID_CELL_SEEN_HIT) ? frontier_value : ((cell & GRID_CELL_SEEN) ? seen_value : 0);
+					pixel[2] = (cell & GRID_CELL_TRACK) ? MAX_GRAY : 0;
+				}
+			}
 		}
 	}
 }
 
+/**
+* Zeichnet Karte, Markierungen und Frontier-Anzeige in einen Frame.
+* Für jeden Roboter werden Zielvektor und geplanter Pfad eingezeichnet; die
+* Frontier-Anzeige zeigt die Wellenfront des zuletzt geplanten Roboters.
+* Erfordert die Schreibsperre und einen ruhenden Such-Thread.
+* \param[inout] frame Der (hintere) Frame
+*/
+static void map_render_frame(mapframe_t *frame)
+{
+	/* Karte in Anzeigebild übertragen */
+	fitImageToGrid(&frame->map);
+	map_render(frame->map);
+
+	for (int r = 0; r < MAP_MAX_ROBOTS; ++r)
+	{
+		const maprobot_t *robot = &robots[r];
+		if (!__atomic_load_n(&robot->active, __ATOMIC_ACQUIRE)) continue;
+
+		/* Vektor zum gewählten Ziel */
+		explorer_result_t result;
+		if (!explorer_result(r, &result) || !result.frontiers) continue;
+
+		/* Markierungen in Karte setzen */
+		CvScalar color;
+		color.val[0] = 0;
+		color.val[1] = MAX_GRAY;
+		color.val[2] = MAX_GRAY;
+		color.val[3] = 0;
+
+		CvPoint start, end;
+		start.x = MAP_OFFS_X+(int)(MAP_SCALE*robot->px) - mapgrid.originX;
+		start.y = MAP_OFFS_Y-(int)(MAP_SCALE*robot->py) - mapgrid.originY;
+
+		end.x = MAP_OFFS_X+(int)(MAP_SCALE*result.goalX) - mapgrid.originX;
+		end.y = MAP_OFFS_Y-(int)(MAP_SCALE*result.goalY) - mapgrid.originY;
+		cvLine(frame->map, start, end, color, 1, 8, 0);
 
-int map_draw(playerc_ranger_t *ranger, playerc_position2d_t *pos)
+		/* Geplanten Pfad einzeichnen */
+		const planner_point_t *points;
+		planner_select(r);
+		const int count = planner_path(&points);
+		for (int i = 0; i < count; ++i)
+		{
+			const int x = points[i].x - mapgrid.originX;
+			const int y = points[i].y - mapgrid.originY;
+			uint8_t *pixel = (uint8_t*)(frame->map->imageData + y*frame->map->widthStep) + x*3;
+			pixel[0] = MAX_GRAY;
+			pixel[1] = MAX_GRAY;
+			pixel[2] = 0;
+		}
+	}
+
+	fitImageToGrid(&frame->frontier);
+	frontier_render(frame->frontier);
+}
+
+/**
+* Ermittelt, ob der Darstellungs-Thread einen neuen Frame übernehmen kann.
+* \return Null, wenn keine Anzeige erfolgt oder der letzte Frame noch aussteht, ansonsten nicht-null.
+*/
+static int map_frame_wanted()
+{
+#ifndef MAP_HEADLESS
+	if (headless) return 0;
+
+	pthread_mutex_lock(&displayMutex);
+	const int wanted = !frameReady;
+	pthread_mutex_unlock(&displayMutex);
+	return wanted;
+#else
+	return 0;
+#endif
+}
+
+/**
+* Übergibt den fertig gezeichneten hinteren Frame an den Darstellungs-Thread.
+*/
+static void map_publish_frame()
+{
+#ifndef MAP_HEADLESS
+	pthread_mutex_lock(&displayMutex);
+	frameReady = 1;
+	pthread_mutex_unlock(&displayMutex);
+#endif
+}
+
+int map_draw(const int robotIndex, playerc_ranger_t *ranger, playerc_position2d_t *pos)
 {
 	if (!initialized) { if (map_init()) return 1; }
+	if (robotIndex < 0 || robotIndex >= MAP_MAX_ROBOTS) return 1;
+	maprobot_t *robot = &robots[robotIndex];
 
    	// Hier kommt der Code zum Zeichnen der Waende hinein
    	// --------------------------------------------------
 
-	for (uint32_t a=0; a < ranger->ranges_count; ++a)       
+	/* Pose der Odometrie durch Abgleich mit der Karte korrigieren. Nur das
+	 * Bilden der Gitter liest die Karte; gesucht wird ohne Sperre. */
+	playerc_position2d_t corrected;
+	if (scanmatching)
 	{
-		/* Polarkoordinaten beziehen */
-		double angle = a * LASER_ANGULAR_RESOLUTION_RAD + LASER_MIN_ANGLE_RAD;
-		double radius = ranger->ranges[a];
+		const uint64_t started = metrics_now();
+		pthread_rwlock_rdlock(&directoryLock);
+		scanmatch_prepare(&robot->matcher, &mapgrid, pos);
+		pthread_rwlock_unlock(&directoryLock);
+		scanmatch_search(&robot->matcher, ranger, pos, &corrected);
+		metrics_since(METRICS_MATCHING, started);
 
-		/* Lasermessung transformieren */
-		double x, y;
-		int is_frontier = transformLaserToMap(angle, radius, pos, &x, &y);
+		pthread_mutex_lock(&correctionLock);
+		robot->correction = robot->matcher.correction;
+		pthread_mutex_unlock(&correctionLock);
+		pos = &corrected;
+	}
 
+	/* Gesamten Scan transformieren */
+	laserscan_t *scan = &robot->scan;
+	transformScanToMap(ranger, pos, scan);
+
+	/* Beobachtungen ohne Sperre vormerken; das Fenster um den Roboter
+	 * sorgt dafür, dass jede Zelle je Scan nur einmal aktualisiert wird */
+	const int robotx = MAP_OFFS_X+(int)(MAP_SCALE*pos->px);
+	const int roboty = MAP_OFFS_Y-(int)(MAP_SCALE*pos->py);
+	memset(robot->window, 0, sizeof(robot->window));
+	robot->windowX = robotx - MAP_WINDOW_SIZE/2;
+	robot->windowY = roboty - MAP_WINDOW_SIZE/2;
+	robot->updateCount = 0;
+	robot->minX = robot->maxX = robotx;
+	robot->minY = robot->maxY = roboty;
+
+	/* Treffer zuerst eintragen, damit sie Vorrang vor Durchgängen haben */
+	for (uint32_t a=0; a < scan->count; ++a)       
+	{
 		/* Wand zeichnen, wenn Wert innerhalb Sensorradius */
-		if (is_frontier)
+		if (scan->hit[a])
 		{
-			setze_wand_dick(x, y);
+			setze_wand_dick(robot, scan->cellx[a], scan->celly[a]);
 		}
+	}
 
+	for (uint32_t a=0; a < scan->count; ++a)       
+	{
 		/* Sichtlinie als gesehen markieren */
-		double r = 0;
-		const double deltaRadius = 0.1;
-		x = y = -1;
-		do 
-		{
-			/* TODO: OpenCV line verwenden */
-			double newX, newY;
-			transformLaserToMap(angle, r, pos, &newX, &newY);
-			if (newX == x && newY == y)
-				continue;
-			x = newX;
-			y = newY;
-			setze_gesehen_dick(x, y, is_frontier);
-			r += deltaRadius;
-		} while (r < radius - deltaRadius);
+		setze_sichtlinie(robot, pos->px, pos->py, scan->x[a], scan->y[a], scan->hit[a]);
 	}
 
+	/* Eintragen unter den Sperren der berührten Kacheln */
+	pthread_rwlock_rdlock(&directoryLock);
+	ensureTiles(robot, robotx, roboty);
+	lockTiles(robot, 1);
 
-	/* Unbekannte Grenzen erkennen */
-	double nearestX, nearestY;
-	int foundUncharted = checkForOpenSpaces(pos->px, pos->py, &nearestX, &nearestY);
+	int wallChanges = 0;
+	for (int i = 0; i < robot->updateCount; ++i)
+	{
+		mapupdate_t *update = &robot->updates[i];
+		update->wall = (uint8_t)beobachte_zelle(update->x, update->y, update->delta, update->seen);
+		wallChanges += update->wall;
+	}
 
 	/* Aktuelle Position als Track zeichnen */
-	cvSet2D( mapimg,
-		    MAP_OFFS_Y-(int)(MAP_SCALE*pos->py),
-		    MAP_OFFS_X+(int)(MAP_SCALE*pos->px),
-		    CV_RGB(MAX_GRAY,0,0)
-		  );
-
-	/* Vektor zum nähesten unkartierten Punkt */
-	if (foundUncharted)
+	const uint8_t *track = grid_cell(&mapgrid, robotx, roboty);
+	int trackWall = 0;
+	if (track != (uint8_t*)0)
 	{
-		printf("%d unkartierte. Nähester: x=%7.5f, y=%7.5f\n", 
-			foundUncharted, nearestX, nearestY);
+		/* Befahrene Zellen sind sicher frei */
+		grid_tile(&mapgrid, robotx, roboty)->odds[grid_tile_index(robotx, roboty)] = GRID_ODDS_MIN;
 
-		/* Karte sichern */
-		cvCopy(mapimg, mapimga);
+		trackWall = (*track & GRID_CELL_WALL) != 0;
+		const int changed = trackWall || !(*track & GRID_CELL_CHARTED);
+		grid_write(&mapgrid, robotx, roboty, (*track & ~GRID_CELL_WALL) | GRID_CELL_TRACK);
+		if (changed)
+			frontier_touch(robotx, roboty);
+	}
 
-		/* Markierungen in Karte setzen */
-		CvScalar color;
-		color.val[0] = 0;
-		color.val[1] = MAX_GRAY;
-		color.val[2] = MAX_GRAY;
-		color.val[3] = 0;
+	/* Wandwechsel noch unter den Kachelsperren an das Distanzfeld melden */
+	if (wallChanges || trackWall)
+	{
+		pthread_mutex_lock(&esdfLock);
+		for (int i = 0; i < robot->updateCount; ++i)
+		{
+			const mapupdate_t *update = &robot->updates[i];
+			if (update->wall)
+				esdf_set_wall(&esdf, update->x, update->y, isWall(update->x, update->y));
+		}
+		if (trackWall)
+			esdf_set_wall(&esdf, robotx, roboty, 0);
+		pthread_mutex_unlock(&esdfLock);
+	}
 
-		CvPoint start, end;
-		start.x = MAP_OFFS_X+(int)(MAP_SCALE*pos->px);
-		start.y = MAP_OFFS_Y-(int)(MAP_SCALE*pos->py);
+	lockTiles(robot, 0);
+
+	/* Anzeige und Ablage lesen die Pose unter der Schreibsperre, die
+	 * Regelung über {\see map_pose} unter poseLock */
+	pthread_mutex_lock(&poseLock);
+	robot->px = pos->px;
+	robot->py = pos->py;
+	robot->pa = pos->pa;
+	robot->posed = 1;
+	pthread_mutex_unlock(&poseLock);
+	pthread_rwlock_unlock(&directoryLock);
 
-		end.x = MAP_OFFS_X+(int)(MAP_SCALE*nearestX);
-		end.y = MAP_OFFS_Y-(int)(MAP_SCALE*nearestY);
-		cvLine(mapimga, start, end, color, 1, 8, 0);
+	/* Nur den Bereich um die gemeldeten Wandwechsel nachführen; meldet ein
+	 * anderer Roboter inzwischen weitere, werden sie gleich mit bearbeitet */
+	if (wallChanges || trackWall)
+	{
+		const uint64_t started = metrics_now();
+		pthread_mutex_lock(&esdfLock);
+		esdf_update(&esdf);
+		pthread_mutex_unlock(&esdfLock);
+		metrics_since(METRICS_CLEARANCE, started);
 	}
-	else
+
+	if (!robot->active)
 	{
+		__atomic_store_n(&robot->active, 1, __ATOMIC_RELEASE);
+		__atomic_add_fetch(&activeRobots, 1, __ATOMIC_RELAXED);
+	}
+
+	/* Zielwahl und Pfadplanung laufen im Such-Thread für alle Roboter
+	 * gemeinsam; jeder Roboter meldet lediglich seinen Standort. */
+	explorer_locate(robotIndex, pos->px, pos->py);
+
+	explorer_result_t result;
+	memset(&result, 0, sizeof(result));
+	const int haveResult = explorer_result(robotIndex, &result);
+	const int foundUncharted = haveResult ? result.frontiers : 0;
+
+	if (haveResult && result.sequence != robot->reportedSearch)
+	{
+		robot->reportedSearch = result.sequence;
+
+		/* Bei mehreren Robotern wird jede Zeile dem Roboter zugeordnet */
+		char prefix[16] = "";
+		if (__atomic_load_n(&activeRobots, __ATOMIC_RELAXED) > 1)
+			snprintf(prefix, sizeof(prefix), "[%d] ", robotIndex);
+
+		if (quiet)
+		{
+			/* Keine Ausgabe */
+		}
+		else if (foundUncharted)
+		{
+			printf("%s%d unkartierte in %d Clustern. Ziel: x=%7.5f, y=%7.5f (Weg: %5.2fm)\n", 
+				prefix, foundUncharted, result.clusters, result.goalX, result.goalY, result.distance);
+		}
+		else
+		{
 #if 0
-		printf("Keine unkartierten Punkte gefunden.\n");
+			printf("%sKeine unkartierten Punkte gefunden.\n", prefix);
 #endif
+		}
+	}
+
+	/* Ruht der Such-Thread, gehören Distanzfeld und Pfade bis zur nächsten
+	 * Anfrage der Kartierung. Zeichnen und Nachführen des Schnappschusses
+	 * erfordern die Schreibsperre; da ein anderer Roboter die Suche
+	 * inzwischen gestartet haben kann, wird unter der Sperre erneut geprüft. */
+	if (explorer_idle())
+	{
+		pthread_rwlock_wrlock(&directoryLock);
+		if (explorer_idle())
+		{
+			/* Neuen Frame nur erzeugen, wenn der vorige bereits übernommen wurde;
+			 * so wird höchstens im Takt der Anzeige gezeichnet. */
+			if (map_frame_wanted())
+			{
+				map_render_frame(&frames[1-front]);
+				map_publish_frame();
+			}
+
+			/* Veränderte Kacheln für andere Prozesse veröffentlichen */
+			if (publisher.header != (mapshm_header_t*)0)
+			{
+				mapshm_pose_t poses[MAP_MAX_ROBOTS];
+				for (int i = 0; i < MAP_MAX_ROBOTS; ++i)
+				{
+					poses[i].px = robots[i].px;
+					poses[i].py = robots[i].py;
+					poses[i].pa = robots[i].pa;
+					poses[i].valid = robots[i].posed;
+					poses[i].reserved = 0;
+				}
+				mapshm_publish(&publisher, &mapgrid, poses, MAP_MAX_ROBOTS);
+			}
+
+			/* Neue Suche auf dem aktuellen Kartenstand starten. Läuft noch eine
+			 * Suche, wird nicht gewartet; die Kartierung nutzt das letzte Ergebnis. */
+			explorer_request();
+		}
+		pthread_rwlock_unlock(&directoryLock);
+	}
+
+	/* Vollständig erst, wenn eine Suche keine erreichbare Grenze mehr fand */
+	return haveResult && foundUncharted == 0;
+}
+
+/**
+* Liefert den anzufahrenden Wegpunkt auf dem geplanten Pfad eines Roboters.
+* \param[in] robot Der Index des Roboters
+* \param[out] x Die X-Koordinate in Weltkoordinaten
+* \param[out] y Die Y-Koordinate in Weltkoordinaten
+* \return Null, wenn kein Pfad existiert, ansonsten nicht-null.
+*/
+int map_waypoint(const int robot, double *x, double *y)
+{
+	explorer_result_t result;
+	if (!explorer_result(robot, &result) || !result.hasWaypoint) return 0;
+
+	*x = result.waypointX;
+	*y = result.waypointY;
+	return 1;
+}
+
+/**
+* Korrigiert eine Pose der Odometrie mit dem letzten Abgleich eines Roboters.
+* \param[in] robot Der Index des Roboters
+* \param[inout] pos Die Pose laut Odometrie; wird durch die korrigierte Pose ersetzt
+*/
+void map_correct(const int robot, playerc_position2d_t *pos)
+{
+	if (!scanmatching || robot < 0 || robot >= MAP_MAX_ROBOTS) return;
+
+	pthread_mutex_lock(&correctionLock);
+	const scanmatch_correction_t correction = robots[robot].correction;
+	pthread_mutex_unlock(&correctionLock);
+	scanmatch_apply(&correction, pos, pos);
+}
+
+/**
+* Liefert den Abstand eines Punktes zur nächsten Wand aus dem Distanzfeld.
+* \param[in] x Die X-Koordinate in Weltkoordinaten
+* \param[in] y Die Y-Koordinate in Weltkoordinaten
+* \return Der Abstand in Metern, höchstens {\see ESDF_MAX_DISTANCE}/{\see MAP_SCALE}
+*/
+double map_clearance(const double x, const double y)
+{
+	if (!initialized) { return ESDF_MAX_DISTANCE/MAP_SCALE; }
+
+	const int cellx = MAP_OFFS_X+(int)(MAP_SCALE*x);
+	const int celly = MAP_OFFS_Y-(int)(MAP_SCALE*y);
+	pthread_mutex_lock(&esdfLock);
+	const double distance = esdf_distance(&esdf, cellx, celly);
+	pthread_mutex_unlock(&esdfLock);
+	return distance/MAP_SCALE;
+}
 
-		/* Karte sichern */
-		cvCopy(mapimg, mapimga);
+/**
+* Schreibt die Karte samt letzter Posen der Roboter in eine Ablage.
+* \param[in] path Der Dateiname
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int map_save(const char *path)
+{
+	if (!initialized) { return 1; }
+
+	/* Die Schreibsperre hält alle Roboter an, so dass Karte und Posen zusammenpassen */
+	mapfile_pose_t poses[MAP_MAX_ROBOTS];
+	memset(poses, 0, sizeof(poses));
+	pthread_rwlock_wrlock(&directoryLock);
+	for (int i = 0; i < MAP_MAX_ROBOTS; ++i)
+	{
+		poses[i].px = robots[i].px;
+		poses[i].py = robots[i].py;
+		poses[i].pa = robots[i].pa;
+		poses[i].valid = robots[i].posed;
 	}
+	const int result = mapfile_save(path, &mapgrid, poses, MAP_MAX_ROBOTS);
+	pthread_rwlock_unlock(&directoryLock);
+	return result;
+}
 
-	/* Karte anzeigen und gut. */
-	map_show();
-	return (foundUncharted == 0);
+/**
+* Ersetzt die Karte durch den Inhalt einer Ablage.
+* \param[in] path Der Dateiname
+* \return 0 wenn erfolgreich, ansonsten nicht-null; die Karte bleibt dann unverändert
+*/
+int map_load(const char *path)
+{
+	if (!initialized) { if (map_init()) return 1; }
+
+	/* Schnappschuss und Suche kennen die Karte erst nach der ersten Messung */
+	if (__atomic_load_n(&activeRobots, __ATOMIC_RELAXED) > 0) return 1;
+
+	grid_t loaded;
+	mapfile_pose_t poses[MAP_MAX_ROBOTS];
+	if (grid_create(&loaded, MAP_SIZE_X, MAP_SIZE_Y)) return 1;
+	if (mapfile_load(path, &loaded, poses, MAP_MAX_ROBOTS))
+	{
+		grid_destroy(&loaded);
+		return 1;
+	}
+
+	pthread_rwlock_wrlock(&directoryLock);
+	grid_destroy(&mapgrid);
+	mapgrid = loaded;
+	frontier_recount();
+	pthread_mutex_lock(&esdfLock);
+	esdf_rebuild(&esdf, &mapgrid);
+	pthread_mutex_unlock(&esdfLock);
+	pthread_mutex_lock(&poseLock);
+	for (int i = 0; i < MAP_MAX_ROBOTS; ++i)
+	{
+		if (!poses[i].valid) continue;
+		robots[i].px = poses[i].px;
+		robots[i].py = poses[i].py;
+		robots[i].pa = poses[i].pa;
+		robots[i].posed = 1;
+	}
+	pthread_mutex_unlock(&poseLock);
+	pthread_rwlock_unlock(&directoryLock);
+	return 0;
 }
 
-int map_show()
+/**
+* Liefert die letzte bekannte Pose eines Roboters.
+* \param[in] robot Der Index des Roboters
+* \param[out] x Die X-Position im global Frame
+* \param[out] y Die Y-Position im global Frame
+* \param[out] a Die Orientierung im global Frame
+* \return Null, wenn die Pose unbekannt ist, ansonsten nicht-null.
+*/
+int map_pose(const int robot, double *x, double *y, double *a)
 {
-   if (!initialized) { return 1; }
-   cvShowImage(mapwin, mapimga);
-   cvShowImage(testwin, maptest);
-   cvWaitKey(20);
-   return 0;
+	if (robot < 0 || robot >= MAP_MAX_ROBOTS) return 0;
+
+	pthread_mutex_lock(&poseLock);
+	const int posed = robots[robot].posed;
+	*x = robots[robot].px;
+	*y = robots[robot].py;
+	*a = robots[robot].pa;
+	pthread_mutex_unlock(&poseLock);
+	return posed;
 }
- 
+
 int map_shutdown()
 {
 	if (!initialized) { return 1; }
-	cvDestroyWindow(mapwin);
-	cvDestroyWindow(testwin);
-	cvReleaseImage(&mapimg);
-	cvReleaseImage(&mapimga);
-	cvReleaseImage(&maptest);
+
+	/* Such-Thread zuerst beenden; er liest Schnappschuss, Frontier und Pfad */
+	explorer_shutdown();
+
+#ifndef MAP_HEADLESS
+	/* Darstellungs-Thread beenden; er schließt die Fenster selbst */
+	if (displayRunning)
+	{
+		pthread_mutex_lock(&displayMutex);
+		displayRunning = 0;
+		pthread_mutex_unlock(&displayMutex);
+		pthread_join(displayThread, (void**)0);
+	}
+#endif
+
+	for (int i = 0; i < 2; ++i)
+	{
+		if (frames[i].map != (IplImage*)0) cvReleaseImage(&frames[i].map);
+		if (frames[i].frontier != (IplImage*)0) cvReleaseImage(&frames[i].frontier);
+	}
+	front = 0;
+	frameReady = 0;
+
+	mapshm_destroy(&publisher);
+	frontier_shutdown();
+	planner_shutdown();
+	esdf_destroy(&esdf);
+	grid_destroy(&searchgrid);
+	grid_destroy(&mapgrid);
+
+	for (int i = 0; i < MAP_MAX_ROBOTS; ++i)
+	{
+		if (scanmatching) scanmatch_free(&robots[i].matcher);
+		free(robots[i].updates);
+		memset(&robots[i], 0, sizeof(maprobot_t));
+	}
+	activeRobots = 0;
 	initialized=0;
 	return 0;
 }
@@ -2,36 +2,197 @@
 #define MAP_H MAP_H
 
 #include <libplayerc/playerc.h>
-#include <opencv/highgui.h>
 
+#include "grid.h"
+
+/**
+* Anfängliche Ausdehnung der Karte in Zellen; die Karte wächst bei Bedarf
+*/
 #define MAP_SIZE_X 500
 #define MAP_SIZE_Y 500
+
+/**
+* Kartenkoordinaten des Weltursprungs
+*/
 #define MAP_OFFS_X 250
 #define MAP_OFFS_Y 250
+
+/**
+* Maximale Anzahl gleichzeitig kartierender Roboter
+*/
+#define MAP_MAX_ROBOTS 4
+
+/**
+* Zellen je Meter
+*/
 #define MAP_SCALE 30.0
 
 #ifndef MAX_GRAY
 #define MAX_GRAY 255
 #endif 
 
-int map_draw(playerc_ranger_t *ranger, playerc_position2d_t *pos);
+/**
+* Belegungsgitter der Karte
+*/
+extern grid_t mapgrid;
+
+/**
+* Schnappschuss des Belegungsgitters für die Hintergrundsuche.
+* Zielwahl, Wellenfront und Pfadplanung lesen ausschließlich dieses Gitter;
+* es wird nur nachgeführt, während keine Suche läuft (\see explorer.h).
+*/
+extern grid_t searchgrid;
+
+/**
+* Legt Karte, Such-Thread und Anzeige an. Wird sonst beim ersten Aufruf von
+* {\see map_draw} nachgeholt; kartieren mehrere Roboter parallel, muss der
+* Aufruf vor dem Start ihrer Threads erfolgen.
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int map_init(void);
+
+/**
+* Trägt einen Scan in die gemeinsame Karte ein und fordert bei ruhendem
+* Such-Thread eine neue Zielwahl für alle Roboter an.
+*
+* Darf für verschiedene Roboter parallel aufgerufen werden, für denselben
+* Roboter jedoch nur aus einem Thread. Die Beobachtungen eines Scans werden
+* ohne Sperre berechnet und anschließend unter den Sperren der berührten
+* Kacheln eingetragen; Roboter in verschiedenen Bereichen behindern sich
+* somit nicht.
+* \param[in] robot Der Index des Roboters, 0..{\see MAP_MAX_ROBOTS}-1
+* \param[in] ranger Der Laser-Ranger des Roboters
+* \param[in] pos Die Pose des Roboters
+* \return Nicht-null, wenn die Karte vollständig ist
+*/
+int map_draw(const int robot, playerc_ranger_t *ranger, playerc_position2d_t *pos);
 int map_shutdown(void);
 
+/**
+* Legt fest, ob die Karte ohne Anzeige (und damit ohne X11) betrieben wird.
+*
+* Ohne diesen Aufruf werden die Kartenfenster von einem eigenen Thread in
+* festem Takt aus einem Doppelpuffer angezeigt, so dass {\see map_draw} nicht
+* auf die GUI wartet. Wird mit -DMAP_HEADLESS übersetzt, ist die Anzeige
+* grundsätzlich abgeschaltet.
+* Muss vor dem ersten Aufruf von {\see map_draw} erfolgen.
+* \param[in] enable Nicht-null, um die Anzeige abzuschalten
+*/
+void map_set_headless(const int enable);
+
+/**
+* Unterdrückt die Ausgabe der Suchergebnisse auf stdout, z.B. für
+* Leistungsmessungen mit maschinenlesbarer Ausgabe.
+* \param[in] enable Nicht-null, um die Ausgabe abzuschalten
+*/
+void map_set_quiet(const int enable);
+
+/**
+* Veröffentlicht die Karte samt Posen der Roboter in einem Segment im
+* gemeinsamen Speicher (\see mapshm.h), aus dem andere Prozesse sie ohne
+* eigene Kopie lesen. Veröffentlicht wird zusammen mit dem Nachführen des
+* Schnappschusses, kopiert werden nur veränderte Kacheln. Muss vor dem
+* ersten Aufruf von {\see map_draw} erfolgen.
+* \param[in] name Der Name des Segmentes, z.B. {\see MAPSHM_DEFAULT_NAME}, oder NULL
+*/
+void map_set_publish(const char *name);
+
+/**
+* Gleicht jeden Scan vor dem Eintragen mit der Karte ab und korrigiert so
+* die Drift der Odometrie (\see scanmatch.h). Die Karte, die Posen aus
+* {\see map_pose} und die Wegpunkte beziehen sich dann auf die korrigierten
+* Posen; die Regelung muss ihre Pose mit {\see map_correct} umrechnen.
+* Muss vor dem ersten Aufruf von {\see map_draw} erfolgen.
+* \param[in] enable Nicht-null, um den Abgleich einzuschalten
+*/
+void map_set_scanmatch(const int enable);
+
+/**
+* Liefert den anzufahrenden Wegpunkt auf dem Pfad zur gewählten Grenze.
+* \param[in] robot Der Index des Roboters
+* \param[out] x Die X-Koordinate in Weltkoordinaten
+* \param[out] y Die Y-Koordinate in Weltkoordinaten
+* \return Null, wenn kein Pfad existiert, ansonsten nicht-null.
+*/
+int map_waypoint(const int robot, double *x, double *y);
+
+/**
+* Rechnet eine Pose der Odometrie mit der Korrektur aus dem letzten Abgleich
+* eines Roboters in das Koordinatensystem der Karte um. Ohne Abgleich
+* bleibt die Pose unverändert. Darf parallel zu {\see map_draw} aufgerufen
+* werden.
+* \param[in] robot Der Index des Roboters
+* \param[inout] pos Die Pose laut Odometrie; wird durch die korrigierte Pose ersetzt
+*/
+void map_correct(const int robot, playerc_position2d_t *pos);
+
+/**
+* Liefert den Abstand eines Punktes zur nächsten Wand der Karte. Das
+* Distanzfeld (\see esdf.h) wird nach jedem Scan nur um die veränderten
+* Wände nachgeführt, die Abfrage kostet daher O(1) statt einer Suche oder
+* Strahlverfolgung. Darf parallel zu {\see map_draw} aufgerufen werden.
+* \param[in] x Die X-Koordinate in Weltkoordinaten
+* \param[in] y Die Y-Koordinate in Weltkoordinaten
+* \return Der Abstand in Metern; Abstände über 1 m werden als 1 m geliefert
+*/
+double map_clearance(const double x, const double y);
+
+/**
+* Schreibt die Karte samt der letzten Posen aller Roboter in eine Ablage
+* (\see mapfile.h). Darf während der Kartierung aufgerufen werden; die
+* Roboter warten für die Dauer des Schreibens.
+* \param[in] path Der Dateiname; eine vorhandene Ablage wird erst nach erfolgreichem Schreiben ersetzt
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int map_save(const char *path);
+
+/**
+* Setzt die Erkundung aus einer Ablage fort: Karte, befahrener Pfad und
+* Frontier-Menge werden übernommen, die Posen der Roboter über
+* {\see map_pose} bereitgestellt. Muss vor dem ersten Aufruf von
+* {\see map_draw} erfolgen.
+* \param[in] path Der Dateiname
+* \return 0 wenn erfolgreich, ansonsten nicht-null; die Karte bleibt dann unverändert
+*/
+int map_load(const char *path);
+
+/**
+* Liefert die letzte bekannte Pose eines Roboters, aus seiner letzten
+* Messung oder aus einer geladenen Ablage.
+* \param[in] robot Der Index des Roboters
+* \param[out] x Die X-Position im global Frame
+* \param[out] y Die Y-Position im global Frame
+* \param[out] a Die Orientierung im global Frame
+* \return Null, wenn die Pose unbekannt ist, ansonsten nicht-null.
+*/
+int map_pose(const int robot, double *x, double *y, double *a);
+
 /**
 * Ermittelt, ob eine Koordinate auf der Karte kartierter Raum ist.
 * \param[in] x Die X-Koordinate in Kartenkoordinaten
 * \param[in] y Die Y-Koordinate in Kartenkoordinaten
 * \return Null, wenn die Koordinate unkartiert ist, ansonsten nicht-null.
 */
-int isCharted(const int x, const int y);
+static inline int isCharted(const int x, const int y)
+{
+	/* Beobachtete (gesehene oder getroffene) und befahrene Zellen gelten als kartiert */
+	return (grid_get(&mapgrid, x, y) & GRID_CELL_CHARTED) != 0;
+}
 
 /**
 * Ermittelt, ob eine Koordinate auf der Karte eine Wand ist.
+*
+* Das Wand-Bit ist die bei jeder Messung nachgeführte Schwellwertabfrage der
+* Log-Odds: gesetzt ab {\see GRID_ODDS_OCCUPIED}, gelöscht erst bei
+* {\see GRID_ODDS_FREE} oder darunter.
 * \param[in] x Die X-Koordinate in Kartenkoordinaten
 * \param[in] y Die Y-Koordinate in Kartenkoordinaten
 * \return Null, wenn die Koordinate keine Wand ist, ansonsten nicht-null.
 */
-int isWall(const int x, const int y);
+static inline int isWall(const int x, const int y)
+{
+	return (grid_get(&mapgrid, x, y) & GRID_CELL_WALL) != 0;
+}
 
 #endif
 
@@ -0,0 +1,291 @@
+/**
+* Ablage der Karte auf der Festplatte.
+*/
+
+#include "mapfile.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+* Maximale Größe eines PackBits-kodierten Zellfeldes: im ungünstigsten Fall
+* ein Kopfbyte je 128 Bytes
+*/
+#define MAPFILE_PACKED_MAX (GRID_TILE_CELLS + GRID_TILE_CELLS/128 + 1)
+
+/**
+* Startwert der FNV-1a-Prüfsumme
+*/
+#define MAPFILE_CHECKSUM_SEED (2166136261u)
+
+/**
+* Rundet eine Größe auf die nächste 8-Byte-Grenze auf.
+* \param[in] size Die Größe in Bytes
+* \return Die aufgerundete Größe
+*/
+static inline size_t alignRecord(const size_t size)
+{
+	return (size + 7) & ~(size_t)7;
+}
+
+/**
+* Führt die FNV-1a-Prüfsumme über einen Speicherbereich fort.
+* \param[in] hash Die bisherige Prüfsumme; zu Beginn {\see MAPFILE_CHECKSUM_SEED}
+* \param[in] data Die Daten
+* \param[in] size Die Größe der Daten in Bytes
+* \return Die fortgeführte Prüfsumme
+*/
+static uint32_t checksum(uint32_t hash, const void *data, const size_t size)
+{
+	const uint8_t *bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
+
+/**
+* Ermittelt, ob ab einer Position mindestens drei gleiche Bytes folgen.
+* \param[in] in Das Zellfeld mit {\see GRID_TILE_CELLS} Bytes
+* \param[in] i Die Position
+* \return Null, wenn keine Wiederholung beginnt, ansonsten nicht-null.
+*/
+static inline int startsRun(const uint8_t *in, const int i)
+{
+	return i + 2 < GRID_TILE_CELLS && in[i] == in[i+1] && in[i] == in[i+2];
+}
+
+/**
+* Kodiert ein Zellfeld nach PackBits. Ein Kopfbyte n im Bereich 0..127
+* leitet n+1 unveränderte Bytes ein, ein Kopfbyte -1..-127 wiederholt das
+* folgende Byte 1-n mal. Wiederholungen werden erst ab drei Bytes kodiert,
+* so dass die Ausgabe höchstens ein Kopfbyte je 128 Bytes größer wird.
+* \param[in] in Das Zellfeld mit {\see GRID_TILE_CELLS} Bytes
+* \param[out] out Der Zielspeicher mit mindestens {\see MAPFILE_PACKED_MAX} Bytes
+* \return Anzahl der geschriebenen Bytes
+*/
+static uint32_t packBits(const uint8_t *in, uint8_t *out)
+{
+	uint32_t size = 0;
+	int i = 0;
+	while (i < GRID_TILE_CELLS)
+	{
+		if (startsRun(in, i))
+		{
+			int run = 3;
+			while (i + run < GRID_TILE_CELLS && run < 128 && in[i + run] == in[i]) ++run;
+
+			out[size++] = (uint8_t)(1 - run);
+			out[size++] = in[i];
+			i += run;
+			continue;
+		}
+
+		/* Unveränderte Bytes bis zur nächsten Wiederholung */
+		int literal = 1;
+		while (i + literal < GRID_TILE_CELLS && literal < 128 && !startsRun(in, i + literal)) ++literal;
+
+		out[size++] = (uint8_t)(literal - 1);
+		memcpy(&out[size], &in[i], literal);
+		size += literal;
+		i += literal;
+	}
+	return size;
+}
+
+/**
+* Dekodiert ein nach PackBits kodiertes Zellfeld.
+* \param[in] in Die kodierten Daten
+* \param[in] size Die Größe der kodierten Daten in Bytes
+* \param[out] out Das Zellfeld mit {\see GRID_TILE_CELLS} Bytes
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+static int unpackBits(const uint8_t *in, const uint32_t size, uint8_t *out)
+{
+	uint32_t offset = 0;
+	int i = 0;
+	while (offset < size)
+	{
+		const int8_t header = (int8_t)in[offset++];
+		if (header >= 0)
+		{
+			const int literal = header + 1;
+			if (i + literal > GRID_TILE_CELLS || offset + literal > size) return 1;
+			memcpy(&out[i], &in[offset], literal);
+			offset += literal;
+			i += literal;
+		}
+		else if (header != -128)
+		{
+			const int run = 1 - header;
+			if (i + run > GRID_TILE_CELLS || offset >= size) return 1;
+			memset(&out[i], in[offset++], run);
+			i += run;
+		}
+	}
+	return i != GRID_TILE_CELLS;
+}
+
+/**
+* Schreibt alle angelegten Kacheln eines Gitters samt Posen in eine Ablage.
+* \param[in] path Der Dateiname
+* \param[in] grid Das Gitter
+* \param[in] poses Die Posen der Roboter
+* \param[in] count Die Anzahl der Posen
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int mapfile_save(const char *path, const grid_t *grid, const mapfile_pose_t *poses, const int count)
+{
+	char temporary[4096];
+	if (snprintf(temporary, sizeof(temporary), "%s.tmp", path) >= (int)sizeof(temporary)) return 1;
+
+	FILE *file = fopen(temporary, "wb");
+	if (file == (FILE*)0) return 1;
+
+	mapfile_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAPFILE_MAGIC, sizeof(header.magic));
+	header.version  = MAPFILE_VERSION;
+	header.tileSize = GRID_TILE_SIZE;
+	header.tiles    = (uint32_t)grid->tileCount;
+	header.robots   = (uint32_t)count;
+
+	/* Der Kopf wird mit der Prüfsumme am Ende erneut geschrieben */
+	int failed = fwrite(&header, sizeof(header), 1, file) != 1
+	          || (count > 0 && fwrite(poses, sizeof(mapfile_pose_t), count, file) != (size_t)count);
+	uint32_t hash = checksum(MAPFILE_CHECKSUM_SEED, &header, sizeof(header));
+	hash = checksum(hash, poses, count*sizeof(mapfile_pose_t));
+
+	/* Zustandsbytes und Log-Odds liegen hintereinander im selben Puffer */
+	uint8_t buffer[2*MAPFILE_PACKED_MAX + 8];
+	for (int i = 0; !failed && i < grid->tilesX*grid->tilesY; ++i)
+	{
+		const grid_tile_t *tile = grid->tiles[i];
+		if (tile == (const grid_tile_t*)0) continue;
+
+		mapfile_tile_t record;
+		record.tileX     = grid->tileOriginX + i % grid->tilesX;
+		record.tileY     = grid->tileOriginY + i / grid->tilesX;
+		record.cellsSize = packBits(tile->cells, buffer);
+		record.oddsSize  = packBits((const uint8_t*)tile->odds, &buffer[record.cellsSize]);
+
+		/* Auf 8-Byte-Grenze auffüllen, damit der nächste Kopf ausgerichtet ist */
+		const size_t size = record.cellsSize + record.oddsSize;
+		const size_t padded = alignRecord(size);
+		memset(&buffer[size], 0, padded - size);
+
+		failed = fwrite(&record, sizeof(record), 1, file) != 1
+		      || fwrite(buffer, padded, 1, file) != 1;
+		hash = checksum(hash, &record, sizeof(record));
+		hash = checksum(hash, buffer, padded);
+	}
+
+	header.checksum = hash;
+	failed = failed || fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1;
+
+	/* Erst vollständig auf dem Datenträger, dann die alte Ablage ersetzen */
+	failed = failed || fflush(file) != 0 || fsync(fileno(file)) != 0;
+	failed |= fclose(file) != 0;
+	if (failed || rename(temporary, path) != 0)
+	{
+		remove(temporary);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+* Lädt eine Ablage in ein leeres Gitter.
+* \param[in] path Der Dateiname
+* \param[inout] grid Das leere Gitter
+* \param[out] poses Die Posen der Roboter
+* \param[in] capacity Die Anzahl der Posen in {\see poses}
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int mapfile_load(const char *path, grid_t *grid, mapfile_pose_t *poses, const int capacity)
+{
+	memset(poses, 0, capacity*sizeof(mapfile_pose_t));
+
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0) return 1;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(mapfile_header_t))
+	{
+		close(fd);
+		return 1;
+	}
+
+	const size_t size = (size_t)info.st_size;
+	void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) return 1;
+
+	/* Die Datei wird einmal von vorne nach hinten gelesen */
+	madvise(mapping, size, MADV_SEQUENTIAL);
+	const uint8_t *data = (const uint8_t*)mapping;
+
+	/* Die Prüfsumme wurde über den Kopf mit genullter Prüfsumme gebildet */
+	const mapfile_header_t *header = (const mapfile_header_t*)data;
+	mapfile_header_t unsigned_header = *header;
+	unsigned_header.checksum = 0;
+	size_t offset = sizeof(mapfile_header_t);
+	const uint32_t hash = checksum(checksum(MAPFILE_CHECKSUM_SEED, &unsigned_header, sizeof(unsigned_header)), &data[offset], size - offset);
+
+	int failed = memcmp(header->magic, MAPFILE_MAGIC, sizeof(header->magic)) != 0
+	          || header->version != MAPFILE_VERSION
+	          || header->tileSize != GRID_TILE_SIZE
+	          || header->checksum != hash
+	          || (size - offset) / sizeof(mapfile_pose_t) < header->robots;
+
+	if (!failed)
+	{
+		const mapfile_pose_t *stored = (const mapfile_pose_t*)&data[offset];
+		const int count = ((int)header->robots < capacity) ? (int)header->robots : capacity;
+		memcpy(poses, stored, count*sizeof(mapfile_pose_t));
+		offset += header->robots*sizeof(mapfile_pose_t);
+	}
+
+	/* Datensätze sind ausgerichtet und werden direkt aus der Einblendung dekodiert */
+	for (uint32_t t = 0; !failed && t < header->tiles; ++t)
+	{
+		if (size - offset < sizeof(mapfile_tile_t))
+		{
+			failed = 1;
+			break;
+		}
+
+		const mapfile_tile_t *record = (const mapfile_tile_t*)&data[offset];
+		offset += sizeof(mapfile_tile_t);
+		const size_t padded = alignRecord((size_t)record->cellsSize + record->oddsSize);
+		if (size - offset < padded)
+		{
+			failed = 1;
+			break;
+		}
+
+		/* Kachel samt Rand im Verzeichnis anlegen */
+		const int x = record->tileX * GRID_TILE_SIZE;
+		const int y = record->tileY * GRID_TILE_SIZE;
+		if (grid_tile(grid, x, y) != (grid_tile_t*)0 || grid_cell_alloc(grid, x, y) == (const uint8_t*)0)
+		{
+			failed = 1;
+			break;
+		}
+
+		grid_tile_t *tile = grid_tile(grid, x, y);
+		failed = unpackBits(&data[offset], record->cellsSize, tile->cells)
+		      || unpackBits(&data[offset + record->cellsSize], record->oddsSize, (uint8_t*)tile->odds);
+		grid_tile_summarize(tile);
+		tile->dirty = GRID_DIRTY_ALL;
+		offset += padded;
+	}
+
+	munmap(mapping, size);
+	return failed;
+}
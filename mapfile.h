@@ -0,0 +1,99 @@
+/**
+* Ablage der Karte auf der Festplatte.
+*
+* Eine Ablage besteht aus einem Dateikopf, den letzten Posen der Roboter und
+* einem Datensatz je angelegter Kachel. Ein Datensatz enthält die
+* Kachelkoordinaten sowie Zustandsbytes und Log-Odds der Zellen, jeweils
+* lauflängenkodiert nach PackBits: Da große Bereiche einer Kachel gleich
+* (unbekannt, frei gesehen, gesättigt frei) sind, belegt eine Kachel meist
+* nur wenige hundert Bytes statt 8 KiB. Der befahrene Pfad ist als
+* {\see GRID_CELL_TRACK} in den Zellen enthalten. Die Zusammenfassungen
+* der Kacheln werden beim Laden aus den Zellen neu berechnet.
+*
+* Eine Prüfsumme über die gesamte Datei weist beschädigte oder
+* unvollständige Ablagen vor dem Dekodieren zurück.
+*
+* Alle Datensätze beginnen an 8-Byte-Grenzen, so dass die Datei zum Laden
+* vollständig in den Speicher eingeblendet und ohne Kopie gelesen werden
+* kann.
+*/
+
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <stdint.h>
+
+#include "grid.h"
+
+/**
+* Kennung am Dateianfang
+*/
+#define MAPFILE_MAGIC "AMSMAP01"
+
+/**
+* Version des Dateiformates
+*/
+#define MAPFILE_VERSION (1)
+
+/**
+* Dateikopf; es folgen {\see robots} Posen und {\see tiles} Kacheln
+*/
+typedef struct {
+	char magic[8];				/*! {\see MAPFILE_MAGIC} */
+	uint32_t version;			/*! {\see MAPFILE_VERSION} */
+	uint32_t tileSize;			/*! Kantenlänge einer Kachel in Zellen ({\see GRID_TILE_SIZE}) */
+	uint32_t tiles;				/*! Anzahl der Kacheln */
+	uint32_t robots;			/*! Anzahl der Posen */
+	uint32_t checksum;			/*! FNV-1a-Prüfsumme der Datei, gebildet mit diesem Feld auf 0 */
+	uint32_t reserved;			/*! Auf 0 gesetzt */
+} mapfile_header_t;
+
+/**
+* Letzte Pose eines Roboters
+*/
+typedef struct {
+	double px;					/*! X-Position im global Frame */
+	double py;					/*! Y-Position im global Frame */
+	double pa;					/*! Orientierung im global Frame */
+	uint32_t valid;				/*! Nicht-null, wenn der Roboter kartiert hat */
+	uint32_t reserved;			/*! Auf 0 gesetzt */
+} mapfile_pose_t;
+
+/**
+* Kopf eines Kacheldatensatzes; es folgen {\see cellsSize} Bytes kodierter
+* Zustandsbytes und {\see oddsSize} Bytes kodierter Log-Odds, aufgefüllt bis
+* zur nächsten 8-Byte-Grenze.
+*/
+typedef struct {
+	int32_t tileX;				/*! X-Kachelkoordinate */
+	int32_t tileY;				/*! Y-Kachelkoordinate */
+	uint32_t cellsSize;			/*! Größe der kodierten Zustandsbytes */
+	uint32_t oddsSize;			/*! Größe der kodierten Log-Odds */
+} mapfile_tile_t;
+
+/**
+* Schreibt alle angelegten Kacheln eines Gitters samt Posen in eine Ablage.
+* Geschrieben wird zunächst in eine temporäre Datei, die anschließend
+* umbenannt wird, so dass eine vorhandene Ablage bei einem Abbruch erhalten
+* bleibt.
+* \param[in] path Der Dateiname
+* \param[in] grid Das Gitter
+* \param[in] poses Die Posen der Roboter
+* \param[in] count Die Anzahl der Posen
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int mapfile_save(const char *path, const grid_t *grid, const mapfile_pose_t *poses, const int count);
+
+/**
+* Lädt eine Ablage in ein leeres Gitter. Die geladenen Kacheln gelten als
+* verändert, so dass ein Schnappschuss sie beim nächsten {\see grid_sync}
+* übernimmt.
+* \param[in] path Der Dateiname
+* \param[inout] grid Das leere Gitter
+* \param[out] poses Die Posen der Roboter; überzählige Posen der Ablage werden verworfen
+* \param[in] capacity Die Anzahl der Posen in {\see poses}
+* \return 0 wenn erfolgreich, ansonsten nicht-null; das Gitter ist dann unvollständig
+*/
+int mapfile_load(const char *path, grid_t *grid, mapfile_pose_t *poses, const int capacity);
+
+#endif
@@ -0,0 +1,293 @@
+/**
+* Veröffentlichung der Karte im gemeinsamen Speicher.
+*/
+
+#include "mapshm.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+* Abstand der Kachelplätze vom Segmentanfang; auf eine Cache-Zeile aufgerundet
+*/
+#define MAPSHM_TILES_OFFSET ((sizeof(mapshm_header_t) + 63) & ~(size_t)63)
+
+/**
+* Größe des Segmentes in Bytes
+*/
+#define MAPSHM_SIZE (MAPSHM_TILES_OFFSET + MAPSHM_TILE_SLOTS*sizeof(mapshm_tile_t))
+
+/**
+* Öffnet ein Seqlock zum Schreiben; die Sequenznummer wird ungerade.
+* \param[inout] sequence Die Sequenznummer
+*/
+static inline void beginWrite(uint32_t *sequence)
+{
+	__atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+* Schließt ein Seqlock nach dem Schreiben; die Sequenznummer wird gerade.
+* \param[inout] sequence Die Sequenznummer
+*/
+static inline void endWrite(uint32_t *sequence)
+{
+	__atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELEASE);
+}
+
+/**
+* Baut das Platzverzeichnis des Schreibers für die aktuelle
+* Verzeichnisausdehnung des Gitters aus den Koordinaten der belegten Plätze
+* neu auf.
+* \param[inout] writer Das Segment
+* \param[in] grid Das Gitter
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+static int rebuildSlots(mapshm_writer_t *writer, const grid_t *grid)
+{
+	int32_t *slots = (int32_t*)malloc((size_t)grid->tilesX*grid->tilesY*sizeof(int32_t));
+	if (slots == (int32_t*)0) return 1;
+	memset(slots, 0xff, (size_t)grid->tilesX*grid->tilesY*sizeof(int32_t));
+
+	for (uint32_t s = 0; s < writer->header->tileCount; ++s)
+	{
+		const unsigned tx = (unsigned)(writer->tiles[s].tileX - grid->tileOriginX);
+		const unsigned ty = (unsigned)(writer->tiles[s].tileY - grid->tileOriginY);
+		if (tx < (unsigned)grid->tilesX && ty < (unsigned)grid->tilesY)
+		{
+			slots[ty*grid->tilesX + tx] = (int32_t)s;
+		}
+	}
+
+	free(writer->slots);
+	writer->slots = slots;
+	writer->tileOriginX = grid->tileOriginX;
+	writer->tileOriginY = grid->tileOriginY;
+	writer->tilesX = grid->tilesX;
+	writer->tilesY = grid->tilesY;
+	return 0;
+}
+
+/**
+* Legt das Segment an.
+* \param[out] writer Das Segment
+* \param[in] name Der Name
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int mapshm_create(mapshm_writer_t *writer, const char *name)
+{
+	memset(writer, 0, sizeof(mapshm_writer_t));
+	if (strlen(name) >= sizeof(writer->name)) return 1;
+
+	/* Ein Segment eines abgebrochenen Laufes wird ersetzt, nicht übernommen */
+	shm_unlink(name);
+	const int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0) return 1;
+
+	if (ftruncate(fd, (off_t)MAPSHM_SIZE) != 0)
+	{
+		close(fd);
+		shm_unlink(name);
+		return 1;
+	}
+
+	void *mapping = mmap((void*)0, MAPSHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		shm_unlink(name);
+		return 1;
+	}
+
+	/* Das Segment ist mit Nullen gefüllt; Kennung zuletzt, damit Leser nur ein fertiges Segment annehmen */
+	writer->header = (mapshm_header_t*)mapping;
+	writer->tiles  = (mapshm_tile_t*)((uint8_t*)mapping + MAPSHM_TILES_OFFSET);
+	writer->size   = MAPSHM_SIZE;
+	strcpy(writer->name, name);
+
+	writer->header->version  = MAPSHM_VERSION;
+	writer->header->tileSize = GRID_TILE_SIZE;
+	writer->header->capacity = MAPSHM_TILE_SLOTS;
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(writer->header->magic, MAPSHM_MAGIC, sizeof(writer->header->magic));
+	return 0;
+}
+
+/**
+* Veröffentlicht alle seit der letzten Veröffentlichung veränderten Kacheln.
+* \param[inout] writer Das Segment
+* \param[inout] grid Das Gitter
+* \param[in] poses Die Posen der Roboter
+* \param[in] count Die Anzahl der Posen
+* \return Anzahl der geschriebenen Kacheln oder -1, wenn kein Speicher verfügbar war
+*/
+int mapshm_publish(mapshm_writer_t *writer, grid_t *grid, const mapshm_pose_t *poses, const int count)
+{
+	if (writer->header == (mapshm_header_t*)0) return -1;
+
+	if (writer->slots == (int32_t*)0
+	 || writer->tileOriginX != grid->tileOriginX || writer->tileOriginY != grid->tileOriginY
+	 || writer->tilesX != grid->tilesX || writer->tilesY != grid->tilesY)
+	{
+		if (rebuildSlots(writer, grid)) return -1;
+	}
+
+	mapshm_header_t *header = writer->header;
+	beginWrite(&header->sequence);
+	const uint64_t publication = header->publication + 1;
+
+	/* Nur veränderte Kacheln werden kopiert; jede unter dem Seqlock ihres Platzes */
+	uint32_t dirtyCount = 0;
+	for (int i = 0; i < grid->tilesX*grid->tilesY; ++i)
+	{
+		grid_tile_t *tile = grid->tiles[i];
+		if (tile == (grid_tile_t*)0) continue;
+
+		int32_t slot = writer->slots[i];
+		if (slot < 0)
+		{
+			if (header->tileCount >= MAPSHM_TILE_SLOTS)
+			{
+				header->overflow = 1;
+				continue;
+			}
+
+			/* Gezählt wird der Platz erst nach dem ersten Kopieren, s.u. */
+			slot = (int32_t)header->tileCount;
+			writer->slots[i] = slot;
+			writer->tiles[slot].tileX = grid->tileOriginX + i % grid->tilesX;
+			writer->tiles[slot].tileY = grid->tileOriginY + i / grid->tilesX;
+		}
+		else if (!(tile->dirty & GRID_DIRTY_PUBLISH))
+		{
+			continue;
+		}
+
+		mapshm_tile_t *target = &writer->tiles[slot];
+		beginWrite(&target->sequence);
+		memcpy(target->cells, tile->cells, sizeof(target->cells));
+		memcpy(target->odds, tile->odds, sizeof(target->odds));
+		target->publication = publication;
+		endWrite(&target->sequence);
+
+		tile->dirty &= ~GRID_DIRTY_PUBLISH;
+		header->dirty[dirtyCount++] = (uint32_t)slot;
+
+		/* Neue Plätze werden erst mit Koordinaten und Inhalt sichtbar ({\see mapshm_find}) */
+		if ((uint32_t)slot == header->tileCount)
+		{
+			__atomic_store_n(&header->tileCount, (uint32_t)slot + 1, __ATOMIC_RELEASE);
+		}
+	}
+
+	header->dirtyCount = dirtyCount;
+	header->originX = grid->originX;
+	header->originY = grid->originY;
+	header->width   = grid->width;
+	header->height  = grid->height;
+	for (int r = 0; r < MAPSHM_MAX_ROBOTS; ++r)
+	{
+		if (r < count) header->poses[r] = poses[r];
+		else memset(&header->poses[r], 0, sizeof(mapshm_pose_t));
+	}
+	header->publication = publication;
+	endWrite(&header->sequence);
+	return (int)dirtyCount;
+}
+
+/**
+* Blendet das Segment aus und entfernt es.
+* \param[inout] writer Das Segment
+*/
+void mapshm_destroy(mapshm_writer_t *writer)
+{
+	if (writer->header != (mapshm_header_t*)0)
+	{
+		munmap(writer->header, writer->size);
+		shm_unlink(writer->name);
+	}
+	free(writer->slots);
+	memset(writer, 0, sizeof(mapshm_writer_t));
+}
+
+/**
+* Blendet ein vorhandenes Segment lesend ein.
+* \param[out] reader Das Segment
+* \param[in] name Der Name
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int mapshm_open(mapshm_reader_t *reader, const char *name)
+{
+	memset(reader, 0, sizeof(mapshm_reader_t));
+
+	const int fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0) return 1;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t)info.st_size < MAPSHM_SIZE)
+	{
+		close(fd);
+		return 1;
+	}
+
+	void *mapping = mmap((void*)0, MAPSHM_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) return 1;
+
+	const mapshm_header_t *header = (const mapshm_header_t*)mapping;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (memcmp(header->magic, MAPSHM_MAGIC, sizeof(header->magic)) != 0
+	 || header->version != MAPSHM_VERSION
+	 || header->tileSize != GRID_TILE_SIZE
+	 || header->capacity != MAPSHM_TILE_SLOTS)
+	{
+		munmap(mapping, MAPSHM_SIZE);
+		return 1;
+	}
+
+	reader->header = header;
+	reader->tiles  = (const mapshm_tile_t*)((const uint8_t*)mapping + MAPSHM_TILES_OFFSET);
+	reader->size   = MAPSHM_SIZE;
+	return 0;
+}
+
+/**
+* Blendet das Segment aus.
+* \param[inout] reader Das Segment
+*/
+void mapshm_close(mapshm_reader_t *reader)
+{
+	if (reader->header != (const mapshm_header_t*)0)
+	{
+		munmap((void*)reader->header, reader->size);
+	}
+	memset(reader, 0, sizeof(mapshm_reader_t));
+}
+
+/**
+* Sucht den Platz der Kachel, die eine Zelle enthält.
+* \param[in] reader Das Segment
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Der Platz oder NULL, wenn die Kachel nicht veröffentlicht ist
+*/
+const mapshm_tile_t* mapshm_find(const mapshm_reader_t *reader, const int x, const int y)
+{
+	/* Abrunden auch für negative Koordinaten */
+	const int tileX = (x >= 0) ? x / GRID_TILE_SIZE : -((-x + GRID_TILE_SIZE-1) / GRID_TILE_SIZE);
+	const int tileY = (y >= 0) ? y / GRID_TILE_SIZE : -((-y + GRID_TILE_SIZE-1) / GRID_TILE_SIZE);
+
+	/* Belegte Plätze werden nie wieder vergeben; ein veralteter Zählerstand übersieht nur neue Kacheln */
+	uint32_t count = __atomic_load_n(&reader->header->tileCount, __ATOMIC_ACQUIRE);
+	if (count > MAPSHM_TILE_SLOTS) count = MAPSHM_TILE_SLOTS;
+	for (uint32_t s = 0; s < count; ++s)
+	{
+		if (reader->tiles[s].tileX == tileX && reader->tiles[s].tileY == tileY) return &reader->tiles[s];
+	}
+	return (const mapshm_tile_t*)0;
+}
@@ -0,0 +1,207 @@
+/**
+* Veröffentlichung der Karte im gemeinsamen Speicher.
+*
+* Die Kartierung legt ein POSIX-Shared-Memory-Segment an, in das sie das
+* Belegungsgitter kachelweise veröffentlicht. Andere Prozesse (Anzeigen,
+* Protokollierung, Planer) blenden das Segment nur lesend ein und lesen die
+* Zellen direkt daraus, ohne eigene Kopie der Karte und ohne die
+* Kartierung je aufzuhalten.
+*
+* Das Segment besteht aus einem Kopf und einer festen Anzahl von
+* Kachelplätzen. Jede Kachel der Karte erhält beim ersten Veröffentlichen
+* einen Platz, den sie behält. Der Kopf enthält Ausdehnung der Karte, die
+* Posen der Roboter und die Liste der Plätze, die sich mit der letzten
+* Veröffentlichung geändert haben; jeder Platz trägt zudem die Nummer der
+* Veröffentlichung, in der er zuletzt geändert wurde. Wer Veröffentlichungen
+* verpasst hat, findet so alle seither geänderten Kacheln.
+*
+* Kopf und Plätze sind jeweils durch ein Seqlock geschützt: Der Schreiber
+* setzt die Sequenznummer vor dem Schreiben auf einen ungeraden und danach
+* auf den nächsten geraden Wert. Leser merken sich die Nummer mit
+* {\see mapshm_read_begin}, lesen an Ort und Stelle und verwerfen das
+* Gelesene, wenn {\see mapshm_read_retry} eine zwischenzeitliche Änderung
+* meldet. Leser schreiben nie in das Segment.
+*/
+
+#ifndef MAPSHM_H
+#define MAPSHM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sched.h>
+
+#include "grid.h"
+
+/**
+* Kennung am Segmentanfang
+*/
+#define MAPSHM_MAGIC "AMSSHM01"
+
+/**
+* Version des Segmentformates
+*/
+#define MAPSHM_VERSION (1)
+
+/**
+* Standardname des Segmentes
+*/
+#define MAPSHM_DEFAULT_NAME "/ams-map"
+
+/**
+* Anzahl der Kachelplätze; 1024 Kacheln decken rund 4600 m² ab
+*/
+#define MAPSHM_TILE_SLOTS (1024)
+
+/**
+* Anzahl der Posen im Kopf
+*/
+#define MAPSHM_MAX_ROBOTS (4)
+
+/**
+* Pose eines Roboters
+*/
+typedef struct {
+	double px;					/*! X-Position im global Frame */
+	double py;					/*! Y-Position im global Frame */
+	double pa;					/*! Orientierung im global Frame */
+	uint32_t valid;				/*! Nicht-null, wenn die Pose bekannt ist */
+	uint32_t reserved;			/*! Auf 0 gesetzt */
+} mapshm_pose_t;
+
+/**
+* Kopf des Segmentes
+*/
+typedef struct {
+	char magic[8];				/*! {\see MAPSHM_MAGIC} */
+	uint32_t version;			/*! {\see MAPSHM_VERSION} */
+	uint32_t tileSize;			/*! Kantenlänge einer Kachel in Zellen ({\see GRID_TILE_SIZE}) */
+	uint32_t capacity;			/*! Anzahl der Kachelplätze */
+	uint32_t sequence;			/*! Seqlock über die folgenden Felder; ungerade während des Schreibens */
+	uint64_t publication;		/*! Nummer der letzten Veröffentlichung, beginnend bei 1 */
+	uint32_t tileCount;			/*! Anzahl der belegten Kachelplätze */
+	uint32_t overflow;			/*! Nicht-null, wenn Kacheln mangels Plätzen fehlen */
+	int32_t originX;			/*! X-Koordinate der ersten abgedeckten Zelle */
+	int32_t originY;			/*! Y-Koordinate der ersten abgedeckten Zelle */
+	int32_t width;				/*! Breite des abgedeckten Bereiches in Zellen */
+	int32_t height;				/*! Höhe des abgedeckten Bereiches in Zellen */
+	mapshm_pose_t poses[MAPSHM_MAX_ROBOTS];	/*! Posen der Roboter */
+	uint32_t dirtyCount;		/*! Anzahl der mit der letzten Veröffentlichung geänderten Plätze */
+	uint32_t dirty[MAPSHM_TILE_SLOTS];		/*! Indizes der geänderten Plätze */
+} mapshm_header_t;
+
+/**
+* Kachelplatz
+*/
+typedef struct {
+	uint32_t sequence;			/*! Seqlock über den Platz; ungerade während des Schreibens */
+	int32_t tileX;				/*! X-Kachelkoordinate */
+	int32_t tileY;				/*! Y-Kachelkoordinate */
+	uint32_t reserved;			/*! Auf 0 gesetzt */
+	uint64_t publication;		/*! Veröffentlichung, in der der Platz zuletzt geändert wurde */
+	uint8_t cells[GRID_TILE_CELLS];	/*! Zeilenweise abgelegte Zellzustände */
+	int8_t odds[GRID_TILE_CELLS];	/*! Log-Odds der Belegung je Zelle, zeilenweise */
+} mapshm_tile_t;
+
+/**
+* Schreibende Seite des Segmentes
+*/
+typedef struct {
+	mapshm_header_t *header;	/*! Eingeblendeter Kopf */
+	mapshm_tile_t *tiles;		/*! Eingeblendete Kachelplätze */
+	size_t size;				/*! Größe des Segmentes in Bytes */
+	char name[64];				/*! Name des Segmentes */
+	int32_t *slots;				/*! Platz je Eintrag des Kachelverzeichnisses oder -1 */
+	int tileOriginX;			/*! Verzeichnisausdehnung, für die {\see slots} gilt */
+	int tileOriginY;
+	int tilesX;
+	int tilesY;
+} mapshm_writer_t;
+
+/**
+* Lesende Seite des Segmentes
+*/
+typedef struct {
+	const mapshm_header_t *header;	/*! Eingeblendeter Kopf */
+	const mapshm_tile_t *tiles;		/*! Eingeblendete Kachelplätze */
+	size_t size;					/*! Größe des Segmentes in Bytes */
+} mapshm_reader_t;
+
+/**
+* Legt das Segment an; ein vorhandenes Segment gleichen Namens wird ersetzt.
+* \param[out] writer Das Segment
+* \param[in] name Der Name, z.B. {\see MAPSHM_DEFAULT_NAME}
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int mapshm_create(mapshm_writer_t *writer, const char *name);
+
+/**
+* Veröffentlicht alle seit der letzten Veröffentlichung veränderten Kacheln
+* ({\see GRID_DIRTY_PUBLISH}) sowie Ausdehnung und Posen. Das Gitter darf
+* währenddessen nicht verändert werden.
+* \param[inout] writer Das Segment
+* \param[inout] grid Das Gitter; die Marke {\see GRID_DIRTY_PUBLISH} wird zurückgesetzt
+* \param[in] poses Die Posen der Roboter
+* \param[in] count Die Anzahl der Posen, höchstens {\see MAPSHM_MAX_ROBOTS}
+* \return Anzahl der geschriebenen Kacheln oder -1, wenn kein Speicher verfügbar war
+*/
+int mapshm_publish(mapshm_writer_t *writer, grid_t *grid, const mapshm_pose_t *poses, const int count);
+
+/**
+* Blendet das Segment aus und entfernt es.
+* \param[inout] writer Das Segment
+*/
+void mapshm_destroy(mapshm_writer_t *writer);
+
+/**
+* Blendet ein vorhandenes Segment lesend ein.
+* \param[out] reader Das Segment
+* \param[in] name Der Name
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int mapshm_open(mapshm_reader_t *reader, const char *name);
+
+/**
+* Blendet das Segment aus.
+* \param[inout] reader Das Segment
+*/
+void mapshm_close(mapshm_reader_t *reader);
+
+/**
+* Sucht den Platz der Kachel, die eine Zelle enthält. Der Platz einer Kachel
+* ändert sich nicht mehr, sobald er vergeben ist.
+* \param[in] reader Das Segment
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Der Platz oder NULL, wenn die Kachel nicht veröffentlicht ist
+*/
+const mapshm_tile_t* mapshm_find(const mapshm_reader_t *reader, const int x, const int y);
+
+/**
+* Beginnt einen Lesevorgang unter einem Seqlock und wartet dazu ein
+* laufendes Schreiben ab.
+* \param[in] sequence Die Sequenznummer des Kopfes oder eines Platzes
+* \return Die zu Beginn gültige Sequenznummer für {\see mapshm_read_retry}
+*/
+static inline uint32_t mapshm_read_begin(const uint32_t *sequence)
+{
+	uint32_t start;
+	while ((start = __atomic_load_n(sequence, __ATOMIC_ACQUIRE)) & 1)
+	{
+		sched_yield();
+	}
+	return start;
+}
+
+/**
+* Beendet einen Lesevorgang unter einem Seqlock.
+* \param[in] sequence Die Sequenznummer des Kopfes oder eines Platzes
+* \param[in] start Der Rückgabewert von {\see mapshm_read_begin}
+* \return Nicht-null, wenn währenddessen geschrieben wurde und das Gelesene zu verwerfen ist
+*/
+static inline int mapshm_read_retry(const uint32_t *sequence, const uint32_t start)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(sequence, __ATOMIC_RELAXED) != start;
+}
+
+#endif
@@ -0,0 +1,139 @@
+/**
+* Beobachtung einer veröffentlichten Karte.
+*
+* Blendet das mit "simple --publish" angelegte Segment ein (\see mapshm.h)
+* und gibt in festen Abständen Stand der Karte und Posen der Roboter aus.
+* Gezählt werden nur Kacheln, die sich seit der vorigen Ausgabe geändert
+* haben; alle übrigen Zählerstände werden übernommen. Dient zugleich als
+* Beispiel für einen Leser des Segmentes.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <libgen.h>
+#include <unistd.h>
+
+#include "grid.h"
+#include "mapshm.h"
+
+/**
+* Standardintervall der Ausgabe in Millisekunden
+*/
+#define MAPWATCH_INTERVAL_MS 1000
+
+/**
+* Zählt die kartierten Zellen eines Kachelplatzes unter dessen Seqlock.
+* \param[in] tile Der Kachelplatz
+* \param[out] publication Die Veröffentlichung, zu der der Zählerstand gehört
+* \return Anzahl der kartierten Zellen
+*/
+static int countCharted(const mapshm_tile_t *tile, uint64_t *publication)
+{
+	int charted;
+	uint32_t start;
+	do
+	{
+		start = mapshm_read_begin(&tile->sequence);
+		charted = 0;
+		for (int i = 0; i < GRID_TILE_CELLS; ++i)
+		{
+			charted += (tile->cells[i] & GRID_CELL_CHARTED) != 0;
+		}
+		*publication = tile->publication;
+	} while (mapshm_read_retry(&tile->sequence, start));
+	return charted;
+}
+
+int main(int argc, char *argv[])
+{
+	int interval = MAPWATCH_INTERVAL_MS;
+	int count = 0;
+	const char *program = basename(argv[0]);
+
+	/* Optionen */
+	while (argc > 1 && strncmp(argv[1], "--", 2) == 0)
+	{
+		if (strcmp(argv[1], "--interval") == 0 && argc > 2)
+		{
+			interval = atoi(argv[2]);
+			--argc;
+			++argv;
+		}
+		else if (strcmp(argv[1], "--count") == 0 && argc > 2)
+		{
+			count = atoi(argv[2]);
+			--argc;
+			++argv;
+		}
+		else
+		{
+			break;
+		}
+		--argc;
+		++argv;
+	}
+
+	if (argc > 2 || interval < 1)
+	{
+		printf("Usage: %s [--interval <ms>] [--count <n>] [<shmname>]\n", program);
+		return 1;
+	}
+	const char *name = (argc > 1) ? argv[1] : MAPSHM_DEFAULT_NAME;
+
+	mapshm_reader_t reader;
+	if (mapshm_open(&reader, name))
+	{
+		printf("Segment %s kann nicht geöffnet werden.\n", name);
+		return 1;
+	}
+
+	/* Zählerstand je Platz und die Veröffentlichung, zu der er gehört */
+	static int charted[MAPSHM_TILE_SLOTS];
+	static uint64_t seen[MAPSHM_TILE_SLOTS];
+	int total = 0;
+
+	for (int n = 0; count == 0 || n < count; ++n)
+	{
+		if (n > 0) usleep(interval*1000);
+
+		/* Kopf vollständig übernehmen; dirty[] wird hier nicht benötigt */
+		mapshm_header_t header;
+		const size_t size = offsetof(mapshm_header_t, dirty);
+		uint32_t start;
+		do
+		{
+			start = mapshm_read_begin(&reader.header->sequence);
+			memcpy(&header, reader.header, size);
+		} while (mapshm_read_retry(&reader.header->sequence, start));
+
+		/* Nur Plätze neu zählen, die seit dem letzten Durchlauf geändert wurden */
+		int changed = 0;
+		const uint32_t tiles = (header.tileCount < MAPSHM_TILE_SLOTS) ? header.tileCount : MAPSHM_TILE_SLOTS;
+		for (uint32_t s = 0; s < tiles; ++s)
+		{
+			const mapshm_tile_t *tile = &reader.tiles[s];
+			if (__atomic_load_n(&tile->publication, __ATOMIC_RELAXED) == seen[s]) continue;
+
+			total -= charted[s];
+			charted[s] = countCharted(tile, &seen[s]);
+			total += charted[s];
+			++changed;
+		}
+
+		printf("#%llu: %u Kacheln, %d geändert, %d kartierte Zellen, %dx%d Zellen ab (%d,%d)%s\n",
+			(unsigned long long)header.publication, tiles, changed, total,
+			header.width, header.height, header.originX, header.originY,
+			header.overflow ? ", unvollständig" : "");
+		for (int r = 0; r < MAPSHM_MAX_ROBOTS; ++r)
+		{
+			if (!header.poses[r].valid) continue;
+			printf("  [%d] x=%7.3f, y=%7.3f, a=%6.3f\n", r, header.poses[r].px, header.poses[r].py, header.poses[r].pa);
+		}
+		fflush(stdout);
+	}
+
+	mapshm_close(&reader);
+	return 0;
+}
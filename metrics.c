@@ -0,0 +1,353 @@
+/**
+* Laufzeitmessung der Verarbeitungsstufen.
+*
+* Die Histogramme werden ohne Sperren beschrieben: Zähler, Summe und Klasse
+* werden einzeln atomar erhöht, das Maximum per Compare-and-Swap. Leser
+* sehen daher nicht notwendigerweise einen in sich konsistenten Stand, was
+* für Perzentile ohne Belang ist.
+*/
+
+#include "metrics.h"
+#include "stdio.h"
+#include "string.h"
+#include "stdlib.h"
+#include "pthread.h"
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+* Längste Wartezeit des Metrik-Threads in Millisekunden; bestimmt, wie
+* schnell er auf {\see metrics_stop} reagiert
+*/
+#define METRICS_POLL_MS 200
+
+static const char* stageNames[METRICS_STAGES] = { "read", "mapping", "matching", "clearance", "search", "control", "command", "cycle" };
+static metrics_histogram_t histograms[METRICS_STAGES];
+
+static pthread_t serverThread;
+static int serverRunning = 0;		/* Nicht-null, solange der Metrik-Thread läuft */
+static int serverSocket = -1;
+static int summaryInterval = 0;		/* Ausgabeintervall in Sekunden; 0 = keine Ausgabe */
+static struct sockaddr_un serverAddress;
+
+/**
+* Liefert die monotone Systemzeit.
+* \return Die Zeit in Nanosekunden
+*/
+uint64_t metrics_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+* Bestimmt die Klasse eines Messwertes.
+* \param[in] value Der Messwert
+* \return Der Index der Klasse
+*/
+static inline int bucketIndex(const uint64_t value)
+{
+	if (value < METRICS_SUB_BUCKETS) return (int)value;
+
+	/* Zweierpotenz bestimmt die Klasse, die folgenden Bits die Unterklasse */
+	const int exponent = 63 - __builtin_clzll(value);
+	const int sub = (int)(value >> (exponent - METRICS_SUB_BUCKET_BITS)) & (METRICS_SUB_BUCKETS-1);
+	return (exponent - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS + sub;
+}
+
+/**
+* Bestimmt den repräsentativen Wert (Mitte) einer Klasse.
+* \param[in] index Der Index der Klasse
+* \return Der Wert
+*/
+static inline double bucketValue(const int index)
+{
+	if (index < METRICS_SUB_BUCKETS) return index;
+
+	const int shift = index / METRICS_SUB_BUCKETS - 1;
+	const int sub = index % METRICS_SUB_BUCKETS;
+	const double low = (double)((uint64_t)(METRICS_SUB_BUCKETS + sub) << shift);
+	return low + 0.5*(double)((uint64_t)1 << shift);
+}
+
+/**
+* Erfasst eine Laufzeit.
+* \param[in] stage Die Stufe
+* \param[in] nanoseconds Die Laufzeit in Nanosekunden
+*/
+void metrics_record(const metrics_stage_t stage, const uint64_t nanoseconds)
+{
+	metrics_histogram_t *histogram = &histograms[stage];
+	__atomic_fetch_add(&histogram->buckets[bucketIndex(nanoseconds)], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&histogram->total, nanoseconds, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+
+	uint64_t max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+	while (nanoseconds > max
+		&& !__atomic_compare_exchange_n(&histogram->max, &max, nanoseconds, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	{
+	}
+}
+
+/**
+* Kopiert das Histogramm einer Stufe.
+* \param[in] stage Die Stufe
+* \param[out] snapshot Die Kopie
+*/
+void metrics_snapshot(const metrics_stage_t stage, metrics_histogram_t *snapshot)
+{
+	const metrics_histogram_t *histogram = &histograms[stage];
+	snapshot->count = __atomic_load_n(&histogram->count, __ATOMIC_RELAXED);
+	snapshot->total = __atomic_load_n(&histogram->total, __ATOMIC_RELAXED);
+	snapshot->max   = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+	for (int i = 0; i < METRICS_BUCKETS; ++i)
+	{
+		snapshot->buckets[i] = __atomic_load_n(&histogram->buckets[i], __ATOMIC_RELAXED);
+	}
+}
+
+/**
+* Bestimmt ein Perzentil aus den Klassen eines Histogrammes.
+* \param[in] histogram Das Histogramm
+* \param[in] total Die Summe der Klassenzähler
+* \param[in] fraction Der Anteil, z.B. 0.99
+* \return Der Wert des Perzentils
+*/
+static double percentile(const metrics_histogram_t *histogram, const uint64_t total, const double fraction)
+{
+	uint64_t rank = (uint64_t)(fraction * total + 0.5);
+	if (rank == 0) rank = 1;
+
+	uint64_t seen = 0;
+	for (int i = 0; i < METRICS_BUCKETS; ++i)
+	{
+		seen += histogram->buckets[i];
+		if (seen >= rank) return bucketValue(i);
+	}
+	return 0;
+}
+
+/**
+* Fasst ein Histogramm zusammen.
+* \param[in] histogram Das Histogramm
+* \param[out] summary Die Zusammenfassung
+*/
+void metrics_summarize(const metrics_histogram_t *histogram, metrics_summary_t *summary)
+{
+	memset(summary, 0, sizeof(metrics_summary_t));
+
+	/* Perzentile aus den Klassen; deren Summe kann während des Kopierens vom Zähler abweichen */
+	uint64_t total = 0;
+	for (int i = 0; i < METRICS_BUCKETS; ++i) total += histogram->buckets[i];
+	if (total == 0) return;
+
+	summary->count = histogram->count;
+	summary->mean  = histogram->count ? (double)histogram->total / histogram->count : 0;
+	summary->p50   = percentile(histogram, total, 0.50);
+	summary->p90   = percentile(histogram, total, 0.90);
+	summary->p99   = percentile(histogram, total, 0.99);
+	summary->max   = (double)histogram->max;
+
+	/* Klassenmitten können über dem tatsächlichen Maximum liegen */
+	if (summary->max > 0)
+	{
+		if (summary->p50 > summary->max) summary->p50 = summary->max;
+		if (summary->p90 > summary->max) summary->p90 = summary->max;
+		if (summary->p99 > summary->max) summary->p99 = summary->max;
+	}
+}
+
+/**
+* Schreibt die Zusammenfassung mehrerer Histogramme als Tabelle in Mikrosekunden.
+* \param[out] buffer Der Zielspeicher
+* \param[in] size Die Größe des Zielspeichers in Bytes
+* \param[in] title Die Überschrift
+* \param[in] stages Die Histogramme aller Stufen
+* \return Die Länge des Textes ohne abschließende Null
+*/
+static size_t formatTable(char *buffer, const size_t size, const char *title, const metrics_histogram_t *stages)
+{
+	int written = snprintf(buffer, size, "# %s (us)\n%-8s %10s %10s %10s %10s %10s %10s\n",
+		title, "stage", "count", "mean", "p50", "p90", "p99", "max");
+	size_t length = (written > 0) ? (size_t)written : 0;
+
+	for (int s = 0; s < METRICS_STAGES && length < size; ++s)
+	{
+		metrics_summary_t summary;
+		metrics_summarize(&stages[s], &summary);
+		written = snprintf(buffer + length, size - length, "%-8s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+			stageNames[s], (unsigned long long)summary.count, summary.mean*1e-3,
+			summary.p50*1e-3, summary.p90*1e-3, summary.p99*1e-3, summary.max*1e-3);
+		if (written > 0) length += (size_t)written;
+	}
+
+	/* Bei zu kleinem Zielspeicher ist der Text abgeschnitten */
+	if (length >= size) length = (size > 0) ? size-1 : 0;
+	return length;
+}
+
+/**
+* Schreibt die Zusammenfassung aller Stufen seit Programmstart. Die Kopien
+* der Histogramme liegen auf dem Heap, damit der Metrik-Thread nicht auf
+* einen großen Stack angewiesen ist.
+* \param[out] buffer Der Zielspeicher
+* \param[in] size Die Größe des Zielspeichers in Bytes
+* \return Die Länge des Textes ohne abschließende Null; 0, wenn kein Speicher verfügbar war
+*/
+size_t metrics_format(char *buffer, const size_t size)
+{
+	metrics_histogram_t *current = (metrics_histogram_t*)malloc(METRICS_STAGES*sizeof(metrics_histogram_t));
+	if (current == (metrics_histogram_t*)0)
+	{
+		if (size > 0) buffer[0] = '\0';
+		return 0;
+	}
+
+	for (int s = 0; s < METRICS_STAGES; ++s) metrics_snapshot((metrics_stage_t)s, &current[s]);
+	const size_t length = formatTable(buffer, size, "Latenzen seit Start", current);
+	free(current);
+	return length;
+}
+
+/**
+* Gibt die Latenzen seit der letzten Ausgabe aus. Das Maximum eines
+* Intervalls wird aus der höchsten belegten Klasse bestimmt.
+* \param[inout] previous Die Histogramme der letzten Ausgabe; werden nachgeführt
+*/
+static void printInterval(metrics_histogram_t *previous)
+{
+	static metrics_histogram_t current[METRICS_STAGES];
+	static char text[2048];
+
+	for (int s = 0; s < METRICS_STAGES; ++s)
+	{
+		metrics_snapshot((metrics_stage_t)s, &current[s]);
+
+		/* Differenz bilden; current wird danach zum neuen Vergleichsstand */
+		metrics_histogram_t interval = current[s];
+		interval.count -= previous[s].count;
+		interval.total -= previous[s].total;
+		interval.max = 0;
+		for (int i = 0; i < METRICS_BUCKETS; ++i)
+		{
+			interval.buckets[i] -= previous[s].buckets[i];
+			if (interval.buckets[i]) interval.max = (uint64_t)bucketValue(i);
+		}
+		previous[s] = current[s];
+		current[s] = interval;
+	}
+
+	char title[64];
+	snprintf(title, sizeof(title), "Latenzen der letzten %d s", summaryInterval);
+	formatTable(text, sizeof(text), title, current);
+	fputs(text, stdout);
+	fflush(stdout);
+}
+
+/**
+* Metrik-Thread. Beantwortet Verbindungen am Socket mit der Zusammenfassung
+* seit Programmstart und gibt in festem Takt die Latenzen des vergangenen
+* Intervalls aus.
+*/
+static void* metrics_thread(void *arg)
+{
+	static metrics_histogram_t previous[METRICS_STAGES];
+	static char text[2048];
+	memset(previous, 0, sizeof(previous));
+
+	uint64_t nextSummary = metrics_now() + (uint64_t)summaryInterval*1000000000ull;
+	while (__atomic_load_n(&serverRunning, __ATOMIC_ACQUIRE))
+	{
+		struct pollfd listener;
+		listener.fd = serverSocket;
+		listener.events = POLLIN;
+		listener.revents = 0;
+
+		/* Ohne Socket dient poll lediglich als Wartezeit */
+		const int ready = poll(&listener, (serverSocket >= 0) ? 1 : 0, METRICS_POLL_MS);
+		if (ready > 0 && (listener.revents & POLLIN))
+		{
+			const int client = accept(serverSocket, NULL, NULL);
+			if (client >= 0)
+			{
+				const size_t length = metrics_format(text, sizeof(text));
+				send(client, text, length, MSG_NOSIGNAL);
+				close(client);
+			}
+		}
+
+		if (summaryInterval > 0 && metrics_now() >= nextSummary)
+		{
+			printInterval(previous);
+			nextSummary += (uint64_t)summaryInterval*1000000000ull;
+		}
+	}
+	return NULL;
+}
+
+/**
+* Startet den Metrik-Thread.
+* \param[in] path Der Pfad des Sockets oder NULL, um keinen Socket anzulegen
+* \param[in] interval Das Ausgabeintervall in Sekunden; 0 schaltet die Ausgabe ab
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int metrics_start(const char *path, const int interval)
+{
+	if (serverRunning) return 1;
+
+	summaryInterval = interval;
+	serverSocket = -1;
+	memset(&serverAddress, 0, sizeof(serverAddress));
+
+	if (path != (const char*)0)
+	{
+		if (strlen(path) >= sizeof(serverAddress.sun_path)) return 1;
+		serverAddress.sun_family = AF_UNIX;
+		strcpy(serverAddress.sun_path, path);
+
+		serverSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (serverSocket < 0) return 1;
+
+		/* Verwaisten Socket eines früheren Laufes ersetzen */
+		unlink(path);
+		if (bind(serverSocket, (const struct sockaddr*)&serverAddress, sizeof(serverAddress)) != 0
+		 || listen(serverSocket, 4) != 0)
+		{
+			close(serverSocket);
+			serverSocket = -1;
+			return 1;
+		}
+	}
+
+	serverRunning = 1;
+	if (pthread_create(&serverThread, NULL, metrics_thread, NULL) != 0)
+	{
+		serverRunning = 0;
+		metrics_stop();
+		return 1;
+	}
+	return 0;
+}
+
+/**
+* Beendet den Metrik-Thread und entfernt den Socket.
+*/
+void metrics_stop(void)
+{
+	if (serverRunning)
+	{
+		__atomic_store_n(&serverRunning, 0, __ATOMIC_RELEASE);
+		pthread_join(serverThread, NULL);
+	}
+
+	if (serverSocket >= 0)
+	{
+		close(serverSocket);
+		unlink(serverAddress.sun_path);
+		serverSocket = -1;
+	}
+}
@@ -0,0 +1,137 @@
+/**
+* Laufzeitmessung der Verarbeitungsstufen.
+*
+* Jede Stufe erfasst ihre Laufzeiten in einem Histogramm mit logarithmisch
+* gestuften Klassen, die jeweils in 2^{\see METRICS_SUB_BUCKET_BITS} lineare
+* Unterklassen geteilt sind (wie bei HDR-Histogrammen). Damit ist jede
+* Laufzeit von Nanosekunden bis Sekunden auf etwa 6% genau abgelegt, ohne
+* dass Speicher angefordert oder ein Mutex genommen werden muss; Zähler
+* werden atomar erhöht. Perzentile werden beim Auslesen aus einer Kopie der
+* Zähler bestimmt.
+*
+* Optional stellt ein eigener Thread eine Zusammenfassung über einen lokalen
+* Unix-Socket bereit und gibt in festem Takt die Latenzen des vergangenen
+* Intervalls aus.
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+* Zweierlogarithmus der Anzahl linearer Unterklassen je Zweierpotenz
+*/
+#define METRICS_SUB_BUCKET_BITS (4)
+
+/**
+* Anzahl linearer Unterklassen je Zweierpotenz
+*/
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+
+/**
+* Anzahl der Klassen eines Histogrammes; deckt den gesamten Wertebereich von 64 Bit ab
+*/
+#define METRICS_BUCKETS ((64 - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS)
+
+/**
+* Gemessene Stufen
+*/
+typedef enum {
+	METRICS_READ = 0,		/*! Lesen der Sensordaten (playerc_client_read) */
+	METRICS_MAPPING,		/*! Eintragen einer Messung in die Karte (map_draw) */
+	METRICS_MATCHING,		/*! Abgleich eines Scans mit der Karte, Teil von METRICS_MAPPING */
+	METRICS_CLEARANCE,		/*! Nachführen des Distanzfeldes, Teil von METRICS_MAPPING */
+	METRICS_SEARCH,			/*! Zielwahl und Pfadplanung im Such-Thread */
+	METRICS_CONTROL,		/*! Berechnung des Fahrbefehls */
+	METRICS_COMMAND,		/*! Übermitteln des Fahrbefehls (set_cmd_vel) */
+	METRICS_CYCLE,			/*! Vom Empfang einer Messung bis zum übermittelten Fahrbefehl */
+	METRICS_STAGES			/*! Anzahl der Stufen */
+} metrics_stage_t;
+
+/**
+* Histogramm der Laufzeiten einer Stufe in Nanosekunden
+*/
+typedef struct {
+	uint64_t count;						/*! Anzahl der Messwerte */
+	uint64_t total;						/*! Summe der Messwerte */
+	uint64_t max;						/*! Größter Messwert */
+	uint64_t buckets[METRICS_BUCKETS];	/*! Anzahl der Messwerte je Klasse */
+} metrics_histogram_t;
+
+/**
+* Zusammenfassung eines Histogrammes in Nanosekunden
+*/
+typedef struct {
+	uint64_t count;		/*! Anzahl der Messwerte */
+	double mean;		/*! Mittelwert */
+	double p50;			/*! Median */
+	double p90;			/*! 90. Perzentil */
+	double p99;			/*! 99. Perzentil */
+	double max;			/*! Größter Messwert */
+} metrics_summary_t;
+
+/**
+* Liefert die monotone Systemzeit.
+* \return Die Zeit in Nanosekunden
+*/
+uint64_t metrics_now(void);
+
+/**
+* Erfasst eine Laufzeit. Darf aus beliebigen Threads aufgerufen werden.
+* \param[in] stage Die Stufe
+* \param[in] nanoseconds Die Laufzeit in Nanosekunden
+*/
+void metrics_record(const metrics_stage_t stage, const uint64_t nanoseconds);
+
+/**
+* Erfasst die seit einem Zeitpunkt vergangene Zeit.
+* \param[in] stage Die Stufe
+* \param[in] start Der Zeitpunkt aus {\see metrics_now}
+*/
+static inline void metrics_since(const metrics_stage_t stage, const uint64_t start)
+{
+	metrics_record(stage, metrics_now() - start);
+}
+
+/**
+* Kopiert das Histogramm einer Stufe. Die Kopie ist nicht atomar, laufende
+* Messungen können teilweise enthalten sein.
+* \param[in] stage Die Stufe
+* \param[out] snapshot Die Kopie
+*/
+void metrics_snapshot(const metrics_stage_t stage, metrics_histogram_t *snapshot);
+
+/**
+* Fasst ein Histogramm zusammen.
+* \param[in] histogram Das Histogramm
+* \param[out] summary Die Zusammenfassung
+*/
+void metrics_summarize(const metrics_histogram_t *histogram, metrics_summary_t *summary);
+
+/**
+* Schreibt die Zusammenfassung aller Stufen seit Programmstart als Tabelle
+* in Mikrosekunden.
+* \param[out] buffer Der Zielspeicher
+* \param[in] size Die Größe des Zielspeichers in Bytes
+* \return Die Länge des Textes ohne abschließende Null; 0, wenn kein Speicher verfügbar war
+*/
+size_t metrics_format(char *buffer, const size_t size);
+
+/**
+* Startet den Thread, der die Zusammenfassung über einen Unix-Socket
+* bereitstellt (z.B. "nc -U <path>") und in festem Takt die Latenzen des
+* vergangenen Intervalls ausgibt.
+* \param[in] path Der Pfad des Sockets; eine vorhandene Datei wird ersetzt
+* \param[in] interval Das Ausgabeintervall in Sekunden; 0 schaltet die Ausgabe ab
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int metrics_start(const char *path, const int interval);
+
+/**
+* Beendet den Thread und entfernt den Socket.
+*/
+void metrics_stop(void);
+
+#endif
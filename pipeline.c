@@ -0,0 +1,143 @@
+/**
+* Übergabe von Daten zwischen den Stufen der Verarbeitungskette.
+*
+* Die Warteschlange ist ein Ringpuffer, dessen Lese- und Schreibposition
+* jeweils nur von einer Seite geschrieben werden. Speicherbarrieren stellen
+* sicher, dass ein Eintrag vollständig kopiert ist, bevor die Gegenseite die
+* neue Position sieht.
+*/
+
+#include "pipeline.h"
+#include "stdlib.h"
+#include "string.h"
+
+/**
+* Erzeugt eine leere Warteschlange.
+* \param[out] queue Die Warteschlange
+* \param[in] itemSize Die Größe eines Eintrages in Bytes
+* \param[in] capacity Die Mindestkapazität; wird auf eine Zweierpotenz aufgerundet
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int spsc_create(spscqueue_t *queue, const size_t itemSize, const uint32_t capacity)
+{
+	uint32_t size = 2;
+	while (size < capacity) size *= 2;
+
+	queue->items = (uint8_t*)malloc(size*itemSize);
+	queue->itemSize = itemSize;
+	queue->capacity = size;
+	queue->head = 0;
+	queue->tail = 0;
+	return queue->items == (uint8_t*)0;
+}
+
+/**
+* Gibt den Speicher der Warteschlange frei.
+* \param[inout] queue Die Warteschlange
+*/
+void spsc_destroy(spscqueue_t *queue)
+{
+	free(queue->items);
+	queue->items = (uint8_t*)0;
+	queue->capacity = 0;
+	queue->head = queue->tail = 0;
+}
+
+/**
+* Fügt einen Eintrag ein; darf nur vom Erzeuger aufgerufen werden.
+* \param[inout] queue Die Warteschlange
+* \param[in] item Der zu kopierende Eintrag
+* \return Null, wenn die Warteschlange voll ist, ansonsten nicht-null.
+*/
+int spsc_push(spscqueue_t *queue, const void *item)
+{
+	const uint32_t tail = queue->tail;
+	const uint32_t head = queue->head;
+	if (tail - head == queue->capacity) return 0;
+
+	/* Eintrag erst kopieren, dann veröffentlichen */
+	__sync_synchronize();
+	memcpy(&queue->items[(tail & (queue->capacity-1))*queue->itemSize], item, queue->itemSize);
+	__sync_synchronize();
+	queue->tail = tail + 1;
+	return 1;
+}
+
+/**
+* Entnimmt den ältesten Eintrag; darf nur vom Verbraucher aufgerufen werden.
+* \param[inout] queue Die Warteschlange
+* \param[out] item Der Zielspeicher
+* \return Null, wenn die Warteschlange leer ist, ansonsten nicht-null.
+*/
+int spsc_pop(spscqueue_t *queue, void *item)
+{
+	const uint32_t head = queue->head;
+	const uint32_t tail = queue->tail;
+	if (head == tail) return 0;
+
+	/* Eintrag erst kopieren, dann den Platz freigeben */
+	__sync_synchronize();
+	memcpy(item, &queue->items[(head & (queue->capacity-1))*queue->itemSize], queue->itemSize);
+	__sync_synchronize();
+	queue->head = head + 1;
+	return 1;
+}
+
+/**
+* Entnimmt alle Einträge und liefert den jüngsten; darf nur vom Verbraucher
+* aufgerufen werden.
+* \param[inout] queue Die Warteschlange
+* \param[out] item Der Zielspeicher
+* \return Null, wenn die Warteschlange leer ist, ansonsten nicht-null.
+*/
+int spsc_pop_latest(spscqueue_t *queue, void *item)
+{
+	const uint32_t head = queue->head;
+	const uint32_t tail = queue->tail;
+	if (head == tail) return 0;
+
+	/* Ältere Einträge überspringen */
+	__sync_synchronize();
+	memcpy(item, &queue->items[((tail-1) & (queue->capacity-1))*queue->itemSize], queue->itemSize);
+	__sync_synchronize();
+	queue->head = tail;
+	return 1;
+}
+
+/**
+* Kopiert die aktuelle Messung und Pose in einen Frame.
+* \param[in] ranger Der Laser-Ranger
+* \param[in] pos Die Roboterpose im global Frame
+* \param[in] sequence Die laufende Nummer der Messung
+* \param[out] frame Der Frame
+*/
+void sensorframe_capture(const playerc_ranger_t *ranger, const playerc_position2d_t *pos, const uint32_t sequence, sensorframe_t *frame)
+{
+	frame->sequence = sequence;
+	frame->time = ranger->info.datatime;
+	frame->count = (ranger->ranges_count < LASER_SAMPLES) ? ranger->ranges_count : LASER_SAMPLES;
+	memcpy(frame->ranges, ranger->ranges, frame->count*sizeof(double));
+	frame->px = pos->px;
+	frame->py = pos->py;
+	frame->pa = pos->pa;
+}
+
+/**
+* Stellt einen Frame als Ranger und Pose dar.
+* \param[in] frame Der Frame
+* \param[out] ranger Die Sicht als Ranger
+* \param[out] pos Die Sicht als Pose
+*/
+void sensorframe_view(const sensorframe_t *frame, playerc_ranger_t *ranger, playerc_position2d_t *pos)
+{
+	memset(ranger, 0, sizeof(playerc_ranger_t));
+	ranger->ranges_count = frame->count;
+	ranger->ranges = (double*)frame->ranges;
+	ranger->info.datatime = frame->time;
+
+	memset(pos, 0, sizeof(playerc_position2d_t));
+	pos->px = frame->px;
+	pos->py = frame->py;
+	pos->pa = frame->pa;
+	pos->info.datatime = frame->time;
+}
@@ -0,0 +1,125 @@
+/**
+* Übergabe von Daten zwischen den Stufen der Verarbeitungskette.
+*
+* Erfassung, Kartierung und Regelung laufen in eigenen Threads und sind über
+* sperrfreie Warteschlangen mit genau einem Erzeuger und einem Verbraucher
+* verbunden. Einträge werden als Wert kopiert; weder Einfügen noch Entnehmen
+* blockiert.
+*/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <libplayerc/playerc.h>
+
+#include "laser.h"
+
+/**
+* Ringpuffer mit einem Erzeuger und einem Verbraucher
+*/
+typedef struct {
+	uint8_t *items;				/*! Einträge */
+	size_t itemSize;			/*! Größe eines Eintrages in Bytes */
+	uint32_t capacity;			/*! Kapazität (Zweierpotenz) */
+	volatile uint32_t head;		/*! Leseposition; nur vom Verbraucher geschrieben */
+	volatile uint32_t tail;		/*! Schreibposition; nur vom Erzeuger geschrieben */
+} spscqueue_t;
+
+/**
+* Messung des Lasers samt zugehöriger Pose
+*/
+typedef struct {
+	uint32_t sequence;				/*! Laufende Nummer der Messung */
+	uint32_t count;					/*! Anzahl der gültigen Strahlen */
+	double time;					/*! Zeitstempel der Messung in Sekunden */
+	uint64_t received;				/*! Empfangszeitpunkt in Nanosekunden (\see metrics_now) */
+	double ranges[LASER_SAMPLES];	/*! Gemessene Distanzen in Metern */
+	double px;						/*! X-Position im global Frame */
+	double py;						/*! Y-Position im global Frame */
+	double pa;						/*! Orientierung im global Frame */
+} sensorframe_t;
+
+/**
+* Ergebnis der Kartierung für die Regelung
+*/
+typedef struct {
+	uint32_t sequence;			/*! Nummer der verarbeiteten Messung */
+	int complete;				/*! Nicht-null, wenn die Karte vollständig ist */
+	int hasWaypoint;			/*! Nicht-null, wenn ein Wegpunkt vorliegt */
+	double waypointX;			/*! X-Koordinate des Wegpunktes in Weltkoordinaten */
+	double waypointY;			/*! Y-Koordinate des Wegpunktes in Weltkoordinaten */
+} mapstate_t;
+
+/**
+* Fahrbefehl der Regelung
+*/
+typedef struct {
+	uint32_t sequence;			/*! Nummer der zugrundeliegenden Messung */
+	uint64_t received;			/*! Empfangszeitpunkt der zugrundeliegenden Messung in Nanosekunden */
+	int complete;				/*! Nicht-null, wenn die Karte vollständig ist */
+	double v;					/*! Bahngeschwindigkeit in m/s */
+	double w;					/*! Winkelgeschwindigkeit in rad/s */
+} drivecommand_t;
+
+/**
+* Erzeugt eine leere Warteschlange.
+* \param[out] queue Die Warteschlange
+* \param[in] itemSize Die Größe eines Eintrages in Bytes
+* \param[in] capacity Die Mindestkapazität; wird auf eine Zweierpotenz aufgerundet
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int spsc_create(spscqueue_t *queue, const size_t itemSize, const uint32_t capacity);
+
+/**
+* Gibt den Speicher der Warteschlange frei.
+* \param[inout] queue Die Warteschlange
+*/
+void spsc_destroy(spscqueue_t *queue);
+
+/**
+* Fügt einen Eintrag ein; darf nur vom Erzeuger aufgerufen werden.
+* \param[inout] queue Die Warteschlange
+* \param[in] item Der zu kopierende Eintrag
+* \return Null, wenn die Warteschlange voll ist, ansonsten nicht-null.
+*/
+int spsc_push(spscqueue_t *queue, const void *item);
+
+/**
+* Entnimmt den ältesten Eintrag; darf nur vom Verbraucher aufgerufen werden.
+* \param[inout] queue Die Warteschlange
+* \param[out] item Der Zielspeicher
+* \return Null, wenn die Warteschlange leer ist, ansonsten nicht-null.
+*/
+int spsc_pop(spscqueue_t *queue, void *item);
+
+/**
+* Entnimmt alle Einträge und liefert den jüngsten; darf nur vom Verbraucher
+* aufgerufen werden. Veraltete Einträge werden so übersprungen.
+* \param[inout] queue Die Warteschlange
+* \param[out] item Der Zielspeicher
+* \return Null, wenn die Warteschlange leer ist, ansonsten nicht-null.
+*/
+int spsc_pop_latest(spscqueue_t *queue, void *item);
+
+/**
+* Kopiert die aktuelle Messung und Pose in einen Frame.
+* \param[in] ranger Der Laser-Ranger
+* \param[in] pos Die Roboterpose im global Frame
+* \param[in] sequence Die laufende Nummer der Messung
+* \param[out] frame Der Frame
+*/
+void sensorframe_capture(const playerc_ranger_t *ranger, const playerc_position2d_t *pos, const uint32_t sequence, sensorframe_t *frame);
+
+/**
+* Stellt einen Frame als Ranger und Pose dar, so dass er an Funktionen
+* übergeben werden kann, die Player-Geräte erwarten. Die Sicht verweist auf
+* den Frame und ist nur so lange gültig wie dieser.
+* \param[in] frame Der Frame
+* \param[out] ranger Die Sicht als Ranger
+* \param[out] pos Die Sicht als Pose
+*/
+void sensorframe_view(const sensorframe_t *frame, playerc_ranger_t *ranger, playerc_position2d_t *pos);
+
+#endif
@@ -0,0 +1,586 @@
+/**
+* Pfadplanung auf dem Belegungsgitter.
+*
+* Die Suche arbeitet wie die Wellenfront mit Generationsnummern je Zelle, so
+* dass die Felder zwischen zwei Suchen nicht gelöscht werden müssen. Geplant
+* wird rückwärts vom Ziel zum Roboter: Das Distanzfeld der Wellenfront, die
+* vom Roboter aus zur nähesten Grenze ausgebreitet wurde, ist dann eine exakte
+* Heuristik, so dass A* nahezu nur die Zellen des Pfades selbst expandiert.
+* Jede Suche ist zudem auf eine feste Anzahl von Expansionen begrenzt.
+*/
+
+#include "map.h"
+#include "planner.h"
+#include "wavefront.h"
+#include "stdlib.h"
+#include "string.h"
+
+/**
+* Maximale Anzahl Expansionen einer vollständigen Planung
+*/
+#define PLANNER_MAX_EXPANSIONS (200000)
+
+/**
+* Maximale Anzahl Expansionen einer lokalen Reparatur
+*/
+#define PLANNER_REPAIR_EXPANSIONS (20000)
+
+/**
+* Anzahl der Pfadpunkte, in denen nach der Roboterposition gesucht wird
+*/
+#define PLANNER_TRACK_WINDOW (64)
+
+/**
+* Maximaler Abstand (Manhattan, Zellen) des Roboters zum Pfad
+*/
+#define PLANNER_TRACK_TOLERANCE (3)
+
+/**
+* Eintrag der Prioritätswarteschlange
+*/
+typedef struct {
+	uint64_t key;			/*! f-Wert (obere Hälfte), invertierter g-Wert (untere Hälfte) */
+	int32_t index;			/*! Zellindex */
+} heapnode_t;
+
+/**
+* Suchfelder der A*-Suche
+*/
+typedef struct {
+	uint32_t *cost;			/*! g-Wert je Zelle, zeilenweise */
+	int32_t *parent;		/*! Vorgänger je Zelle */
+	uint16_t *stamps;		/*! Generation, in der die Zelle erreicht wurde */
+	uint16_t *closed;		/*! Generation, in der die Zelle abgeschlossen wurde */
+	heapnode_t *heap;		/*! Binärer Min-Heap */
+	int heapSize;			/*! Anzahl der Einträge im Heap */
+	int heapCapacity;		/*! Kapazität des Heaps */
+	uint16_t epoch;			/*! Aktuelle Generation */
+	int originX;			/*! X-Koordinate der ersten abgedeckten Zelle */
+	int originY;			/*! Y-Koordinate der ersten abgedeckten Zelle */
+	int width;				/*! Breite des abgedeckten Bereiches in Zellen */
+	int height;				/*! Höhe des abgedeckten Bereiches in Zellen */
+} searchfield_t;
+
+/**
+* Pfadpuffer
+*/
+typedef struct {
+	planner_point_t *points;	/*! Pfadpunkte */
+	int length;					/*! Anzahl der Pfadpunkte */
+	int capacity;				/*! Kapazität */
+} pathbuffer_t;
+
+static searchfield_t search = { (uint32_t*)0, (int32_t*)0, (uint16_t*)0, (uint16_t*)0, (heapnode_t*)0, 0, 0, 0, 0, 0, 0, 0 };
+
+/**
+* Pfad eines Roboters samt Ziel
+*/
+typedef struct {
+	pathbuffer_t path;		/*! Aktueller Pfad */
+	int pathStart;			/*! Index des Pfadpunktes am Roboter */
+	int hasGoal;			/*! Nicht-null, wenn ein Ziel gesetzt ist */
+	int goalCellX;			/*! X-Koordinate des Ziels in Kartenkoordinaten */
+	int goalCellY;			/*! Y-Koordinate des Ziels in Kartenkoordinaten */
+} plan_t;
+
+static plan_t plans[MAP_MAX_ROBOTS];
+static plan_t *plan = &plans[0];	/* Pfad des gewählten Roboters */
+
+static pathbuffer_t spliced = { (planner_point_t*)0, 0, 0 };	/* Puffer für Reparaturen */
+static pathbuffer_t segment = { (planner_point_t*)0, 0, 0 };	/* Ergebnis der letzten Suche */
+
+/**
+* Ermittelt, ob eine Zelle befahren werden darf.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Null, wenn die Zelle unkartiert oder eine Wand ist, ansonsten nicht-null.
+*/
+static inline int isPassable(const int x, const int y)
+{
+	const uint8_t cell = grid_get(&searchgrid, x, y);
+	return (cell & GRID_CELL_CHARTED) && !(cell & GRID_CELL_WALL);
+}
+
+/**
+* Stellt die Kapazität eines Pfadpuffers sicher.
+* \param[inout] buffer Der Puffer
+* \param[in] capacity Die benötigte Kapazität
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+static int reservePath(pathbuffer_t *buffer, const int capacity)
+{
+	if (capacity <= buffer->capacity) return 0;
+
+	int newCapacity = buffer->capacity > 0 ? buffer->capacity : 256;
+	while (newCapacity < capacity) newCapacity *= 2;
+
+	planner_point_t *points = (planner_point_t*)realloc(buffer->points, newCapacity*sizeof(planner_point_t));
+	if (points == (planner_point_t*)0) return 1;
+
+	buffer->points = points;
+	buffer->capacity = newCapacity;
+	return 0;
+}
+
+/**
+* Passt die Suchfelder an die aktuelle Ausdehnung des Gitters an.
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+static int fitSearchToGrid()
+{
+	if (search.cost != (uint32_t*)0
+	 && search.originX == searchgrid.originX && search.originY == searchgrid.originY
+	 && search.width == searchgrid.width && search.height == searchgrid.height)
+	{
+		return 0;
+	}
+
+	free(search.cost);
+	free(search.parent);
+	free(search.stamps);
+	free(search.closed);
+
+	const size_t cells = (size_t)searchgrid.width*searchgrid.height;
+	search.cost    = (uint32_t*)malloc(cells*sizeof(uint32_t));
+	search.parent  = (int32_t*)malloc(cells*sizeof(int32_t));
+	search.stamps  = (uint16_t*)calloc(cells, sizeof(uint16_t));
+	search.closed  = (uint16_t*)calloc(cells, sizeof(uint16_t));
+	search.epoch   = 0;
+	search.originX = searchgrid.originX;
+	search.originY = searchgrid.originY;
+	search.width   = searchgrid.width;
+	search.height  = searchgrid.height;
+
+	if (search.cost == (uint32_t*)0 || search.parent == (int32_t*)0
+	 || search.stamps == (uint16_t*)0 || search.closed == (uint16_t*)0)
+	{
+		free(search.cost);
+		free(search.parent);
+		free(search.stamps);
+		free(search.closed);
+		search.cost   = (uint32_t*)0;
+		search.parent = (int32_t*)0;
+		search.stamps = search.closed = (uint16_t*)0;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+* Fügt einen Eintrag in den Heap ein.
+* \param[in] key Der Schlüssel
+* \param[in] index Der Zellindex
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+static int heapPush(const uint64_t key, const int32_t index)
+{
+	if (search.heapSize == search.heapCapacity)
+	{
+		const int capacity = search.heapCapacity > 0 ? search.heapCapacity*2 : 4096;
+		heapnode_t *heap = (heapnode_t*)realloc(search.heap, capacity*sizeof(heapnode_t));
+		if (heap == (heapnode_t*)0) return 1;
+		search.heap = heap;
+		search.heapCapacity = capacity;
+	}
+
+	/* Aufsteigen lassen */
+	int i = search.heapSize++;
+	while (i > 0)
+	{
+		const int parent = (i-1)/2;
+		if (search.heap[parent].key <= key) break;
+		search.heap[i] = search.heap[parent];
+		i = parent;
+	}
+	search.heap[i].key = key;
+	search.heap[i].index = index;
+	return 0;
+}
+
+/**
+* Entnimmt den kleinsten Eintrag aus dem Heap.
+* \return Der Eintrag
+*/
+static heapnode_t heapPop()
+{
+	const heapnode_t top = search.heap[0];
+	const heapnode_t last = search.heap[--search.heapSize];
+
+	/* Absinken lassen */
+	int i = 0;
+	for (;;)
+	{
+		int child = 2*i+1;
+		if (child >= search.heapSize) break;
+		if (child+1 < search.heapSize && search.heap[child+1].key < search.heap[child].key) ++child;
+		if (last.key <= search.heap[child].key) break;
+		search.heap[i] = search.heap[child];
+		i = child;
+	}
+	if (search.heapSize > 0) search.heap[i] = last;
+	return top;
+}
+
+/**
+* Schätzt die Restdistanz einer Zelle zum Suchziel ab.
+*
+* Ist das Suchziel der Startpunkt der letzten Wellenfront-Ausbreitung, sind
+* deren Distanzen exakt; für nicht erreichte Zellen liefert der Radius der
+* Ausbreitung eine untere Schranke. Beide werden mit der Manhattan-Distanz
+* kombiniert, so dass die Schätzung zulässig bleibt.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \param[in] toX Die X-Koordinate des Suchziels in Kartenkoordinaten
+* \param[in] toY Die Y-Koordinate des Suchziels in Kartenkoordinaten
+* \param[in] useWavefront Nicht-null, wenn das Distanzfeld verwendet werden darf
+* \return Die geschätzte Restdistanz oder {\see WAVEFRONT_UNREACHABLE}
+*/
+static inline uint32_t estimate(const int x, const int y, const int toX, const int toY, const int useWavefront)
+{
+	const uint32_t manhattan = abs(toX-x) + abs(toY-y);
+	if (!useWavefront) return manhattan;
+
+	uint32_t distance = wavefront_distance(x, y);
+	if (distance == WAVEFRONT_UNREACHABLE) distance = wavefront_radius();
+	return distance > manhattan ? distance : manhattan;
+}
+
+/**
+* Sucht per A* einen Pfad zwischen zwei Zellen und legt ihn in {\see segment} ab.
+*
+* Start- und Zielzelle gelten unabhängig von ihrem Zustand als befahrbar. Die
+* Suche bricht ab, sobald das Expansionsbudget erschöpft ist.
+* \param[in] fromX Die X-Koordinate des Startpunktes in Kartenkoordinaten
+* \param[in] fromY Die Y-Koordinate des Startpunktes in Kartenkoordinaten
+* \param[in] toX Die X-Koordinate des Zielpunktes in Kartenkoordinaten
+* \param[in] toY Die Y-Koordinate des Zielpunktes in Kartenkoordinaten
+* \param[in] maxExpansions Das Expansionsbudget
+* \param[in] useWavefront Nicht-null, wenn das Ziel der Startpunkt der letzten Wellenfront ist
+* \return Null, wenn kein Pfad gefunden wurde, ansonsten nicht-null.
+*/
+static int findPath(const int fromX, const int fromY, const int toX, const int toY, const int maxExpansions, const int useWavefront)
+{
+	segment.length = 0;
+	if (fitSearchToGrid()) return 0;
+	if (++search.epoch == 0)
+	{
+		const size_t cells = (size_t)search.width*search.height;
+		memset(search.stamps, 0, cells*sizeof(uint16_t));
+		memset(search.closed, 0, cells*sizeof(uint16_t));
+		search.epoch = 1;
+	}
+
+	const int sx = fromX - search.originX;
+	const int sy = fromY - search.originY;
+	const int gx = toX - search.originX;
+	const int gy = toY - search.originY;
+	if ((unsigned)sx >= (unsigned)search.width || (unsigned)sy >= (unsigned)search.height) return 0;
+	if ((unsigned)gx >= (unsigned)search.width || (unsigned)gy >= (unsigned)search.height) return 0;
+
+	const uint32_t h = estimate(fromX, fromY, toX, toY, useWavefront);
+	if (h == WAVEFRONT_UNREACHABLE) return 0;
+
+	static const int dx[4] = { -1, 1, 0, 0 };
+	static const int dy[4] = { 0, 0, -1, 1 };
+
+	/* Startzelle eintragen */
+	search.heapSize = 0;
+	const int32_t start = sy*search.width + sx;
+	const int32_t goal  = gy*search.width + gx;
+	search.stamps[start] = search.epoch;
+	search.cost[start]   = 0;
+	search.parent[start] = -1;
+	if (heapPush((uint64_t)h << 32 | UINT32_MAX, start)) return 0;
+
+	int expansions = 0;
+	int found = 0;
+	while (search.heapSize > 0)
+	{
+		const heapnode_t node = heapPop();
+		const int32_t index = node.index;
+		if (search.closed[index] == search.epoch) continue;
+		search.closed[index] = search.epoch;
+
+		if (index == goal)
+		{
+			found = 1;
+			break;
+		}
+
+		/* Latenz begrenzen */
+		if (++expansions > maxExpansions) break;
+
+		const int x = index % search.width;
+		const int y = index / search.width;
+		const uint32_t cost = search.cost[index] + 1;
+		for (int n = 0; n < 4; ++n)
+		{
+			const int nx = x + dx[n];
+			const int ny = y + dy[n];
+			if ((unsigned)nx >= (unsigned)search.width || (unsigned)ny >= (unsigned)search.height) continue;
+
+			const int32_t neighbor = ny*search.width + nx;
+			if (search.closed[neighbor] == search.epoch) continue;
+			if (search.stamps[neighbor] == search.epoch && search.cost[neighbor] <= cost) continue;
+			if (neighbor != goal && !isPassable(search.originX + nx, search.originY + ny)) continue;
+
+			const uint32_t remaining = estimate(search.originX + nx, search.originY + ny, toX, toY, useWavefront);
+			if (remaining == WAVEFRONT_UNREACHABLE) continue;
+
+			search.stamps[neighbor] = search.epoch;
+			search.cost[neighbor]   = cost;
+			search.parent[neighbor] = index;
+
+			/* Bei gleichem f-Wert tiefere Knoten bevorzugen */
+			const uint64_t f = cost + remaining;
+			if (heapPush(f << 32 | (UINT32_MAX - cost), neighbor)) return 0;
+		}
+	}
+
+	if (!found) return 0;
+
+	/* Pfad rückwärts aus den Vorgängern aufbauen */
+	const int length = (int)search.cost[goal] + 1;
+	if (reservePath(&segment, length)) return 0;
+
+	int32_t index = goal;
+	for (int i = length-1; i >= 0; --i)
+	{
+		segment.points[i].x = search.originX + index % search.width;
+		segment.points[i].y = search.originY + index / search.width;
+		index = search.parent[index];
+	}
+	segment.length = length;
+	return 1;
+}
+
+/**
+* Kehrt die Reihenfolge der Punkte in {\see segment} um.
+*/
+static void reverseSegment()
+{
+	for (int i = 0, j = segment.length-1; i < j; ++i, --j)
+	{
+		const planner_point_t temp = segment.points[i];
+		segment.points[i] = segment.points[j];
+		segment.points[j] = temp;
+	}
+}
+
+/**
+* Übernimmt das Ergebnis der letzten Suche als aktuellen Pfad.
+*/
+static void adoptSegment()
+{
+	pathbuffer_t temp = plan->path;
+	plan->path = segment;
+	segment = temp;
+	plan->pathStart = 0;
+}
+
+/**
+* Führt den Pfadanfang der Roboterposition nach.
+* \param[in] robotX Die X-Koordinate des Roboters in Kartenkoordinaten
+* \param[in] robotY Die Y-Koordinate des Roboters in Kartenkoordinaten
+* \return Null, wenn der Roboter den Pfad verlassen hat, ansonsten nicht-null.
+*/
+static int trackRobot(const int robotX, const int robotY)
+{
+	int bestIndex = -1;
+	int bestDistance = PLANNER_TRACK_TOLERANCE+1;
+
+	int end = plan->pathStart + PLANNER_TRACK_WINDOW;
+	if (end > plan->path.length) end = plan->path.length;
+	for (int i = plan->pathStart; i < end; ++i)
+	{
+		const int distance = abs(plan->path.points[i].x - robotX) + abs(plan->path.points[i].y - robotY);
+		if (distance <= bestDistance)
+		{
+			bestDistance = distance;
+			bestIndex = i;
+		}
+	}
+
+	if (bestIndex < 0) return 0;
+	plan->pathStart = bestIndex;
+	return 1;
+}
+
+/**
+* Ersetzt blockierte Abschnitte des Pfades durch lokal geplante Umwege.
+* \return Null, wenn der Pfad nicht repariert werden konnte, ansonsten nicht-null.
+*/
+static int repairPath()
+{
+	int i = plan->pathStart+1;
+	while (i < plan->path.length)
+	{
+		if (isPassable(plan->path.points[i].x, plan->path.points[i].y))
+		{
+			++i;
+			continue;
+		}
+
+		/* Ende des blockierten Abschnittes suchen; ist das Ziel selbst
+		 * blockiert, hilft nur eine Neuplanung */
+		int j = i+1;
+		while (j < plan->path.length && !isPassable(plan->path.points[j].x, plan->path.points[j].y)) ++j;
+		if (j == plan->path.length) return 0;
+
+		const planner_point_t from = plan->path.points[i-1];
+		const planner_point_t to   = plan->path.points[j];
+		if (!findPath(from.x, from.y, to.x, to.y, PLANNER_REPAIR_EXPANSIONS, 0)) return 0;
+
+		/* Pfad = [pathStart, i-1] + Umweg ohne Endpunkte + [j, Ende]; fallen
+		 * beide Endpunkte zusammen, besteht der Umweg nur aus einem Punkt, und
+		 * Punkt j ist als Punkt i-1 bereits enthalten */
+		const int joined = (segment.length == 1);
+		const int head = i - plan->pathStart;
+		const int detour = (segment.length > 2) ? segment.length - 2 : 0;
+		const int tail = plan->path.length - j - joined;
+		if (reservePath(&spliced, head + detour + tail)) return 0;
+
+		memcpy(spliced.points, &plan->path.points[plan->pathStart], head*sizeof(planner_point_t));
+		memcpy(&spliced.points[head], &segment.points[1], detour*sizeof(planner_point_t));
+		memcpy(&spliced.points[head+detour], &plan->path.points[j+joined], tail*sizeof(planner_point_t));
+		spliced.length = head + detour + tail;
+
+		pathbuffer_t temp = plan->path;
+		plan->path = spliced;
+		spliced = temp;
+		plan->pathStart = 0;
+
+		/* Hinter dem Umweg weiterprüfen; Punkt j ist befahrbar */
+		i = head + detour + !joined;
+	}
+	return 1;
+}
+
+/**
+* Wählt den Roboter, auf dessen Pfad sich die folgenden Aufrufe beziehen.
+* \param[in] robot Der Index des Roboters
+*/
+void planner_select(const int robot)
+{
+	if (robot >= 0 && robot < MAP_MAX_ROBOTS) plan = &plans[robot];
+}
+
+/**
+* Aktualisiert den Pfad vom Roboter zum Ziel.
+* \param[in] robotX Die X-Koordinate des Roboters in Kartenkoordinaten
+* \param[in] robotY Die Y-Koordinate des Roboters in Kartenkoordinaten
+* \param[in] goalX Die X-Koordinate des Ziels in Kartenkoordinaten
+* \param[in] goalY Die Y-Koordinate des Ziels in Kartenkoordinaten
+* \return Null, wenn kein Pfad gefunden wurde, ansonsten nicht-null.
+*/
+int planner_update(const int robotX, const int robotY, const int goalX, const int goalY)
+{
+	/* Bestehenden Pfad weiterverwenden, solange Ziel und Roboter passen */
+	if (plan->hasGoal && plan->path.length > 0 && goalX == plan->goalCellX && goalY == plan->goalCellY
+	 && trackRobot(robotX, robotY) && repairPath())
+	{
+		return 1;
+	}
+
+	/* Neu planen; das Distanzfeld nur verwenden, wenn die Wellenfront vom
+	 * Roboter ausging */
+	plan->hasGoal = 1;
+	plan->goalCellX = goalX;
+	plan->goalCellY = goalY;
+
+	const int useWavefront = (wavefront_distance(robotX, robotY) == 0);
+	if (!findPath(goalX, goalY, robotX, robotY, PLANNER_MAX_EXPANSIONS, useWavefront))
+	{
+		plan->path.length = 0;
+		plan->pathStart = 0;
+		return 0;
+	}
+
+	reverseSegment();
+	adoptSegment();
+	return 1;
+}
+
+/**
+* Verwirft den aktuellen Pfad samt Ziel.
+*/
+void planner_reset(void)
+{
+	plan->hasGoal = 0;
+	plan->path.length = 0;
+	plan->pathStart = 0;
+}
+
+/**
+* Liefert das Ziel des aktuellen Pfades.
+* \param[out] goalX Die X-Koordinate des Ziels in Kartenkoordinaten
+* \param[out] goalY Die Y-Koordinate des Ziels in Kartenkoordinaten
+* \return Null, wenn kein Pfad existiert, ansonsten nicht-null.
+*/
+int planner_goal(int *goalX, int *goalY)
+{
+	if (!plan->hasGoal || plan->path.length == 0) return 0;
+	*goalX = plan->goalCellX;
+	*goalY = plan->goalCellY;
+	return 1;
+}
+
+/**
+* Liefert den verbleibenden Pfad, beginnend an der Position des Roboters.
+* \param[out] points Zeiger auf die Pfadpunkte
+* \return Anzahl der Pfadpunkte
+*/
+int planner_path(const planner_point_t **points)
+{
+	*points = &plan->path.points[plan->pathStart];
+	return plan->path.length > plan->pathStart ? plan->path.length - plan->pathStart : 0;
+}
+
+/**
+* Liefert einen Pfadpunkt in gegebenem Abstand vor dem Roboter.
+* \param[in] lookahead Der Abstand in Pfadpunkten
+* \param[out] x Die X-Koordinate in Kartenkoordinaten
+* \param[out] y Die Y-Koordinate in Kartenkoordinaten
+* \return Null, wenn kein Pfad existiert, ansonsten nicht-null.
+*/
+int planner_waypoint(const int lookahead, int *x, int *y)
+{
+	if (plan->path.length <= plan->pathStart) return 0;
+
+	int index = plan->pathStart + lookahead;
+	if (index >= plan->path.length) index = plan->path.length-1;
+	*x = plan->path.points[index].x;
+	*y = plan->path.points[index].y;
+	return 1;
+}
+
+/**
+* Gibt die Ressourcen der Pfadplanung frei.
+*/
+void planner_shutdown(void)
+{
+	free(search.cost);
+	free(search.parent);
+	free(search.stamps);
+	free(search.closed);
+	free(search.heap);
+	search.cost   = (uint32_t*)0;
+	search.parent = (int32_t*)0;
+	search.stamps = search.closed = (uint16_t*)0;
+	search.heap   = (heapnode_t*)0;
+	search.heapSize = search.heapCapacity = 0;
+	search.width = search.height = 0;
+
+	free(spliced.points);
+	free(segment.points);
+	spliced.points = segment.points = (planner_point_t*)0;
+	spliced.length = segment.length = 0;
+	spliced.capacity = segment.capacity = 0;
+
+	for (int i = 0; i < MAP_MAX_ROBOTS; ++i)
+	{
+		free(plans[i].path.points);
+		memset(&plans[i], 0, sizeof(plan_t));
+	}
+	plan = &plans[0];
+}
@@ -0,0 +1,84 @@
+/**
+* Pfadplanung auf dem Belegungsgitter.
+*
+* Zum gewählten Ziel wird per A* (4er-Nachbarschaft, Manhattan-Heuristik) ein
+* Pfad über kartierte, wandfreie Zellen geplant. Der Pfad bleibt zwischen den
+* Scans erhalten: Fortschritt des Roboters kürzt ihn lediglich, durch neue
+* Wände blockierte Abschnitte werden lokal umplant und eingesetzt. Eine
+* vollständige Neuplanung erfolgt nur bei neuem Ziel, wenn der Roboter den
+* Pfad verlassen hat oder die lokale Reparatur scheitert.
+*
+* Geplant wird auf dem Schnappschuss {\see searchgrid}; die Planung läuft
+* daher zusammen mit der Zielwahl im Such-Thread (\see explorer.h).
+*
+* Jeder Roboter besitzt einen eigenen Pfad samt Ziel; alle Funktionen
+* beziehen sich auf den mit {\see planner_select} gewählten Roboter.
+*/
+
+#ifndef PLANNER_H
+#define PLANNER_H
+
+/**
+* Punkt eines Pfades in Kartenkoordinaten
+*/
+typedef struct {
+	int x;		/*! X-Koordinate in Kartenkoordinaten */
+	int y;		/*! Y-Koordinate in Kartenkoordinaten */
+} planner_point_t;
+
+/**
+* Wählt den Roboter, auf dessen Pfad sich die folgenden Aufrufe beziehen.
+* Ohne diesen Aufruf ist Roboter 0 gewählt.
+* \param[in] robot Der Index des Roboters, 0..{\see MAP_MAX_ROBOTS}-1
+*/
+void planner_select(const int robot);
+
+/**
+* Aktualisiert den Pfad vom Roboter zum Ziel.
+*
+* Ging die letzte Wellenfront-Ausbreitung vom Roboter aus, wird ihr Distanzfeld
+* als Heuristik verwendet; sie sollte daher auf dem aktuellen Kartenstand
+* erfolgt sein.
+* \param[in] robotX Die X-Koordinate des Roboters in Kartenkoordinaten
+* \param[in] robotY Die Y-Koordinate des Roboters in Kartenkoordinaten
+* \param[in] goalX Die X-Koordinate des Ziels in Kartenkoordinaten
+* \param[in] goalY Die Y-Koordinate des Ziels in Kartenkoordinaten
+* \return Null, wenn kein Pfad gefunden wurde, ansonsten nicht-null.
+*/
+int planner_update(const int robotX, const int robotY, const int goalX, const int goalY);
+
+/**
+* Verwirft den aktuellen Pfad samt Ziel.
+*/
+void planner_reset(void);
+
+/**
+* Liefert das Ziel des aktuellen Pfades.
+* \param[out] goalX Die X-Koordinate des Ziels in Kartenkoordinaten
+* \param[out] goalY Die Y-Koordinate des Ziels in Kartenkoordinaten
+* \return Null, wenn kein Pfad existiert, ansonsten nicht-null.
+*/
+int planner_goal(int *goalX, int *goalY);
+
+/**
+* Liefert den verbleibenden Pfad, beginnend an der Position des Roboters.
+* \param[out] points Zeiger auf die Pfadpunkte; gültig bis zum nächsten Aufruf von {\see planner_update}
+* \return Anzahl der Pfadpunkte
+*/
+int planner_path(const planner_point_t **points);
+
+/**
+* Liefert einen Pfadpunkt in gegebenem Abstand vor dem Roboter.
+* \param[in] lookahead Der Abstand in Pfadpunkten
+* \param[out] x Die X-Koordinate in Kartenkoordinaten
+* \param[out] y Die Y-Koordinate in Kartenkoordinaten
+* \return Null, wenn kein Pfad existiert, ansonsten nicht-null.
+*/
+int planner_waypoint(const int lookahead, int *x, int *y);
+
+/**
+* Gibt die Ressourcen der Pfadplanung frei.
+*/
+void planner_shutdown(void);
+
+#endif
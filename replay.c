@@ -0,0 +1,206 @@
+/**
+* Wiedergabe aufgezeichneter Messungen.
+*
+* Speist die Messungen einer mit "simple --record" erstellten Aufzeichnung
+* so schnell wie möglich in Kartierung und Frontier-Suche ein, ohne Player
+* oder Stage. Nach jeder Messung wird auf die Hintergrundsuche gewartet, so
+* dass jede Messung eine eigene Suche erhält und wiederholte Läufe dasselbe
+* Ergebnis liefern; mit --async läuft die Suche wie im Betrieb nebenher und
+* Messungen während einer Suche werden übersprungen.
+*
+* Mit --load beginnt jeder Lauf statt mit einer leeren Karte mit einer
+* Ablage, mit --save wird die Karte am Ende abgelegt (\see mapfile.h).
+* Mit --match werden die Scans vor dem Eintragen mit der Karte abgeglichen
+* (\see scanmatch.h) und die Korrektur der Odometrie am Ende ausgegeben.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <libgen.h>
+#include <math.h>
+#include <time.h>
+#include <libplayerc/playerc.h>
+
+#include "map.h"
+#include "frontier.h"
+#include "explorer.h"
+#include "pipeline.h"
+#include "scanlog.h"
+
+/**
+* Liefert die monotone Systemzeit.
+* \return Die Zeit in Sekunden
+*/
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+	int async = 0;
+	int repeat = 1;
+	int scanmatching = 0;
+	const char *loadPath = NULL;
+	const char *savePath = NULL;
+	const char *program = basename(argv[0]);
+
+	/* Optionen */
+	while (argc > 1 && strncmp(argv[1], "--", 2) == 0)
+	{
+		if (strcmp(argv[1], "--async") == 0)
+		{
+			async = 1;
+		}
+		else if (strcmp(argv[1], "--match") == 0)
+		{
+			scanmatching = 1;
+		}
+		else if (strcmp(argv[1], "--repeat") == 0 && argc > 2)
+		{
+			repeat = atoi(argv[2]);
+			--argc;
+			++argv;
+		}
+		else if (strcmp(argv[1], "--load") == 0 && argc > 2)
+		{
+			loadPath = argv[2];
+			--argc;
+			++argv;
+		}
+		else if (strcmp(argv[1], "--save") == 0 && argc > 2)
+		{
+			savePath = argv[2];
+			--argc;
+			++argv;
+		}
+		else
+		{
+			break;
+		}
+		--argc;
+		++argv;
+	}
+
+	if (argc != 2 || repeat < 1)
+	{
+		printf("Usage: %s [--async] [--match] [--repeat <n>] [--load <mapfile>] [--save <mapfile>] <logfile>\n", program);
+		return 1;
+	}
+
+	scanlog_reader_t log;
+	if (scanlog_open(&log, argv[1]))
+	{
+		printf("Aufzeichnung %s kann nicht gelesen werden.\n", argv[1]);
+		return 1;
+	}
+	map_set_headless(1);
+	map_set_scanmatch(scanmatching);
+
+	static sensorframe_t frame;
+	uint32_t scans = 0;
+	double mapping = 0, slowest = 0, recorded = 0;
+	int complete = 0, status = 0;
+
+	const double start = now();
+	for (int run = 0; run < repeat; ++run)
+	{
+		/* Jeder Lauf beginnt mit einer leeren oder der geladenen Karte */
+		map_shutdown();
+		scanlog_rewind(&log);
+		if (loadPath != NULL)
+		{
+			const double before = now();
+			if (map_load(loadPath))
+			{
+				printf("Karte %s kann nicht geladen werden.\n", loadPath);
+				status = -1;
+				break;
+			}
+			if (run == 0) printf("Karte %s in %.3f ms geladen\n", loadPath, (now() - before)*1e3);
+		}
+
+		double firstTime = 0, lastTime = 0;
+		uint32_t runScans = 0;
+		while ((status = scanlog_next(&log, &frame)) > 0)
+		{
+			playerc_ranger_t ranger;
+			playerc_position2d_t pos;
+			sensorframe_view(&frame, &ranger, &pos);
+
+			const double before = now();
+			complete = map_draw(0, &ranger, &pos);
+			if (!async) explorer_wait();
+			const double elapsed = now() - before;
+
+			mapping += elapsed;
+			if (elapsed > slowest) slowest = elapsed;
+			if (runScans++ == 0) firstTime = frame.time;
+			lastTime = frame.time;
+		}
+		scans += runScans;
+		recorded += lastTime - firstTime;
+
+		if (status < 0)
+		{
+			printf("Aufzeichnung fehlerhaft nach %u Messungen.\n", runScans);
+			break;
+		}
+	}
+	const double total = now() - start;
+
+	/* Letzte Suche abwarten; danach gehört der Schnappschuss wieder der Wiedergabe */
+	explorer_wait();
+	playerc_ranger_t ranger;
+	playerc_position2d_t pos;
+	sensorframe_view(&frame, &ranger, &pos);
+	map_correct(0, &pos);
+	const int open = (scans > 0) ? checkForOpenSpaces(pos.px, pos.py, NULL, NULL) : 0;
+
+	printf("%u Messungen in %.3f s (%.3f ms je Messung, max. %.3f ms)\n",
+		scans, total, scans ? mapping*1e3/scans : 0.0, slowest*1e3);
+	if (recorded > 0)
+	{
+		printf("%.1f-fache Echtzeit (%.1f s aufgezeichnet)\n", recorded/total, recorded);
+	}
+	if (scanmatching && scans > 0)
+	{
+		printf("Korrektur der Odometrie: dx=%.3f m, dy=%.3f m, da=%.2f°\n",
+			pos.px - frame.px, pos.py - frame.py, atan2(sin(pos.pa - frame.pa), cos(pos.pa - frame.pa))*180/M_PI);
+	}
+	if (open < 0)
+	{
+		printf("Kein Speicher für die Flutung der Karte.\n");
+	}
+	printf("Karte %s: %d Frontier-Zellen, %d unkartierte erreichbar, %d Kacheln\n",
+		complete ? "vollständig" : "unvollständig", frontier_count(), (open > 0) ? open : 0, mapgrid.tileCount);
+	if (scans > 0)
+	{
+		printf("Abstand zur nächsten Wand: %.2f m\n", map_clearance(pos.px, pos.py));
+	}
+
+	if (savePath != NULL)
+	{
+		const double before = now();
+		if (map_save(savePath))
+		{
+			printf("Karte %s kann nicht abgelegt werden.\n", savePath);
+			status = -1;
+		}
+		else
+		{
+			printf("Karte %s in %.3f ms abgelegt\n", savePath, (now() - before)*1e3);
+		}
+	}
+
+	map_shutdown();
+	scanlog_close(&log);
+	return (status < 0) ? 1 : 0;
+}
@@ -0,0 +1,293 @@
+/**
+* Aufzeichnung und Wiedergabe von Messungen.
+*/
+
+#include "scanlog.h"
+#include "stdlib.h"
+#include "string.h"
+#include "math.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+* Rundet eine Größe auf die nächste 8-Byte-Grenze auf.
+* \param[in] size Die Größe in Bytes
+* \return Die aufgerundete Größe
+*/
+static inline size_t alignRecord(const size_t size)
+{
+	return (size + 7) & ~(size_t)7;
+}
+
+/**
+* Wandelt eine Entfernung in die gespeicherte Ganzzahl um.
+* \param[in] range Die Entfernung in Metern
+* \return Die Entfernung in {\see SCANLOG_RANGE_UNIT}, begrenzt auf 16 Bit
+*/
+static inline uint16_t encodeRange(const double range)
+{
+	if (!(range > 0)) return 0;
+	const long value = lround(range / SCANLOG_RANGE_UNIT);
+	return (value > UINT16_MAX) ? UINT16_MAX : (uint16_t)value;
+}
+
+/**
+* Schreibt eine vorzeichenbehaftete Zahl als ZigZag-Varint.
+* \param[out] out Der Zielspeicher
+* \param[in] value Der Wert
+* \return Anzahl der geschriebenen Bytes
+*/
+static inline int writeVarint(uint8_t *out, const int32_t value)
+{
+	uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+	int length = 0;
+	while (zigzag >= 0x80)
+	{
+		out[length++] = (uint8_t)(zigzag | 0x80);
+		zigzag >>= 7;
+	}
+	out[length++] = (uint8_t)zigzag;
+	return length;
+}
+
+/**
+* Liest eine als ZigZag-Varint gespeicherte Zahl.
+* \param[in] in Die kodierten Daten
+* \param[in] end Das Ende der kodierten Daten
+* \param[out] value Der Wert
+* \return Anzahl der gelesenen Bytes oder 0 bei fehlerhaften Daten
+*/
+static inline int readVarint(const uint8_t *in, const uint8_t *end, int32_t *value)
+{
+	uint32_t zigzag = 0;
+	for (int length = 0, shift = 0; in + length < end && shift < 32; shift += 7)
+	{
+		const uint8_t byte = in[length++];
+		zigzag |= (uint32_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+		{
+			*value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+			return length;
+		}
+	}
+	return 0;
+}
+
+/**
+* Legt eine neue Aufzeichnung an.
+* \param[out] writer Die Aufzeichnung
+* \param[in] path Der Dateiname
+* \param[in] flags Die Kodierung, z.B. {\see SCANLOG_DELTA} oder 0
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int scanlog_create(scanlog_writer_t *writer, const char *path, const uint32_t flags)
+{
+	memset(writer, 0, sizeof(scanlog_writer_t));
+	writer->file = fopen(path, "wb");
+	if (writer->file == (FILE*)0) return 1;
+	writer->flags = flags;
+
+	scanlog_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SCANLOG_MAGIC, sizeof(header.magic));
+	header.version   = SCANLOG_VERSION;
+	header.flags     = flags;
+	header.samples   = LASER_SAMPLES;
+	header.rangeUnit = SCANLOG_RANGE_UNIT;
+	if (fwrite(&header, sizeof(header), 1, writer->file) != 1)
+	{
+		fclose(writer->file);
+		writer->file = (FILE*)0;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+* Hängt eine Messung an die Aufzeichnung an.
+* \param[inout] writer Die Aufzeichnung
+* \param[in] frame Die Messung samt Pose
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int scanlog_append(scanlog_writer_t *writer, const sensorframe_t *frame)
+{
+	if (writer->file == (FILE*)0) return 1;
+
+	scanlog_record_t record;
+	memset(&record, 0, sizeof(record));
+	record.sequence = frame->sequence;
+	record.count    = (frame->count < LASER_SAMPLES) ? frame->count : LASER_SAMPLES;
+	record.time     = frame->time;
+	record.px       = frame->px;
+	record.py       = frame->py;
+	record.pa       = frame->pa;
+
+	/* Differenzen nur innerhalb gleich langer Messungen zwischen zwei Schlüsselbildern */
+	const int delta = (writer->flags & SCANLOG_DELTA) != 0;
+	record.keyframe = !delta || (writer->records % SCANLOG_KEYFRAME_INTERVAL) == 0 || record.count != writer->previousCount;
+
+	uint32_t size = 0;
+	for (uint32_t i = 0; i < record.count; ++i)
+	{
+		const uint16_t range = encodeRange(frame->ranges[i]);
+		if (!delta)
+		{
+			memcpy(&writer->buffer[size], &range, sizeof(range));
+			size += sizeof(range);
+		}
+		else
+		{
+			const int32_t reference = record.keyframe ? 0 : writer->previous[i];
+			size += writeVarint(&writer->buffer[size], (int32_t)range - reference);
+		}
+		writer->previous[i] = range;
+	}
+	writer->previousCount = record.count;
+	record.size = size;
+
+	/* Auf 8-Byte-Grenze auffüllen, damit der nächste Kopf ausgerichtet ist */
+	const size_t padded = alignRecord(size);
+	memset(&writer->buffer[size], 0, padded - size);
+
+	if (fwrite(&record, sizeof(record), 1, writer->file) != 1) return 1;
+	if (padded > 0 && fwrite(writer->buffer, padded, 1, writer->file) != 1) return 1;
+	++writer->records;
+	return 0;
+}
+
+/**
+* Schließt die Aufzeichnung.
+* \param[inout] writer Die Aufzeichnung
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int scanlog_finish(scanlog_writer_t *writer)
+{
+	if (writer->file == (FILE*)0) return 1;
+	const int result = fclose(writer->file);
+	writer->file = (FILE*)0;
+	return result != 0;
+}
+
+/**
+* Öffnet eine Aufzeichnung zur Wiedergabe und blendet sie in den Speicher ein.
+* \param[out] reader Die Aufzeichnung
+* \param[in] path Der Dateiname
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int scanlog_open(scanlog_reader_t *reader, const char *path)
+{
+	memset(reader, 0, sizeof(scanlog_reader_t));
+
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0) return 1;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(scanlog_header_t))
+	{
+		close(fd);
+		return 1;
+	}
+
+	void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) return 1;
+
+	/* Die Datei wird einmal von vorne nach hinten gelesen */
+	madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+
+	reader->data = (const uint8_t*)data;
+	reader->size = (size_t)info.st_size;
+	memcpy(&reader->header, reader->data, sizeof(scanlog_header_t));
+	reader->offset = sizeof(scanlog_header_t);
+
+	if (memcmp(reader->header.magic, SCANLOG_MAGIC, sizeof(reader->header.magic)) != 0
+	 || reader->header.version != SCANLOG_VERSION
+	 || reader->header.samples > LASER_SAMPLES
+	 || reader->header.rangeUnit <= 0)
+	{
+		scanlog_close(reader);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+* Liest die nächste Messung.
+* \param[inout] reader Die Aufzeichnung
+* \param[out] frame Die Messung samt Pose
+* \return 1 wenn eine Messung gelesen wurde, 0 am Ende der Aufzeichnung, -1 bei fehlerhaften Daten
+*/
+int scanlog_next(scanlog_reader_t *reader, sensorframe_t *frame)
+{
+	if (reader->data == (const uint8_t*)0) return -1;
+	if (reader->offset == reader->size) return 0;
+	if (reader->size - reader->offset < sizeof(scanlog_record_t)) return -1;
+
+	/* Datensätze sind ausgerichtet und werden direkt aus der Einblendung gelesen */
+	const scanlog_record_t *record = (const scanlog_record_t*)&reader->data[reader->offset];
+	const size_t padded = alignRecord(record->size);
+	if (record->count > reader->header.samples
+	 || reader->size - reader->offset - sizeof(scanlog_record_t) < padded)
+	{
+		return -1;
+	}
+
+	const uint8_t *in  = &reader->data[reader->offset + sizeof(scanlog_record_t)];
+	const uint8_t *end = in + record->size;
+	const double unit = reader->header.rangeUnit;
+	for (uint32_t i = 0; i < record->count; ++i)
+	{
+		uint16_t range;
+		if (!(reader->header.flags & SCANLOG_DELTA))
+		{
+			if (end - in < (ptrdiff_t)sizeof(range)) return -1;
+			memcpy(&range, in, sizeof(range));
+			in += sizeof(range);
+		}
+		else
+		{
+			int32_t difference;
+			const int length = readVarint(in, end, &difference);
+			if (length == 0) return -1;
+			in += length;
+			range = (uint16_t)((record->keyframe ? 0 : reader->previous[i]) + difference);
+		}
+		reader->previous[i] = range;
+		frame->ranges[i] = range * unit;
+	}
+
+	frame->sequence = record->sequence;
+	frame->count    = record->count;
+	frame->time     = record->time;
+	frame->px       = record->px;
+	frame->py       = record->py;
+	frame->pa       = record->pa;
+
+	reader->offset += sizeof(scanlog_record_t) + padded;
+	return 1;
+}
+
+/**
+* Setzt die Wiedergabe an den Anfang der Aufzeichnung zurück.
+* \param[inout] reader Die Aufzeichnung
+*/
+void scanlog_rewind(scanlog_reader_t *reader)
+{
+	reader->offset = sizeof(scanlog_header_t);
+}
+
+/**
+* Schließt die Aufzeichnung.
+* \param[inout] reader Die Aufzeichnung
+*/
+void scanlog_close(scanlog_reader_t *reader)
+{
+	if (reader->data != (const uint8_t*)0)
+	{
+		munmap((void*)reader->data, reader->size);
+	}
+	reader->data = (const uint8_t*)0;
+	reader->size = reader->offset = 0;
+}
@@ -0,0 +1,154 @@
+/**
+* Aufzeichnung und Wiedergabe von Messungen.
+*
+* Eine Aufzeichnung besteht aus einem Dateikopf und einer Folge von
+* Datensätzen, je einer pro Messung. Ein Datensatz enthält Pose und
+* Zeitstempel unverändert sowie die Entfernungen als 16-Bit-Ganzzahlen in
+* Millimetern. Wahlweise werden die Entfernungen als Differenz zur vorigen
+* Messung mit ZigZag-Varint kodiert, was bei ruhendem oder langsam fahrendem
+* Roboter nur wenige Bytes je Strahl belegt; jede
+* {\see SCANLOG_KEYFRAME_INTERVAL}. Messung wird absolut kodiert.
+*
+* Alle Datensätze beginnen an 8-Byte-Grenzen, so dass die Datei zur
+* Wiedergabe vollständig in den Speicher eingeblendet und ohne Kopie
+* gelesen werden kann.
+*/
+
+#ifndef SCANLOG_H
+#define SCANLOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "laser.h"
+#include "pipeline.h"
+
+/**
+* Kennung am Dateianfang
+*/
+#define SCANLOG_MAGIC "AMSSCAN1"
+
+/**
+* Version des Dateiformates
+*/
+#define SCANLOG_VERSION (1)
+
+/**
+* Entfernungen als Differenz zur vorigen Messung kodieren
+*/
+#define SCANLOG_DELTA (0x01)
+
+/**
+* Abstand der absolut kodierten Datensätze bei {\see SCANLOG_DELTA}
+*/
+#define SCANLOG_KEYFRAME_INTERVAL (64)
+
+/**
+* Auflösung der Entfernungen in Metern
+*/
+#define SCANLOG_RANGE_UNIT (0.001)
+
+/**
+* Dateikopf
+*/
+typedef struct {
+	char magic[8];				/*! {\see SCANLOG_MAGIC} */
+	uint32_t version;			/*! {\see SCANLOG_VERSION} */
+	uint32_t flags;				/*! Kodierung, z.B. {\see SCANLOG_DELTA} */
+	uint32_t samples;			/*! Maximale Anzahl der Strahlen je Messung */
+	uint32_t reserved;			/*! Auf 0 gesetzt */
+	double rangeUnit;			/*! Auflösung der Entfernungen in Metern */
+} scanlog_header_t;
+
+/**
+* Kopf eines Datensatzes; es folgen {\see size} Bytes kodierter Entfernungen,
+* aufgefüllt bis zur nächsten 8-Byte-Grenze.
+*/
+typedef struct {
+	uint32_t sequence;			/*! Laufende Nummer der Messung */
+	uint32_t count;				/*! Anzahl der Strahlen */
+	uint32_t size;				/*! Größe der kodierten Entfernungen in Bytes */
+	uint32_t keyframe;			/*! Nicht-null, wenn die Entfernungen absolut kodiert sind */
+	double time;				/*! Zeitstempel der Messung in Sekunden */
+	double px;					/*! X-Position im global Frame */
+	double py;					/*! Y-Position im global Frame */
+	double pa;					/*! Orientierung im global Frame */
+} scanlog_record_t;
+
+/**
+* Schreibende Seite einer Aufzeichnung
+*/
+typedef struct {
+	FILE *file;								/*! Die Datei */
+	uint32_t flags;							/*! Kodierung */
+	uint32_t records;						/*! Anzahl der geschriebenen Datensätze */
+	uint32_t previousCount;					/*! Anzahl der Strahlen der vorigen Messung */
+	uint16_t previous[LASER_SAMPLES];		/*! Entfernungen der vorigen Messung */
+	uint8_t buffer[LASER_SAMPLES*3 + 8];	/*! Kodierte Entfernungen */
+} scanlog_writer_t;
+
+/**
+* Lesende Seite einer Aufzeichnung
+*/
+typedef struct {
+	const uint8_t *data;					/*! Eingeblendeter Dateiinhalt */
+	size_t size;							/*! Größe der Datei in Bytes */
+	size_t offset;							/*! Position des nächsten Datensatzes */
+	scanlog_header_t header;				/*! Dateikopf */
+	uint16_t previous[LASER_SAMPLES];		/*! Entfernungen der vorigen Messung */
+} scanlog_reader_t;
+
+/**
+* Legt eine neue Aufzeichnung an; eine vorhandene Datei wird überschrieben.
+* \param[out] writer Die Aufzeichnung
+* \param[in] path Der Dateiname
+* \param[in] flags Die Kodierung, z.B. {\see SCANLOG_DELTA} oder 0
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int scanlog_create(scanlog_writer_t *writer, const char *path, const uint32_t flags);
+
+/**
+* Hängt eine Messung an die Aufzeichnung an.
+* \param[inout] writer Die Aufzeichnung
+* \param[in] frame Die Messung samt Pose
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int scanlog_append(scanlog_writer_t *writer, const sensorframe_t *frame);
+
+/**
+* Schließt die Aufzeichnung.
+* \param[inout] writer Die Aufzeichnung
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int scanlog_finish(scanlog_writer_t *writer);
+
+/**
+* Öffnet eine Aufzeichnung zur Wiedergabe und blendet sie in den Speicher ein.
+* \param[out] reader Die Aufzeichnung
+* \param[in] path Der Dateiname
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int scanlog_open(scanlog_reader_t *reader, const char *path);
+
+/**
+* Liest die nächste Messung.
+* \param[inout] reader Die Aufzeichnung
+* \param[out] frame Die Messung samt Pose
+* \return 1 wenn eine Messung gelesen wurde, 0 am Ende der Aufzeichnung, -1 bei fehlerhaften Daten
+*/
+int scanlog_next(scanlog_reader_t *reader, sensorframe_t *frame);
+
+/**
+* Setzt die Wiedergabe an den Anfang der Aufzeichnung zurück.
+* \param[inout] reader Die Aufzeichnung
+*/
+void scanlog_rewind(scanlog_reader_t *reader);
+
+/**
+* Schließt die Aufzeichnung.
+* \param[inout] reader Die Aufzeichnung
+*/
+void scanlog_close(scanlog_reader_t *reader);
+
+#endif
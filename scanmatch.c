@@ -0,0 +1,517 @@
+/**
+* Korrelativer Abgleich von Scans mit der Karte.
+*/
+
+#include "scanmatch.h"
+#include "stdlib.h"
+#include "string.h"
+#include "math.h"
+
+/**
+* Kandidat der Suche: eine Orientierung und ein Block von 2^level x 2^level Verschiebungen
+*/
+typedef struct {
+	int angle;			/*! Index der Orientierung */
+	int x;				/*! Kleinste Verschiebung des Blocks in X, in Zellen */
+	int y;				/*! Kleinste Verschiebung des Blocks in Y, in Zellen */
+	int32_t score;		/*! Obere Schranke der Bewertung aller Verschiebungen des Blocks */
+} candidate_t;
+
+/**
+* Bestes bisher gefundenes Ergebnis der Suche
+*/
+typedef struct {
+	int32_t score;		/*! Bewertung abzüglich Abweichung; zu Beginn die der Vorhersage */
+	int angle;			/*! Index der Orientierung oder -1, solange keine Pose die Schwelle übertraf */
+	int x;				/*! Verschiebung in X, in Zellen */
+	int y;				/*! Verschiebung in Y, in Zellen */
+} best_t;
+
+/**
+* Normiert einen Winkel auf -pi..pi.
+* \param[in] angle Der Winkel in Radians
+* \return Der normierte Winkel
+*/
+static inline double normalizeAngle(const double angle)
+{
+	return atan2(sin(angle), cos(angle));
+}
+
+/**
+* Bewertet alle Endpunkte einer Orientierung bei einer Verschiebung.
+* \param[in] matcher Der Abgleich
+* \param[in] level Die Stufe der Maximumpyramide
+* \param[in] angle Der Index der Orientierung
+* \param[in] x Die Verschiebung in X, in Zellen
+* \param[in] y Die Verschiebung in Y, in Zellen
+* \return Summe der Bewertungen; auf Stufe > 0 eine obere Schranke für den Block
+*/
+static uint32_t scorePoints(const scanmatch_t *matcher, const int level, const int angle, const int x, const int y)
+{
+	const uint8_t *grid = matcher->levels[level] + y*SCANMATCH_SIZE + x;
+	const int16_t *points = &matcher->points[2*angle*LASER_SAMPLES];
+	uint32_t score = 0;
+	for (int i = 0; i < matcher->pointCount; ++i)
+	{
+		score += grid[points[2*i+1]*SCANMATCH_SIZE + points[2*i]];
+	}
+	return score;
+}
+
+/**
+* Kleinster Betrag innerhalb eines Bereiches von Verschiebungen.
+* \param[in] low Die kleinste Verschiebung
+* \param[in] high Die größte Verschiebung
+* \return Der kleinste Betrag
+*/
+static inline int nearest(const int low, const int high)
+{
+	if (low > 0) return low;
+	if (high < 0) return -high;
+	return 0;
+}
+
+/**
+* Bewertet einen Block: Summe über die Maximumgitter seiner Stufe abzüglich
+* der kleinsten Abweichung von der Vorhersage innerhalb des Blocks. Das
+* ergibt eine obere Schranke für jede Verschiebung des Blocks und auf
+* Stufe 0 die Bewertung der Verschiebung selbst.
+* \param[in] matcher Der Abgleich
+* \param[in] level Die Stufe des Blocks
+* \param[inout] block Der Block; die Schranke wird gesetzt
+* \param[in] steps Der Index der vorhergesagten Orientierung
+*/
+static void scoreBlock(const scanmatch_t *matcher, const int level, candidate_t *block, const int steps)
+{
+	const int last = (1 << level) - 1;
+	const int xmax = (block->x + last < SCANMATCH_WINDOW_CELLS) ? block->x + last : SCANMATCH_WINDOW_CELLS;
+	const int ymax = (block->y + last < SCANMATCH_WINDOW_CELLS) ? block->y + last : SCANMATCH_WINDOW_CELLS;
+	const int deviation = nearest(block->x, xmax) + nearest(block->y, ymax) + abs(block->angle - steps);
+
+	block->score = (int32_t)scorePoints(matcher, level, block->angle, block->x, block->y)
+	             - deviation * matcher->pointCount * SCANMATCH_PENALTY;
+}
+
+/**
+* Bilinear interpolierte Bewertung einer Pose abseits des Zellrasters.
+* \param[in] matcher Der Abgleich
+* \param[in] points Die Endpunkte relativ zur vorhergesagten Position, in Zellen entlang der Weltachsen
+* \param[in] count Die Anzahl der Endpunkte
+* \param[in] dx Die Verschiebung in Welt-X, in Zellen
+* \param[in] dy Die Verschiebung in Welt-Y, in Zellen
+* \param[in] da Die Drehung um die vorhergesagte Position in Radians
+* \return Summe der Bewertungen
+*/
+static double scoreSubcell(const scanmatch_t *matcher, const double *points, const int count, const double dx, const double dy, const double da)
+{
+	const double sina = sin(da);
+	const double cosa = cos(da);
+	const double px = MAP_SCALE*matcher->predicted.px + dx;
+	const double py = MAP_SCALE*matcher->predicted.py + dy;
+	const uint8_t *grid = matcher->levels[0];
+
+	double score = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		/* Wie beim Eintragen wird zur Null hin gerundet; die Werte einer Zelle
+		 * liegen daher in ihrer Mitte auf der von der Achse abgewandten Seite */
+		const double sx = cosa*points[2*i] - sina*points[2*i+1] + px;
+		const double sy = sina*points[2*i] + cosa*points[2*i+1] + py;
+		const double u = MAP_OFFS_X - matcher->originX + sx - copysign(0.5, sx);
+		const double v = MAP_OFFS_Y - matcher->originY - sy + copysign(0.5, sy);
+		const int x = (int)floor(u);
+		const int y = (int)floor(v);
+		if (x < 0 || y < 0 || x >= SCANMATCH_SIZE-1 || y >= SCANMATCH_SIZE-1) continue;
+
+		const double fx = u - x;
+		const double fy = v - y;
+		const uint8_t *cell = &grid[y*SCANMATCH_SIZE + x];
+		const double top    = cell[0] + fx*(cell[1] - cell[0]);
+		const double bottom = cell[SCANMATCH_SIZE] + fx*(cell[SCANMATCH_SIZE+1] - cell[SCANMATCH_SIZE]);
+		score += top + fy*(bottom - top);
+	}
+	return score;
+}
+
+/**
+* Sortiert Kandidaten absteigend nach ihrer Schranke.
+*/
+static int compareCandidates(const void *a, const void *b)
+{
+	const int32_t sa = ((const candidate_t*)a)->score;
+	const int32_t sb = ((const candidate_t*)b)->score;
+	return (sa < sb) - (sa > sb);
+}
+
+/**
+* Verfeinert einen Block bis auf einzelne Verschiebungen. Teilblöcke werden
+* in absteigender Reihenfolge ihrer Schranke besucht und verworfen, sobald
+* die Schranke das beste Ergebnis nicht mehr übertrifft.
+* \param[in] matcher Der Abgleich
+* \param[in] level Die Stufe des Blocks
+* \param[in] block Der Block
+* \param[in] steps Der Index der vorhergesagten Orientierung
+* \param[inout] best Das beste bisherige Ergebnis
+*/
+static void branch(const scanmatch_t *matcher, const int level, const candidate_t *block, const int steps, best_t *best)
+{
+	if (level == 0)
+	{
+		best->score = block->score;
+		best->angle = block->angle;
+		best->x = block->x;
+		best->y = block->y;
+		return;
+	}
+
+	const int half = 1 << (level-1);
+	candidate_t children[4];
+	int count = 0;
+	for (int dy = 0; dy <= half; dy += half)
+	{
+		for (int dx = 0; dx <= half; dx += half)
+		{
+			candidate_t *child = &children[count];
+			child->angle = block->angle;
+			child->x = block->x + dx;
+			child->y = block->y + dy;
+			if (child->x > SCANMATCH_WINDOW_CELLS || child->y > SCANMATCH_WINDOW_CELLS) continue;
+			scoreBlock(matcher, level-1, child, steps);
+			++count;
+		}
+	}
+	qsort(children, count, sizeof(candidate_t), compareCandidates);
+
+	for (int i = 0; i < count && children[i].score > best->score; ++i)
+	{
+		branch(matcher, level-1, &children[i], steps, best);
+	}
+}
+
+/**
+* Legt die Gitter eines Abgleiches an.
+* \param[out] matcher Der Abgleich
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int scanmatch_init(scanmatch_t *matcher)
+{
+	memset(matcher, 0, sizeof(scanmatch_t));
+	int failed = 0;
+	for (int h = 0; h < SCANMATCH_LEVELS; ++h)
+	{
+		matcher->levels[h] = (uint8_t*)malloc(SCANMATCH_SIZE*SCANMATCH_SIZE);
+		failed |= matcher->levels[h] == (uint8_t*)0;
+	}
+	matcher->points = (int16_t*)malloc(SCANMATCH_MAX_ANGLES*LASER_SAMPLES*2*sizeof(int16_t));
+	failed |= matcher->points == (int16_t*)0;
+
+	if (failed) scanmatch_free(matcher);
+	return failed;
+}
+
+/**
+* Gibt die Gitter eines Abgleiches frei.
+* \param[inout] matcher Der Abgleich
+*/
+void scanmatch_free(scanmatch_t *matcher)
+{
+	for (int h = 0; h < SCANMATCH_LEVELS; ++h)
+	{
+		free(matcher->levels[h]);
+	}
+	free(matcher->points);
+	memset(matcher, 0, sizeof(scanmatch_t));
+}
+
+/**
+* Wendet eine Korrektur auf eine Pose der Odometrie an.
+* \param[in] correction Die Korrektur
+* \param[in] odometry Die Pose laut Odometrie
+* \param[out] pose Die korrigierte Pose
+*/
+void scanmatch_apply(const scanmatch_correction_t *correction, const playerc_position2d_t *odometry, playerc_position2d_t *pose)
+{
+	const double sina = sin(correction->a);
+	const double cosa = cos(correction->a);
+	const double px = odometry->px;
+	const double py = odometry->py;
+	const double pa = odometry->pa;
+
+	*pose = *odometry;
+	pose->px = cosa*px - sina*py + correction->x;
+	pose->py = sina*px + cosa*py + correction->y;
+	pose->pa = normalizeAngle(pa + correction->a);
+}
+
+/**
+* Beginnt einen Abgleich und bildet die Gitter um die vorhergesagte Pose.
+* \param[inout] matcher Der Abgleich
+* \param[in] grid Die Karte
+* \param[in] odometry Die Pose laut Odometrie
+*/
+void scanmatch_prepare(scanmatch_t *matcher, const grid_t *grid, const playerc_position2d_t *odometry)
+{
+	scanmatch_apply(&matcher->correction, odometry, &matcher->predicted);
+	matcher->originX = MAP_OFFS_X+(int)(MAP_SCALE*matcher->predicted.px) - SCANMATCH_RADIUS;
+	matcher->originY = MAP_OFFS_Y-(int)(MAP_SCALE*matcher->predicted.py) - SCANMATCH_RADIUS;
+
+	/* Log-Odds kachelweise unter der Sperre der Kachel übernehmen; belegte
+	 * Zellen werden auf 1..255 abgebildet, freie und unbekannte auf 0 */
+	uint8_t *raw = matcher->levels[1];
+	memset(raw, 0, SCANMATCH_SIZE*SCANMATCH_SIZE);
+	const int x0 = matcher->originX;
+	const int y0 = matcher->originY;
+	const int x1 = x0 + SCANMATCH_SIZE;
+	const int y1 = y0 + SCANMATCH_SIZE;
+	for (int ty = y0 >> GRID_TILE_SHIFT; ty <= (y1-1) >> GRID_TILE_SHIFT; ++ty)
+	{
+		for (int tx = x0 >> GRID_TILE_SHIFT; tx <= (x1-1) >> GRID_TILE_SHIFT; ++tx)
+		{
+			grid_tile_t *tile = grid_tile(grid, tx*GRID_TILE_SIZE, ty*GRID_TILE_SIZE);
+			if (tile == (grid_tile_t*)0) continue;
+
+			const int cx0 = tx*GRID_TILE_SIZE > x0 ? tx*GRID_TILE_SIZE : x0;
+			const int cy0 = ty*GRID_TILE_SIZE > y0 ? ty*GRID_TILE_SIZE : y0;
+			const int cx1 = (tx+1)*GRID_TILE_SIZE < x1 ? (tx+1)*GRID_TILE_SIZE : x1;
+			const int cy1 = (ty+1)*GRID_TILE_SIZE < y1 ? (ty+1)*GRID_TILE_SIZE : y1;
+
+			grid_tile_lock(tile);
+			for (int y = cy0; y < cy1; ++y)
+			{
+				const int8_t *odds = &tile->odds[grid_tile_index(cx0, y)];
+				uint8_t *row = &raw[(y - y0)*SCANMATCH_SIZE + (cx0 - x0)];
+				for (int x = 0; x < cx1 - cx0; ++x)
+				{
+					row[x] = (odds[x] > 0) ? (uint8_t)(odds[x]*255 / GRID_ODDS_MAX) : 0;
+				}
+			}
+			grid_tile_unlock(tile);
+		}
+	}
+
+	/* Bewertungsgitter: Wände werden dick eingetragen; die zweifache
+	 * Glättung mit (1 2 1)/4 je Achse legt das Maximum in ihre Mitte und
+	 * lässt die Bewertung zu beiden Seiten über zwei Zellen abfallen */
+	uint8_t *rows = matcher->levels[2];
+	memset(rows, 0, SCANMATCH_SIZE*SCANMATCH_SIZE);
+	for (int y = 0; y < SCANMATCH_SIZE; ++y)
+	{
+		const uint8_t *in = &raw[y*SCANMATCH_SIZE];
+		uint8_t *out = &rows[y*SCANMATCH_SIZE];
+		for (int x = 2; x < SCANMATCH_SIZE-2; ++x)
+		{
+			out[x] = (uint8_t)((in[x-2] + 4*in[x-1] + 6*in[x] + 4*in[x+1] + in[x+2] + 8) >> 4);
+		}
+	}
+	uint8_t *score = matcher->levels[0];
+	memset(score, 0, SCANMATCH_SIZE*SCANMATCH_SIZE);
+	for (int y = 2; y < SCANMATCH_SIZE-2; ++y)
+	{
+		const uint8_t *in = &rows[y*SCANMATCH_SIZE];
+		uint8_t *out = &score[y*SCANMATCH_SIZE];
+		for (int x = 0; x < SCANMATCH_SIZE; ++x)
+		{
+			out[x] = (uint8_t)((in[x-2*SCANMATCH_SIZE] + 4*in[x-SCANMATCH_SIZE] + 6*in[x]
+			                  + 4*in[x+SCANMATCH_SIZE] + in[x+2*SCANMATCH_SIZE] + 8) >> 4);
+		}
+	}
+
+	/* Stufe h: Maximum über die vier Blöcke der Stufe h-1 ab jeder Zelle */
+	for (int h = 1; h < SCANMATCH_LEVELS; ++h)
+	{
+		const int half = 1 << (h-1);
+		const uint8_t *lower = matcher->levels[h-1];
+		uint8_t *upper = matcher->levels[h];
+		memset(upper, 0, SCANMATCH_SIZE*SCANMATCH_SIZE);
+		for (int y = 0; y < SCANMATCH_SIZE - half; ++y)
+		{
+			const uint8_t *row  = &lower[y*SCANMATCH_SIZE];
+			const uint8_t *next = &lower[(y+half)*SCANMATCH_SIZE];
+			uint8_t *out = &upper[y*SCANMATCH_SIZE];
+			for (int x = 0; x < SCANMATCH_SIZE - half; ++x)
+			{
+				uint8_t a = row[x]  > row[x+half]  ? row[x]  : row[x+half];
+				uint8_t b = next[x] > next[x+half] ? next[x] : next[x+half];
+				out[x] = a > b ? a : b;
+			}
+		}
+	}
+}
+
+/**
+* Sucht die zum Scan passende Pose und führt die Korrektur nach.
+* \param[inout] matcher Der Abgleich
+* \param[in] ranger Der Laser-Ranger
+* \param[in] odometry Die Pose laut Odometrie
+* \param[out] pose Die korrigierte Pose
+* \return Nicht-null, wenn die Karte die Pose bestätigt oder korrigiert hat, Null bei bloßer Vorhersage
+*/
+int scanmatch_search(scanmatch_t *matcher, const playerc_ranger_t *ranger, const playerc_position2d_t *odometry, playerc_position2d_t *pose)
+{
+	*pose = matcher->predicted;
+
+	/* Winkelschritt so, dass der fernste Endpunkt um höchstens eine Zelle
+	 * wandert; Messungen unterhalb der Mindestdistanz sind ungültig */
+	double reach = 0;
+	int hits = 0;
+	const uint32_t count = (ranger->ranges_count < LASER_SAMPLES) ? ranger->ranges_count : LASER_SAMPLES;
+	for (uint32_t a = 0; a < count; ++a)
+	{
+		const double r = ranger->ranges[a];
+		if (!(r >= LASER_RANGE_MIN && r < LASER_RANGE_MAX - LASER_RANGE_EPSILON)) continue;
+		reach = (r > reach) ? r : reach;
+		++hits;
+	}
+	if (hits < SCANMATCH_MIN_HITS)
+	{
+		++matcher->rejected;
+		return 0;
+	}
+
+	const double resolution = 1.0 / MAP_SCALE;
+	double step = acos(1.0 - resolution*resolution / (2.0*reach*reach));
+	int steps = (int)ceil(SCANMATCH_WINDOW_ANGLE / step);
+	if (steps > SCANMATCH_MAX_STEPS)
+	{
+		steps = SCANMATCH_MAX_STEPS;
+		step = SCANMATCH_WINDOW_ANGLE / steps;
+	}
+
+	/* Endpunkte je Orientierung in Gitterkoordinaten; der Rand hält die
+	 * Verschiebungen samt oberster Pyramidenstufe innerhalb der Gitter */
+	const int low  = SCANMATCH_WINDOW_CELLS;
+	const int high = SCANMATCH_SIZE - 1 - SCANMATCH_WINDOW_CELLS - (1 << (SCANMATCH_LEVELS-1));
+	const int angles = 2*steps + 1;
+	for (int k = 0; k < angles; ++k)
+	{
+		playerc_position2d_t rotated = matcher->predicted;
+		rotated.pa += (k - steps)*step;
+		transformScanToMap(ranger, &rotated, &matcher->scan);
+
+		int16_t *points = &matcher->points[2*k*LASER_SAMPLES];
+		int n = 0;
+		for (uint32_t a = 0; a < matcher->scan.count; ++a)
+		{
+			if (!matcher->scan.hit[a] || ranger->ranges[a] < LASER_RANGE_MIN) continue;
+			int x = matcher->scan.cellx[a] - matcher->originX;
+			int y = matcher->scan.celly[a] - matcher->originY;
+			x = (x < low) ? low : ((x > high) ? high : x);
+			y = (y < low) ? low : ((y > high) ? high : y);
+			points[2*n]   = (int16_t)x;
+			points[2*n+1] = (int16_t)y;
+			++n;
+		}
+		matcher->pointCount = n;
+	}
+
+	/* Die Vorhersage muss echt übertroffen werden, sonst bleibt sie stehen */
+	const int32_t predicted = (int32_t)scorePoints(matcher, 0, steps, 0, 0);
+	best_t best;
+	best.score = predicted;
+	best.angle = -1;
+	best.x = best.y = 0;
+
+	/* Blöcke der obersten Stufe für alle Orientierungen, beste zuerst */
+	const int top = SCANMATCH_LEVELS-1;
+	const int width = 1 << top;
+	candidate_t candidates[SCANMATCH_MAX_ANGLES * 4];
+	int candidateCount = 0;
+	for (int k = 0; k < angles; ++k)
+	{
+		for (int y = -SCANMATCH_WINDOW_CELLS; y <= SCANMATCH_WINDOW_CELLS; y += width)
+		{
+			for (int x = -SCANMATCH_WINDOW_CELLS; x <= SCANMATCH_WINDOW_CELLS; x += width)
+			{
+				candidate_t *candidate = &candidates[candidateCount++];
+				candidate->angle = k;
+				candidate->x = x;
+				candidate->y = y;
+				scoreBlock(matcher, top, candidate, steps);
+			}
+		}
+	}
+	qsort(candidates, candidateCount, sizeof(candidate_t), compareCandidates);
+
+	for (int i = 0; i < candidateCount && candidates[i].score > best.score; ++i)
+	{
+		branch(matcher, top, &candidates[i], steps, &best);
+	}
+
+	/* Übernehmen nur bei ausreichender Übereinstimmung mit der Karte */
+	const int32_t minimum = matcher->pointCount * SCANMATCH_MIN_SCORE;
+	if ((best.angle < 0) ? predicted < minimum : best.score < minimum)
+	{
+		++matcher->rejected;
+		return 0;
+	}
+
+	/* Endpunkte relativ zur vorhergesagten Position für die Verfeinerung */
+	transformScanToMap(ranger, &matcher->predicted, &matcher->scan);
+	double points[2*LASER_SAMPLES];
+	int n = 0;
+	for (uint32_t a = 0; a < matcher->scan.count; ++a)
+	{
+		if (!matcher->scan.hit[a] || ranger->ranges[a] < LASER_RANGE_MIN) continue;
+		points[2*n]   = MAP_SCALE*(matcher->scan.x[a] - matcher->predicted.px);
+		points[2*n+1] = MAP_SCALE*(matcher->scan.y[a] - matcher->predicted.py);
+		++n;
+	}
+
+	/* Vom Ergebnis der Suche aus in halbierten Schritten bergauf; Gitter-Y
+	 * zeigt entgegen der Welt-Y-Achse */
+	double dx = 0, dy = 0, da = 0;
+	if (best.angle >= 0)
+	{
+		dx = best.x;
+		dy = -best.y;
+		da = (best.angle - steps)*step;
+	}
+	const double penalty = (double)n * SCANMATCH_PENALTY;
+	double current = scoreSubcell(matcher, points, n, dx, dy, da) - penalty*(fabs(dx) + fabs(dy) + fabs(da)/step);
+	double linear = 0.5;
+	double angular = 0.5*step;
+	for (int round = 0; round < SCANMATCH_REFINE_ROUNDS; ++round)
+	{
+		for (int i = 0; i < SCANMATCH_REFINE_ITERATIONS; ++i)
+		{
+			const double moves[6][3] = {
+				{ linear, 0, 0 }, { -linear, 0, 0 },
+				{ 0, linear, 0 }, { 0, -linear, 0 },
+				{ 0, 0, angular }, { 0, 0, -angular }
+			};
+			int move = -1;
+			for (int m = 0; m < 6; ++m)
+			{
+				const double x = dx + moves[m][0];
+				const double y = dy + moves[m][1];
+				const double a = da + moves[m][2];
+				const double score = scoreSubcell(matcher, points, n, x, y, a) - penalty*(fabs(x) + fabs(y) + fabs(a)/step);
+				if (score > current)
+				{
+					current = score;
+					move = m;
+				}
+			}
+			if (move < 0) break;
+			dx += moves[move][0];
+			dy += moves[move][1];
+			da += moves[move][2];
+		}
+		linear *= 0.5;
+		angular *= 0.5;
+	}
+
+	pose->px = matcher->predicted.px + dx / MAP_SCALE;
+	pose->py = matcher->predicted.py + dy / MAP_SCALE;
+	pose->pa = normalizeAngle(matcher->predicted.pa + da);
+
+	/* Korrektur so wählen, dass sie die Odometrie auf die gefundene Pose abbildet */
+	const double rotation = normalizeAngle(pose->pa - odometry->pa);
+	const double sina = sin(rotation);
+	const double cosa = cos(rotation);
+	matcher->correction.a = rotation;
+	matcher->correction.x = pose->px - (cosa*odometry->px - sina*odometry->py);
+	matcher->correction.y = pose->py - (sina*odometry->px + cosa*odometry->py);
+	++matcher->matched;
+	return 1;
+}
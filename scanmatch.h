@@ -0,0 +1,179 @@
+/**
+* Korrelativer Abgleich von Scans mit der Karte.
+*
+* Die Odometrie eines Roboters driftet; werden ihre Posen unverändert
+* übernommen, verschmieren Wände und es entstehen falsche Frontier-Zellen.
+* Vor dem Eintragen wird ein Scan daher mit der Karte abgeglichen: Gesucht
+* wird in einem Fenster um die vorhergesagte Pose diejenige Pose, an der die
+* Endpunkte des Scans auf möglichst sicher belegte Zellen fallen.
+*
+* Je Scan wird aus den Log-Odds um den Roboter ein geglättetes
+* Bewertungsgitter gebildet und daraus eine Pyramide von Maximumgittern, deren Stufe h je
+* Zelle das Maximum über 2^h x 2^h Zellen enthält. Für jeden der aus der
+* Laserreichweite abgeleiteten Winkelschritte wird der Scan mit
+* {\see transformScanToMap} einmal transformiert; die Verschiebungen werden
+* per Branch-and-Bound durchsucht. Auf Stufe h liefert die Summe über die
+* Maximumgitter eine obere Schranke für alle 2^h x 2^h Verschiebungen des
+* Blocks, so dass Blöcke ohne Aussicht auf eine bessere Pose verworfen
+* werden, ohne ihre Verschiebungen einzeln zu bewerten. Das Ergebnis ist
+* dasselbe wie bei vollständiger Suche. Anschließend wird die Pose auf dem
+* bilinear interpolierten Bewertungsgitter bis auf eine Achtelzelle
+* verfeinert; ohne diesen Schritt ginge Drift unterhalb einer Zelle je Scan
+* in die Karte ein, bevor die Suche sie erkennen könnte.
+*
+* Die gefundene Pose wird als Korrektur der Odometrie gespeichert und auf
+* die folgenden Posen angewendet, so dass sich das Suchfenster mit der
+* Drift mitbewegt. Jede Abweichung von der Vorhersage kostet einen
+* Abzug, so dass eine Pose nur übernommen wird, wenn sie die Vorhersage
+* entsprechend übertrifft; in Richtungen, die der Scan nicht festlegt (etwa
+* entlang eines Flures), bleibt die Vorhersage bestehen. Fallen zu wenige
+* Endpunkte auf Wände, etwa vor dem Aufbau einer Karte, wird der Abgleich
+* verworfen.
+*/
+
+#ifndef SCANMATCH_H
+#define SCANMATCH_H
+
+#include <stdint.h>
+#include <libplayerc/playerc.h>
+
+#include "map.h"
+#include "grid.h"
+#include "laser.h"
+#include "transforms.h"
+
+/**
+* Halbe Kantenlänge des Suchfensters für die Position in Zellen (±0,2 m)
+*/
+#define SCANMATCH_WINDOW_CELLS (6)
+
+/**
+* Halbe Breite des Suchfensters für die Orientierung in Radians (±5,7°)
+*/
+#define SCANMATCH_WINDOW_ANGLE (0.1)
+
+/**
+* Anzahl der Stufen der Maximumpyramide; die oberste fasst 8 x 8 Verschiebungen zusammen
+*/
+#define SCANMATCH_LEVELS (4)
+
+/**
+* Mindestanzahl der Endpunkte innerhalb der Reichweite für einen Abgleich
+*/
+#define SCANMATCH_MIN_HITS (40)
+
+/**
+* Mindestbewertung je Endpunkt (0..255), ab der eine Pose übernommen wird
+*/
+#define SCANMATCH_MIN_SCORE (96)
+
+/**
+* Abzug je Endpunkt (von 255) für jede Zelle und jeden Winkelschritt
+* Abweichung von der Vorhersage, auch bei der Verfeinerung; entscheidet bei
+* gleichwertigen Posen, etwa entlang einer geraden Wand, für die Vorhersage
+*/
+#define SCANMATCH_PENALTY (2)
+
+/**
+* Anzahl der Halbierungen der Schrittweite bei der Verfeinerung; ab einer
+* halben Zelle und einem halben Winkelschritt
+*/
+#define SCANMATCH_REFINE_ROUNDS (3)
+
+/**
+* Höchstzahl der Schritte je Schrittweite bei der Verfeinerung
+*/
+#define SCANMATCH_REFINE_ITERATIONS (8)
+
+/**
+* Halbe Kantenlänge des Bewertungsgitters in Zellen: Laserreichweite plus Suchfenster
+*/
+#define SCANMATCH_RADIUS ((int)(LASER_RANGE_MAX*MAP_SCALE) + SCANMATCH_WINDOW_CELLS + 2)
+
+/**
+* Kantenlänge des Bewertungsgitters samt Rand für die oberste Pyramidenstufe
+*/
+#define SCANMATCH_SIZE (2*SCANMATCH_RADIUS + 1 + (1 << (SCANMATCH_LEVELS-1)))
+
+/**
+* Höchstzahl der Winkelschritte je Seite der vorhergesagten Orientierung
+*/
+#define SCANMATCH_MAX_STEPS (32)
+
+/**
+* Höchstzahl der bewerteten Orientierungen
+*/
+#define SCANMATCH_MAX_ANGLES (2*SCANMATCH_MAX_STEPS + 1)
+
+/**
+* Korrektur der Odometrie: Drehung um den Ursprung, dann Verschiebung
+*/
+typedef struct {
+	double x;					/*! Verschiebung im global Frame, X */
+	double y;					/*! Verschiebung im global Frame, Y */
+	double a;					/*! Drehung in Radians */
+} scanmatch_correction_t;
+
+/**
+* Abgleich eines Roboters
+*/
+typedef struct {
+	scanmatch_correction_t correction;	/*! Aktuelle Korrektur der Odometrie */
+	uint8_t *levels[SCANMATCH_LEVELS];	/*! Maximumgitter je Stufe, zeilenweise; Stufe 0 ist das Bewertungsgitter */
+	int originX;				/*! Kartenkoordinaten der ersten Zelle der Gitter */
+	int originY;
+	playerc_position2d_t predicted;	/*! Vorhergesagte Pose des laufenden Abgleiches */
+	laserscan_t scan;			/*! Scan der jeweils bewerteten Orientierung */
+	int16_t *points;			/*! Endpunkte je Orientierung als Gitterkoordinaten x,y */
+	int pointCount;				/*! Anzahl der Endpunkte je Orientierung */
+	uint32_t matched;			/*! Anzahl der übernommenen Abgleiche */
+	uint32_t rejected;			/*! Anzahl der verworfenen Abgleiche */
+} scanmatch_t;
+
+/**
+* Legt die Gitter eines Abgleiches an; die Korrektur ist zunächst leer.
+* \param[out] matcher Der Abgleich
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+int scanmatch_init(scanmatch_t *matcher);
+
+/**
+* Gibt die Gitter eines Abgleiches frei.
+* \param[inout] matcher Der Abgleich
+*/
+void scanmatch_free(scanmatch_t *matcher);
+
+/**
+* Wendet eine Korrektur auf eine Pose der Odometrie an.
+* \param[in] correction Die Korrektur, z.B. {\see scanmatch_t::correction}
+* \param[in] odometry Die Pose laut Odometrie
+* \param[out] pose Die korrigierte Pose; darf {\see odometry} sein
+*/
+void scanmatch_apply(const scanmatch_correction_t *correction, const playerc_position2d_t *odometry, playerc_position2d_t *pose);
+
+/**
+* Beginnt einen Abgleich: sagt die Pose aus Odometrie und bisheriger
+* Korrektur voraus und bildet die Gitter aus der Karte um diese Pose.
+*
+* Gelesen werden die Log-Odds unter den Sperren der jeweiligen Kacheln; der
+* Aufrufer muss das Kachelverzeichnis für die Dauer des Aufrufes gegen
+* Veränderung sichern, darf aber selbst keine Kachel gesperrt halten.
+* \param[inout] matcher Der Abgleich
+* \param[in] grid Die Karte
+* \param[in] odometry Die Pose laut Odometrie
+*/
+void scanmatch_prepare(scanmatch_t *matcher, const grid_t *grid, const playerc_position2d_t *odometry);
+
+/**
+* Sucht die zum Scan passende Pose und führt die Korrektur nach. Liest nur
+* die mit {\see scanmatch_prepare} gebildeten Gitter, die Karte darf
+* währenddessen verändert werden.
+* \param[inout] matcher Der Abgleich
+* \param[in] ranger Der Laser-Ranger
+* \param[in] odometry Die Pose laut Odometrie, wie bei {\see scanmatch_prepare}
+* \param[out] pose Die korrigierte Pose
+* \return Nicht-null, wenn die Karte die Pose bestätigt oder korrigiert hat, Null bei bloßer Vorhersage
+*/
+int scanmatch_search(scanmatch_t *matcher, const playerc_ranger_t *ranger, const playerc_position2d_t *odometry, playerc_position2d_t *pose);
+
+#endif
@@ -0,0 +1,208 @@
+/**
+* Sektorstatistik eines Scans für die Regelung.
+*/
+
+#include "scanstats.h"
+
+/**
+* Liefert den Strahl zu einem Winkel, begrenzt auf die gültigen Strahlen.
+* \param[in] stats Die Tabellen
+* \param[in] angle Der Winkel in Grad
+* \return Der Index des Strahles
+*/
+static inline int beamIndex(const scanstats_t *stats, const double angle)
+{
+	const int index = LASER_RANGEINDEX_FROM_ANGLE_DEG(angle);
+	if (index < 0) return 0;
+	if (index >= stats->count) return stats->count - 1;
+	return index;
+}
+
+/**
+* Ermittelt die Strahlen eines Sektors.
+* \param[in] stats Die Tabellen
+* \param[in] start_angle Der Startwinkel in Grad
+* \param[in] end_angle Der Endwinkel in Grad
+* \param[out] first Der erste Strahl
+* \param[out] last Der letzte Strahl
+*/
+static inline void sector(const scanstats_t *stats, const double start_angle, const double end_angle, int *first, int *last)
+{
+	*first = beamIndex(stats, (start_angle < end_angle) ? start_angle : end_angle);
+	*last  = beamIndex(stats, (start_angle < end_angle) ? end_angle : start_angle);
+}
+
+/**
+* Liefert die Stufe der Sparse Table, deren Einträge eine Folge von Blöcken
+* mit zwei Einträgen abdecken.
+* \param[in] length Die Anzahl der Blöcke, mindestens 1
+* \return Die Stufe, floor(log2(length))
+*/
+static inline int level(const int length)
+{
+	return 31 - __builtin_clz((unsigned)length);
+}
+
+/**
+* Bildet die Tabellen eines Scans.
+* \param[out] stats Die Tabellen
+* \param[in] ranger Der Laser-Ranger
+*/
+void scanstats_build(scanstats_t *stats, const playerc_ranger_t *ranger)
+{
+	const int count = (ranger->ranges_count < LASER_SAMPLES) ? ranger->ranges_count : LASER_SAMPLES;
+	stats->count = (count > 0) ? count : 0;
+
+	/* Präfixsummen in einem Durchlauf über alle Strahlen */
+	stats->sums[0] = 0;
+	for (int i = 0; i < stats->count; ++i)
+	{
+		stats->ranges[i] = ranger->ranges[i];
+		stats->sums[i+1] = stats->sums[i] + stats->ranges[i];
+	}
+
+	/* Extrema je Block ab Blockanfang und bis Blockende */
+	const int blocks = (stats->count + SCANSTATS_BLOCK-1) >> SCANSTATS_BLOCK_SHIFT;
+	for (int b = 0; b < blocks; ++b)
+	{
+		const int first = b << SCANSTATS_BLOCK_SHIFT;
+		const int last = (first + SCANSTATS_BLOCK < stats->count) ? first + SCANSTATS_BLOCK-1 : stats->count-1;
+		const double *ranges = stats->ranges;
+
+		double low = ranges[first], high = ranges[first];
+		for (int i = first; i <= last; ++i)
+		{
+			low  = (ranges[i] < low)  ? ranges[i] : low;
+			high = (ranges[i] > high) ? ranges[i] : high;
+			stats->headMin[i] = low;
+			stats->headMax[i] = high;
+		}
+
+		low = high = ranges[last];
+		for (int i = last; i >= first; --i)
+		{
+			low  = (ranges[i] < low)  ? ranges[i] : low;
+			high = (ranges[i] > high) ? ranges[i] : high;
+			stats->tailMin[i] = low;
+			stats->tailMax[i] = high;
+		}
+
+		stats->blockMin[0][b] = low;
+		stats->blockMax[0][b] = high;
+	}
+
+	/* Stufe k der Blocktabelle fasst je zwei Einträge der Stufe k-1 zusammen */
+	for (int k = 1; k < SCANSTATS_LEVELS && (1 << k) <= blocks; ++k)
+	{
+		const int half = 1 << (k-1);
+		for (int b = 0; b + (1 << k) <= blocks; ++b)
+		{
+			const double *lowMin = &stats->blockMin[k-1][b];
+			const double *lowMax = &stats->blockMax[k-1][b];
+			stats->blockMin[k][b] = (lowMin[0] < lowMin[half]) ? lowMin[0] : lowMin[half];
+			stats->blockMax[k][b] = (lowMax[0] > lowMax[half]) ? lowMax[0] : lowMax[half];
+		}
+	}
+}
+
+/**
+* Liefert die Distanz des Strahles zu einem Winkel.
+* \param[in] stats Die Tabellen
+* \param[in] angle Der Winkel in Grad
+* \return Die Distanz in Metern, 0 ohne gültige Strahlen
+*/
+double scanstats_range(const scanstats_t *stats, const double angle)
+{
+	if (stats->count == 0) return 0;
+	return stats->ranges[beamIndex(stats, angle)];
+}
+
+/**
+* Mittelt die Distanzen im Bereich zweier Winkel.
+* \param[in] stats Die Tabellen
+* \param[in] start_angle Der Startwinkel in Grad
+* \param[in] end_angle Der Endwinkel in Grad
+* \return Die mittlere Distanz in Metern, 0 ohne gültige Strahlen
+*/
+double scanstats_mean(const scanstats_t *stats, const double start_angle, const double end_angle)
+{
+	if (stats->count == 0) return 0;
+
+	int first, last;
+	sector(stats, start_angle, end_angle, &first, &last);
+	return (stats->sums[last+1] - stats->sums[first]) / (last - first + 1.0);
+}
+
+/**
+* Liefert die kleinste Distanz im Bereich zweier Winkel.
+* \param[in] stats Die Tabellen
+* \param[in] start_angle Der Startwinkel in Grad
+* \param[in] end_angle Der Endwinkel in Grad
+* \return Die kleinste Distanz in Metern, 0 ohne gültige Strahlen
+*/
+double scanstats_min(const scanstats_t *stats, const double start_angle, const double end_angle)
+{
+	if (stats->count == 0) return 0;
+
+	int first, last;
+	sector(stats, start_angle, end_angle, &first, &last);
+	const int firstBlock = first >> SCANSTATS_BLOCK_SHIFT;
+	const int lastBlock = last >> SCANSTATS_BLOCK_SHIFT;
+
+	/* Innerhalb eines Blockes höchstens {\see SCANSTATS_BLOCK} Strahlen ablaufen */
+	double minimum = stats->ranges[first];
+	if (firstBlock == lastBlock)
+	{
+		for (int i = first+1; i <= last; ++i)
+			if (stats->ranges[i] < minimum) minimum = stats->ranges[i];
+		return minimum;
+	}
+
+	minimum = (stats->tailMin[first] < stats->headMin[last]) ? stats->tailMin[first] : stats->headMin[last];
+	if (lastBlock - firstBlock > 1)
+	{
+		const int k = level(lastBlock - firstBlock - 1);
+		const double a = stats->blockMin[k][firstBlock+1];
+		const double b = stats->blockMin[k][lastBlock - (1 << k)];
+		if (a < minimum) minimum = a;
+		if (b < minimum) minimum = b;
+	}
+	return minimum;
+}
+
+/**
+* Liefert die größte Distanz im Bereich zweier Winkel.
+* \param[in] stats Die Tabellen
+* \param[in] start_angle Der Startwinkel in Grad
+* \param[in] end_angle Der Endwinkel in Grad
+* \return Die größte Distanz in Metern, 0 ohne gültige Strahlen
+*/
+double scanstats_max(const scanstats_t *stats, const double start_angle, const double end_angle)
+{
+	if (stats->count == 0) return 0;
+
+	int first, last;
+	sector(stats, start_angle, end_angle, &first, &last);
+	const int firstBlock = first >> SCANSTATS_BLOCK_SHIFT;
+	const int lastBlock = last >> SCANSTATS_BLOCK_SHIFT;
+
+	/* Innerhalb eines Blockes höchstens {\see SCANSTATS_BLOCK} Strahlen ablaufen */
+	double maximum = stats->ranges[first];
+	if (firstBlock == lastBlock)
+	{
+		for (int i = first+1; i <= last; ++i)
+			if (stats->ranges[i] > maximum) maximum = stats->ranges[i];
+		return maximum;
+	}
+
+	maximum = (stats->tailMax[first] > stats->headMax[last]) ? stats->tailMax[first] : stats->headMax[last];
+	if (lastBlock - firstBlock > 1)
+	{
+		const int k = level(lastBlock - firstBlock - 1);
+		const double a = stats->blockMax[k][firstBlock+1];
+		const double b = stats->blockMax[k][lastBlock - (1 << k)];
+		if (a > maximum) maximum = a;
+		if (b > maximum) maximum = b;
+	}
+	return maximum;
+}
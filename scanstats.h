@@ -0,0 +1,102 @@
+/**
+* Sektorstatistik eines Scans für die Regelung.
+*
+* Die Regelung bewertet den Scan in mehreren, teils überlappenden
+* Winkelsektoren. Statt jeden Sektor einzeln abzulaufen, werden je Scan in
+* zwei Durchläufen Tabellen gebildet: Präfixsummen für den Mittelwert sowie
+* für Minimum und Maximum die Extrema innerhalb von Blöcken zu
+* {\see SCANSTATS_BLOCK} Strahlen, jeweils vom Blockanfang und bis zum
+* Blockende. Ein Sektor über mehrere Blöcke setzt sich aus dem Ende seines
+* ersten Blockes, dem Anfang seines letzten Blockes und den vollen Blöcken
+* dazwischen zusammen; letztere deckt eine Sparse Table über die Blöcke mit
+* zwei sich überlappenden Einträgen ab. Jeder Sektor wird so in O(1)
+* ausgewertet, unabhängig von seiner Breite und der Anzahl der Sektoren,
+* während das Bilden linear in der Anzahl der Strahlen bleibt.
+*/
+
+#ifndef SCANSTATS_H
+#define SCANSTATS_H
+
+#include <libplayerc/playerc.h>
+
+#include "laser.h"
+
+/**
+* Zweierlogarithmus der Anzahl der Strahlen je Block
+*/
+#define SCANSTATS_BLOCK_SHIFT (4)
+
+/**
+* Anzahl der Strahlen je Block; kürzere Sektoren werden direkt abgelaufen
+*/
+#define SCANSTATS_BLOCK (1 << SCANSTATS_BLOCK_SHIFT)
+
+/**
+* Anzahl der Blöcke eines Scans
+*/
+#define SCANSTATS_BLOCKS ((LASER_SAMPLES + SCANSTATS_BLOCK-1) / SCANSTATS_BLOCK)
+
+/**
+* Anzahl der Stufen der Sparse Table über die Blöcke; die oberste deckt 32 Blöcke ab
+*/
+#define SCANSTATS_LEVELS (6)
+
+/**
+* Tabellen eines Scans
+*/
+typedef struct {
+	int count;									/*! Anzahl der gültigen Strahlen */
+	double ranges[LASER_SAMPLES];				/*! Gemessene Distanzen in Metern */
+	double sums[LASER_SAMPLES+1];				/*! Summe der ersten i Strahlen */
+	double headMin[LASER_SAMPLES];				/*! Minimum vom Blockanfang bis zum Strahl */
+	double headMax[LASER_SAMPLES];				/*! Maximum vom Blockanfang bis zum Strahl */
+	double tailMin[LASER_SAMPLES];				/*! Minimum vom Strahl bis zum Blockende */
+	double tailMax[LASER_SAMPLES];				/*! Maximum vom Strahl bis zum Blockende */
+	double blockMin[SCANSTATS_LEVELS][SCANSTATS_BLOCKS];	/*! Minimum über 2^k Blöcke ab dem Block */
+	double blockMax[SCANSTATS_LEVELS][SCANSTATS_BLOCKS];	/*! Maximum über 2^k Blöcke ab dem Block */
+} scanstats_t;
+
+/**
+* Bildet die Tabellen eines Scans.
+* \param[out] stats Die Tabellen
+* \param[in] ranger Der Laser-Ranger
+*/
+void scanstats_build(scanstats_t *stats, const playerc_ranger_t *ranger);
+
+/**
+* Liefert die Distanz des Strahles zu einem Winkel.
+* \param[in] stats Die Tabellen
+* \param[in] angle Der Winkel in Grad
+* \return Die Distanz in Metern, 0 ohne gültige Strahlen
+*/
+double scanstats_range(const scanstats_t *stats, const double angle);
+
+/**
+* Mittelt die Distanzen im Bereich zweier Winkel; die Reihenfolge der
+* Winkel ist beliebig, beide Randstrahlen zählen mit.
+* \param[in] stats Die Tabellen
+* \param[in] start_angle Der Startwinkel in Grad
+* \param[in] end_angle Der Endwinkel in Grad
+* \return Die mittlere Distanz in Metern, 0 ohne gültige Strahlen
+*/
+double scanstats_mean(const scanstats_t *stats, const double start_angle, const double end_angle);
+
+/**
+* Liefert die kleinste Distanz im Bereich zweier Winkel.
+* \param[in] stats Die Tabellen
+* \param[in] start_angle Der Startwinkel in Grad
+* \param[in] end_angle Der Endwinkel in Grad
+* \return Die kleinste Distanz in Metern, 0 ohne gültige Strahlen
+*/
+double scanstats_min(const scanstats_t *stats, const double start_angle, const double end_angle);
+
+/**
+* Liefert die größte Distanz im Bereich zweier Winkel.
+* \param[in] stats Die Tabellen
+* \param[in] start_angle Der Startwinkel in Grad
+* \param[in] end_angle Der Endwinkel in Grad
+* \return Die größte Distanz in Metern, 0 ohne gültige Strahlen
+*/
+double scanstats_max(const scanstats_t *stats, const double start_angle, const double end_angle);
+
+#endif
@@ -12,11 +12,16 @@
 #include <wait.h>
 #include <errno.h>
 #include <math.h>
+#include <pthread.h>
 #include <libplayerc/playerc.h>
 
 #include "map.h"
+#include "pipeline.h"
+#include "scanlog.h"
+#include "metrics.h"
 #include "laser.h"
 #include "transforms.h"
+#include "scanstats.h"
 
 /**
 * Setzt den canonical mode des Terminals (warten auf RETURN)
@@ -73,182 +78,569 @@ int isKeyPressed()
 }
 
 /**
-* Mittelt die Sensormesswerte im Bereich zweier Winkel
-* \param[in] ranger Der Laser-Ranger
-* \param[in] start_angle Der Startwinkel in Grad
-* \param[in] end_angle Der Endwinkel in Grad
-* \param[out] sum (Optional) Die ungemittelte Summe der Messwerte; Kann NULL sein.
+* Länge der Warteschlangen zwischen den Stufen
 */
-double average_ranges(const playerc_ranger_t *const ranger, double start_angle, double end_angle, double *sum)
+#define PIPELINE_QUEUE_LENGTH 4
+
+/**
+* Wartezeit eines Verbrauchers ohne neue Einträge in Mikrosekunden
+*/
+#define PIPELINE_IDLE_US 1000
+
+/**
+* Maximale Wartezeit auf neue Sensordaten in Millisekunden
+*/
+#define PIPELINE_PEEK_MS 5
+
+/**
+* Intervall der Latenzausgabe bei --metrics in Sekunden
+*/
+#define METRICS_SUMMARY_INTERVAL 10
+
+/**
+* Maximale Anzahl der Roboter; jeder wird über einen eigenen Port angesprochen
+*/
+#define ROBOTS_MAX MAP_MAX_ROBOTS
+
+/**
+* Player-Port des ersten Roboters; weitere folgen fortlaufend (\see pstlab.cfg)
+*/
+#define ROBOTS_FIRST_PORT 6665
+
+/**
+* Abfrageintervall der Tastatur im Hauptthread in Mikrosekunden
+*/
+#define KEY_POLL_US 20000
+
+/**
+* Intervall, in dem die Karte bei --map abgelegt wird, in Sekunden
+*/
+#define MAP_SAVE_INTERVAL 30
+
+/**
+* Verbindung und Verarbeitungskette eines Roboters. Jeder Roboter besitzt
+* eigene Threads für Player-Client, Kartierung und Regelung; gemeinsam ist
+* ihnen lediglich die Karte.
+*/
+typedef struct {
+	int index;							/*! Index des Roboters in der Karte */
+	playerc_client_t *client;			/*! Verbindung zum Player-Server */
+	playerc_position2d_t *position2d;	/*! Fahrwerk */
+	playerc_ranger_t *ranger;			/*! Laser-Sensor */
+	spscqueue_t scansToMap;				/*! Erfassung -> Kartierung */
+	spscqueue_t scansToControl;			/*! Erfassung -> Regelung */
+	spscqueue_t mapToControl;			/*! Kartierung -> Regelung */
+	spscqueue_t commandsToDrive;		/*! Regelung -> Erfassung (Player-Client) */
+	sensorframe_t clientFrame;			/*! Puffer der Erfassung */
+	sensorframe_t mapFrame;				/*! Puffer der Kartierung */
+	sensorframe_t controlFrame;			/*! Puffer der Regelung */
+	scanstats_t controlStats;			/*! Sektorstatistik der Regelung */
+	pthread_t clientThread;
+	pthread_t mappingThread;
+	pthread_t controlThread;
+	int completeShown;					/*! Nicht-null, wenn die Vollständigkeit gemeldet wurde */
+	int failed;							/*! Nicht-null, wenn ein Fahrbefehl nicht übermittelt werden konnte */
+} robot_t;
+
+static robot_t robots[ROBOTS_MAX];
+static int robotCount = 1;
+static volatile int running = 1;
+
+/* Aufzeichnung der Messungen von Roboter 0 */
+static scanlog_writer_t recorder;
+static int recording = 0;
+
+/**
+* Berechnet den Fahrbefehl aus einer Messung und dem letzten Stand der Kartierung.
+* \param[in] stats Die Sektorstatistik der Messung
+* \param[in] pos Die Roboterpose im global Frame
+* \param[in] state Der letzte Stand der Kartierung
+* \param[out] outV Die Bahngeschwindigkeit in m/s
+* \param[out] outW Die Winkelgeschwindigkeit in rad/s (positiv im Uhrzeigersinn)
+*/
+void drive_control(const scanstats_t *stats, const playerc_position2d_t *pos, const mapstate_t *state, double *outV, double *outW)
 {
-	if (start_angle > end_angle)
+	/* Bahngeschwindigkeit ermitteln */
+	double front_exact = scanstats_range(stats, 0);
+	double front      = scanstats_mean(stats, -22.5, 22.5);
+	double front_wide = scanstats_mean(stats, -45.0, 45.0);
+	double v = LERP(LASER_RANGE_MIN*2, LASER_RANGE_MAX*3/4, front_wide, 0, 0.4);
+	
+	/* Bouncer rechts */
+	double right_front_exact = scanstats_range(stats, 50);
+	double right_front = scanstats_mean(stats, 22.5, 67.5);
+	double right       = scanstats_mean(stats, 67.5, 112.5);
+
+	/* Bouncer links */
+	double left_front_exact = scanstats_range(stats, -50);
+	double left_front  = scanstats_mean(stats, -22.5, -67.5);
+
+	double w = 0;
+
+	/* Wenn Gefahr vorne rechts, drift links */
+	w -= LERP(LASER_RANGE_MIN, LASER_RANGE_MAX, right_front, 0, 1);
+	w -= LERP_SATURATE(LASER_RANGE_MIN, 1, right_front_exact, 0, 1);
+
+	/* Wenn Gefahr vorne links, drift rechts */
+	w += LERP(LASER_RANGE_MIN, LASER_RANGE_MAX, left_front, 0, 1);
+	w += LERP_SATURATE(LASER_RANGE_MIN, 1, left_front_exact, 0, 1);
+
+	/* Wenn rechts frei - fahre rechts.
+	*  Ein sehr freies Feld sorgt für starken Rechtsdrall.
+    			*/
+	w += LERP(LASER_RANGE_MIN, 2, right, 0, 0.4);
+
+	/* Tendenz zum Linksabbiegen hinzufügen 
+	*  Gewichten mit dem Bestreben, rechts abzubiegen, wenn dort frei ist.
+	*  Hierdurch gewinnt das Rechtsabbiegen.
+	*/
+	w -= LERP_SATURATE(LASER_RANGE_MIN, 1, front, 0.5, 0) * LERP(LASER_RANGE_MIN, 2, right, 0, 0.4);
+
+	/* Hindernis exakt voraus vermeiden durch Linksabbiegen. 
+	*  Grad des Unterschreitens der "Fluchtdistanz" bestimmt Stärke.
+	*/
+	w -= LERP_SATURATE(LASER_RANGE_MIN, 1, front_exact, 0.5, 0);
+	
+	/* Linksabbiegen vermeiden, wenn kein Hindernis.
+	*  Dieser Term korrigiert die vorherige Interpolation für Messwerte
+	*  die hinter die "Fluchtdistanz" liegen.
+	*/
+	w += LERP_SATURATE(1, 1+LASER_RANGE_MIN, front_exact, 0, 0.5);
+
+	/* Dem geplanten Pfad zur gewählten Grenze folgen.
+	*  Der Term wird mit dem freien Raum voraus gewichtet, so dass
+	*  die Hindernisvermeidung in der Nähe von Wänden Vorrang hat.
+	*/
+	if (state->hasWaypoint)
 	{
-		double temp = end_angle;
-		end_angle = start_angle;
-		start_angle = temp;
+		double heading_error = atan2(state->waypointY - pos->py, state->waypointX - pos->px) - pos->pa;
+		heading_error = atan2(sin(heading_error), cos(heading_error));
+		w -= LERP_SATURATE(LASER_RANGE_MIN, 1, front, 0, 0.8) * heading_error;
 	}
 
-	int start_index = LASER_RANGEINDEX_FROM_ANGLE_DEG(start_angle);
-	int end_index   = LASER_RANGEINDEX_FROM_ANGLE_DEG(end_angle);
-	double count = end_index - start_index + 1.0;
-	double s = 0;
-	for (int i=start_index; i <= end_index; ++i)
+	/* Pose und Zustände ausgeben */
+#if 0
+	printf("x=%7.5f, y=%7.5f, theta=%7.5f°, v=%7.5fm/s, omega=%7.5frad/s\n", 
+		pos->px, pos->py, pos->pa*180/M_PI, v, w);
+#endif
+
+	*outV = v;
+	*outW = w;
+}
+
+/**
+* Kartierungsstufe. Trägt jeweils die jüngste Messung in die Karte ein und
+* reicht Vollständigkeit und Wegpunkt an die Regelung weiter. Messungen, die
+* während einer Kartierung eintreffen, werden bis auf die jüngste übersprungen.
+* \param[in] arg Der Roboter (robot_t)
+*/
+static void* mapping_stage(void *arg)
+{
+	robot_t *robot = (robot_t*)arg;
+	sensorframe_t *frame = &robot->mapFrame;
+	while (running)
 	{
-		s += ranger->ranges[i];
-	}	
+		if (!spsc_pop_latest(&robot->scansToMap, frame))
+		{
+			usleep(PIPELINE_IDLE_US);
+			continue;
+		}
 
-	if (sum != 0)
-		*sum = s;
+		playerc_ranger_t ranger;
+		playerc_position2d_t pos;
+		sensorframe_view(frame, &ranger, &pos);
+
+		mapstate_t state;
+		state.sequence = frame->sequence;
+		const uint64_t started = metrics_now();
+		state.complete = map_draw(robot->index, &ranger, &pos);
+		metrics_since(METRICS_MAPPING, started);
+		state.hasWaypoint = map_waypoint(robot->index, &state.waypointX, &state.waypointY);
+		spsc_push(&robot->mapToControl, &state);
+	}
+	return NULL;
+}
 
-	return s/count;
+/**
+* Regelungsstufe. Berechnet zu jeder Messung einen Fahrbefehl auf Basis des
+* letzten verfügbaren Kartierungsstandes, ohne auf die Kartierung zu warten.
+* \param[in] arg Der Roboter (robot_t)
+*/
+static void* control_stage(void *arg)
+{
+	robot_t *robot = (robot_t*)arg;
+	sensorframe_t *frame = &robot->controlFrame;
+	mapstate_t state;
+	memset(&state, 0, sizeof(state));
+
+	while (running)
+	{
+		/* Letzten Stand der Kartierung behalten, bis ein neuerer vorliegt */
+		spsc_pop_latest(&robot->mapToControl, &state);
+
+		if (!spsc_pop_latest(&robot->scansToControl, frame))
+		{
+			usleep(PIPELINE_IDLE_US);
+			continue;
+		}
+
+		drivecommand_t command;
+		command.sequence = frame->sequence;
+		command.received = frame->received;
+		command.complete = state.complete;
+		command.v = command.w = 0;
+		if (!state.complete && frame->count > 0)
+		{
+			playerc_ranger_t ranger;
+			playerc_position2d_t pos;
+			sensorframe_view(frame, &ranger, &pos);
+			const uint64_t started = metrics_now();
+			map_correct(robot->index, &pos);
+			scanstats_build(&robot->controlStats, &ranger);
+			drive_control(&robot->controlStats, &pos, &state, &command.v, &command.w);
+			metrics_since(METRICS_CONTROL, started);
+		}
+		spsc_push(&robot->commandsToDrive, &command);
+	}
+	return NULL;
 }
 
-int main(int argc, char *argv[])
+/**
+* Erfassungsstufe. Liest den Player-Client des Roboters, verteilt die
+* Messungen an Kartierung und Regelung und übermittelt die Fahrbefehle.
+* \param[in] arg Der Roboter (robot_t)
+*/
+static void* client_stage(void *arg)
 {
-	playerc_client_t *client;
-	playerc_position2d_t *position2d;
-	playerc_ranger_t *ranger;
-	static int mapCreatedShown = 0;
+	robot_t *robot = (robot_t*)arg;
+	sensorframe_t *frame = &robot->clientFrame;
+	uint32_t sequence = 0;
 
-	if (argc<2)
+	while (running)
 	{
-		printf("Usage: %s <hostname>\n",basename(argv[0]));
-		return 1;
+		/* Kurz auf neue Daten warten, damit Fahrbefehle auch zwischen zwei
+		 * Messungen zeitnah weitergegeben werden */
+		if (playerc_client_peek(robot->client, PIPELINE_PEEK_MS) > 0)
+		{
+			const uint64_t received = metrics_now();
+			playerc_client_read(robot->client);
+			metrics_since(METRICS_READ, received);
+
+			/* Messung als Wert an Kartierung und Regelung weiterreichen;
+			 * ist eine Stufe im Rückstand, wird nicht gewartet */
+			sensorframe_capture(robot->ranger, robot->position2d, ++sequence, frame);
+			frame->received = received;
+			spsc_push(&robot->scansToMap, frame);
+			spsc_push(&robot->scansToControl, frame);
+
+			if (robot->index == 0 && recording && scanlog_append(&recorder, frame))
+			{
+				printf("Aufzeichnung abgebrochen: Schreibfehler.\n");
+				scanlog_finish(&recorder);
+				recording = 0;
+			}
+		}
+
+		/* Jüngsten Fahrbefehl übernehmen */
+		drivecommand_t command;
+		if (!spsc_pop_latest(&robot->commandsToDrive, &command))
+			continue;
+
+		if (command.complete) 
+		{
+			if (!robot->completeShown)
+			{
+				robot->completeShown = 1;
+				if (robotCount > 1)
+					printf("[%d] Karte vollständig erstellt. Tastendruck zum Beenden.\n", robot->index);
+				else
+					printf("Karte vollständig erstellt. Tastendruck zum Beenden.\n");
+
+				if (0 != playerc_position2d_set_cmd_vel(robot->position2d, 0, 0.0, 0, 1))
+					break;
+			}
+
+			continue;
+		}
+
+		const uint64_t started = metrics_now();
+		if (0 != playerc_position2d_set_cmd_vel(robot->position2d, command.v, 0.0, -command.w, 1))
+			break;
+		metrics_since(METRICS_COMMAND, started);
+		metrics_since(METRICS_CYCLE, command.received);
 	}
 
-	/* Canonical Mode für Tastenüberwachung */
-	atexit(restoreCanonicalMode);
-	setCanonicalMode(0);
+	/* Ein fehlgeschlagener Fahrbefehl beendet das Programm */
+	if (running)
+	{
+		robot->failed = 1;
+		running = 0;
+	}
+	return NULL;
+}
 
+/**
+* Verbindet einen Roboter mit dem Player-Server und abonniert seine Geräte.
+* \param[inout] robot Der Roboter
+* \param[in] host Der Hostname des Player-Servers
+* \param[in] port Der Port des Roboters
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+static int robot_connect(robot_t *robot, const char *host, const int port)
+{
 	/* Create a client and connect it to the server. */
-	client = playerc_client_create(NULL, argv[1], 6665);
-	if (0 != playerc_client_connect(client)) {
-		return -1;
+	robot->client = playerc_client_create(NULL, host, port);
+	if (0 != playerc_client_connect(robot->client)) {
+		return 1;
 	}
 
 	/* Create and subscribe to a position2d device. */
-	position2d = playerc_position2d_create(client, 0);
-	if (playerc_position2d_subscribe(position2d, PLAYER_OPEN_MODE)) {
-		return -1;
+	robot->position2d = playerc_position2d_create(robot->client, 0);
+	if (playerc_position2d_subscribe(robot->position2d, PLAYER_OPEN_MODE)) {
+		return 1;
 	}
-	playerc_position2d_enable(position2d,1);
+	playerc_position2d_enable(robot->position2d,1);
 
 	/* Laser-Sensor-Modell */
-	ranger = playerc_ranger_create(client, 0);
-	if (playerc_ranger_subscribe(ranger, PLAYER_OPEN_MODE) != 0) { 
+	robot->ranger = playerc_ranger_create(robot->client, 0);
+	if (playerc_ranger_subscribe(robot->ranger, PLAYER_OPEN_MODE) != 0) { 
 		printf("ranger error!\n");
-		exit(1);
+		return 1;
 	}
 
-	/* Raum abfahren */
-	printf("Tastendruck zum Beenden.\n");
-	while(!isKeyPressed()) {
+	/* Verarbeitungskette anlegen */
+	if (spsc_create(&robot->scansToMap, sizeof(sensorframe_t), PIPELINE_QUEUE_LENGTH)
+	 || spsc_create(&robot->scansToControl, sizeof(sensorframe_t), PIPELINE_QUEUE_LENGTH)
+	 || spsc_create(&robot->mapToControl, sizeof(mapstate_t), PIPELINE_QUEUE_LENGTH)
+	 || spsc_create(&robot->commandsToDrive, sizeof(drivecommand_t), PIPELINE_QUEUE_LENGTH))
+	{
+		printf("pipeline error!\n");
+		return 1;
+	}
+	return 0;
+}
+
+/**
+* Trennt einen Roboter vom Player-Server und gibt seine Ressourcen frei.
+* \param[inout] robot Der Roboter
+*/
+static void robot_disconnect(robot_t *robot)
+{
+	playerc_position2d_unsubscribe(robot->position2d);
+	playerc_position2d_destroy(robot->position2d);
+
+	playerc_ranger_unsubscribe(robot->ranger);
+	playerc_ranger_destroy(robot->ranger);
+
+	playerc_client_disconnect(robot->client);
+	playerc_client_destroy(robot->client);
 
-		// Wait for new data from server
-		playerc_client_read(client);
+	spsc_destroy(&robot->scansToMap);
+	spsc_destroy(&robot->scansToControl);
+	spsc_destroy(&robot->mapToControl);
+	spsc_destroy(&robot->commandsToDrive);
+}
 
-		/* Karte zeichnen */
-		int mapComplete = map_draw(ranger, position2d);
-		if (mapComplete) 
+int main(int argc, char *argv[])
+{
+	/* Optional ohne Anzeige betreiben; ohne X11-Display ohnehin */
+	int headless = (getenv("DISPLAY") == NULL);
+	const char *recordPath = NULL;
+	const char *metricsPath = NULL;
+	const char *mapPath = NULL;
+	const char *publishName = NULL;
+	int scanmatching = 0;
+	uint32_t recordFlags = 0;
+	const char *program = basename(argv[0]);
+	while (argc > 1 && strncmp(argv[1], "--", 2) == 0)
+	{
+		if (strcmp(argv[1], "--headless") == 0)
 		{
-			if (!mapCreatedShown)
-			{
-				mapCreatedShown = 1;
-				printf("Karte vollständig erstellt. Tastendruck zum Beenden.\n");
+			headless = 1;
+		}
+		else if (strcmp(argv[1], "--record") == 0 && argc > 2)
+		{
+			recordPath = argv[2];
+			--argc;
+			++argv;
+		}
+		else if (strcmp(argv[1], "--metrics") == 0 && argc > 2)
+		{
+			metricsPath = argv[2];
+			--argc;
+			++argv;
+		}
+		else if (strcmp(argv[1], "--map") == 0 && argc > 2)
+		{
+			mapPath = argv[2];
+			--argc;
+			++argv;
+		}
+		else if (strcmp(argv[1], "--match") == 0)
+		{
+			scanmatching = 1;
+		}
+		else if (strcmp(argv[1], "--publish") == 0 && argc > 2)
+		{
+			publishName = argv[2];
+			--argc;
+			++argv;
+		}
+		else if (strcmp(argv[1], "--robots") == 0 && argc > 2)
+		{
+			robotCount = atoi(argv[2]);
+			--argc;
+			++argv;
+		}
+		else if (strcmp(argv[1], "--delta") == 0)
+		{
+			recordFlags |= SCANLOG_DELTA;
+		}
+		else
+		{
+			break;
+		}
+		--argc;
+		++argv;
+	}
 
-				if (0 != playerc_position2d_set_cmd_vel(position2d, 0, 0.0, 0, 1))
-					return -1;
-			}
+	if (argc<2 || robotCount < 1 || robotCount > ROBOTS_MAX)
+	{
+		printf("Usage: %s [--headless] [--robots <1-%d>] [--record <logfile> [--delta]] [--metrics <socket>] [--map <mapfile>] [--publish <shmname>] [--match] <hostname>\n",program,ROBOTS_MAX);
+		return 1;
+	}
+	map_set_headless(headless);
+	map_set_publish(publishName);
+	map_set_scanmatch(scanmatching);
 
-			continue;
+	/* Messungen optional zur späteren Wiedergabe aufzeichnen */
+	if (recordPath != NULL)
+	{
+		if (scanlog_create(&recorder, recordPath, recordFlags))
+		{
+			printf("Aufzeichnung %s kann nicht angelegt werden.\n", recordPath);
+			return 1;
 		}
+		recording = 1;
+	}
 
-		/* Fahrlogik */
-		if (ranger->ranges_count > 0)
+	/* Latenzen optional über einen Unix-Socket bereitstellen und regelmäßig ausgeben */
+	if (metricsPath != NULL && metrics_start(metricsPath, METRICS_SUMMARY_INTERVAL))
+	{
+		printf("Metrik-Socket %s kann nicht angelegt werden.\n", metricsPath);
+		return 1;
+	}
+
+	/* Canonical Mode für Tastenüberwachung */
+	atexit(restoreCanonicalMode);
+	setCanonicalMode(0);
+
+	/* Roboter verbinden; jeder Roboter hat seinen eigenen Port */
+	for (int i = 0; i < robotCount; ++i)
+	{
+		robots[i].index = i;
+		if (robot_connect(&robots[i], argv[1], ROBOTS_FIRST_PORT + i))
 		{
-			/* Summe aller Entfernungen */
-			double sum = 0;
-			for (int i=0; i < ranger->ranges_count; ++i)
-			{
-				sum += ranger->ranges[i];
-			}	
-
-			/* Bahngeschwindigkeit ermitteln */
-			double front_exact = ranger->ranges[LASER_RANGEINDEX_FROM_ANGLE_DEG(0)];
-			double front      = average_ranges(ranger, -22.5, 22.5, NULL);
-			double front_wide = average_ranges(ranger, -45.0, 45.0, NULL); 
-			double v = LERP(LASER_RANGE_MIN*2, LASER_RANGE_MAX*3/4, front_wide, 0, 0.4);
-			
-			/* Bouncer rechts */
-			double right_front_exact = ranger->ranges[LASER_RANGEINDEX_FROM_ANGLE_DEG(50)];
-			double right_front = average_ranges(ranger, 22.5, 67.5, NULL); 
-			double right       = average_ranges(ranger, 67.5, 112.5, NULL); 
-			double right_back  = average_ranges(ranger, 112.5, LASER_MAX_ANGLE_DEG, NULL); 
-
-			/* Bouncer links */
-			double left_front_exact = ranger->ranges[LASER_RANGEINDEX_FROM_ANGLE_DEG(-50)];
-			double left_front  = average_ranges(ranger, -22.5, -67.5, NULL); 
-			double left        = average_ranges(ranger, -67.5, -112.5, NULL); 
-			double left_back   = average_ranges(ranger, -112.5, LASER_MIN_ANGLE_DEG, NULL); 
-
-			double w = 0;
-
-			/* Wenn Gefahr vorne rechts, drift links */
-			w -= LERP(LASER_RANGE_MIN, LASER_RANGE_MAX, right_front, 0, 1);
-			w -= LERP_SATURATE(LASER_RANGE_MIN, 1, right_front_exact, 0, 1);
-
-			/* Wenn Gefahr vorne links, drift rechts */
-			w += LERP(LASER_RANGE_MIN, LASER_RANGE_MAX, left_front, 0, 1);
-			w += LERP_SATURATE(LASER_RANGE_MIN, 1, left_front_exact, 0, 1);
-
-			/* Wenn rechts frei - fahre rechts.
-			*  Ein sehr freies Feld sorgt für starken Rechtsdrall.
-    			*/
-			w += LERP(LASER_RANGE_MIN, 2, right, 0, 0.4);
-
-			/* Tendenz zum Linksabbiegen hinzufügen 
-			*  Gewichten mit dem Bestreben, rechts abzubiegen, wenn dort frei ist.
-			*  Hierdurch gewinnt das Rechtsabbiegen.
-			*/
-			w -= LERP_SATURATE(LASER_RANGE_MIN, 1, front, 0.5, 0) * LERP(LASER_RANGE_MIN, 2, right, 0, 0.4);
-
-			/* Hindernis exakt voraus vermeiden durch Linksabbiegen. 
-			*  Grad des Unterschreitens der "Fluchtdistanz" bestimmt Stärke.
-			*/
-			w -= LERP_SATURATE(LASER_RANGE_MIN, 1, front_exact, 0.5, 0);
-			
-			/* Linksabbiegen vermeiden, wenn kein Hindernis.
-			*  Dieser Term korrigiert die vorherige Interpolation für Messwerte
-			*  die hinter die "Fluchtdistanz" liegen.
-			*/
-			w += LERP_SATURATE(1, 1+LASER_RANGE_MIN, front_exact, 0, 0.5);
-
-			/* Pose und Zustände ausgeben */
-#if 0
-			printf("x=%7.5f, y=%7.5f, theta=%7.5f°, v=%7.5fm/s, omega=%7.5frad/s\n", 
-				position2d->px, position2d->py, position2d->pa*180/M_PI, v, w);
-#endif
+			return -1;
+		}
+	}
 
-			if (0 != playerc_position2d_set_cmd_vel(position2d, v, 0.0, -w, 1))
-				return -1;
+	/* Die Karte wird vor den Threads angelegt, die parallel in sie eintragen */
+	if (map_init())
+	{
+		printf("map error!\n");
+		exit(1);
+	}
+
+	/* Vorhandene Ablage laden und die Erkundung dort fortsetzen */
+	if (mapPath != NULL && access(mapPath, F_OK) == 0)
+	{
+		if (map_load(mapPath))
+		{
+			printf("Karte %s kann nicht geladen werden.\n", mapPath);
+			exit(1);
+		}
+		printf("Karte %s geladen.\n", mapPath);
+
+		double x, y, a;
+		for (int i = 0; i < robotCount; ++i)
+		{
+			if (map_pose(i, &x, &y, &a))
+				printf("Roboter %d zuletzt bei x=%.2f, y=%.2f, a=%.2f\n", i, x, y, a);
+		}
+	}
+
+	/* Verarbeitungsketten starten */
+	for (int i = 0; i < robotCount; ++i)
+	{
+		robot_t *robot = &robots[i];
+		if (pthread_create(&robot->mappingThread, NULL, mapping_stage, robot) != 0
+		 || pthread_create(&robot->controlThread, NULL, control_stage, robot) != 0
+		 || pthread_create(&robot->clientThread, NULL, client_stage, robot) != 0)
+		{
+			printf("thread error!\n");
+			exit(1);
 		}
 	}
 
+	/* Raum abfahren */
+	printf("Tastendruck zum Beenden.\n");
+	int keyPressed = 0;
+	double lastSave = metrics_now() * 1e-9;
+	while (running && !(keyPressed = isKeyPressed()))
+	{
+		usleep(KEY_POLL_US);
+
+		/* Karte regelmäßig ablegen, damit ein abgebrochener Lauf fortgesetzt werden kann */
+		const double now = metrics_now() * 1e-9;
+		if (mapPath != NULL && now - lastSave >= MAP_SAVE_INTERVAL)
+		{
+			if (map_save(mapPath)) printf("Karte %s kann nicht abgelegt werden.\n", mapPath);
+			lastSave = now;
+		}
+	}
+
+	/* Stufen anhalten */
+	running = 0;
+	int failed = 0;
+	for (int i = 0; i < robotCount; ++i)
+	{
+		pthread_join(robots[i].clientThread, NULL);
+		pthread_join(robots[i].controlThread, NULL);
+		pthread_join(robots[i].mappingThread, NULL);
+		failed |= robots[i].failed;
+	}
+	if (failed)
+	{
+		return -1;
+	}
+
 	/* Gedrückte Taste schlucken */
-	fgetc(stdin);
+	if (keyPressed) fgetc(stdin);
 	printf("Räume auf.\n");
 
 	/* Shutdown */
-	playerc_position2d_unsubscribe(position2d);
-	playerc_position2d_destroy(position2d);
+	for (int i = 0; i < robotCount; ++i)
+	{
+		robot_disconnect(&robots[i]);
+	}
 
-	playerc_ranger_unsubscribe(ranger);
-	playerc_ranger_destroy(ranger);
+	if (mapPath != NULL && map_save(mapPath))
+	{
+		printf("Karte %s kann nicht abgelegt werden.\n", mapPath);
+	}
+	map_shutdown();
 
-	playerc_client_disconnect(client);
-	playerc_client_destroy(client);
+	/* Latenzen des gesamten Laufes ausgeben */
+	metrics_stop();
+	static char summary[2048];
+	metrics_format(summary, sizeof(summary));
+	fputs(summary, stdout);
 
-	map_shutdown();
+	if (recording)
+	{
+		scanlog_finish(&recorder);
+	}
 
 	return 0;
 }
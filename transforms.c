@@ -1,6 +1,36 @@
 #include "laser.h"
 #include "math.h"
+#include "map.h"
 #include "transforms.h"
+#include "pthread.h"
+
+/**
+* Tabellierter Kosinus der Strahlwinkel
+*/
+static double beamCos[LASER_SAMPLES];
+
+/**
+* Tabellierter Sinus der Strahlwinkel
+*/
+static double beamSin[LASER_SAMPLES];
+
+/**
+* Einmalige Initialisierung der Tabellen; mehrere Roboter transformieren parallel
+*/
+static pthread_once_t beamTablesOnce = PTHREAD_ONCE_INIT;
+
+/**
+* Initialisiert die Tabellen der Strahlwinkel
+*/
+static void initBeamTables()
+{
+	for (int a = 0; a < LASER_SAMPLES; ++a)
+	{
+		const double angle = a * LASER_ANGULAR_RESOLUTION_RAD + LASER_MIN_ANGLE_RAD;
+		beamCos[a] = cos(angle);
+		beamSin[a] = sin(angle);
+	}
+}
 
 /**
 * Transformation von lokalen Koordinaten in Kartenkoordinaten
@@ -45,3 +75,48 @@ int transformLaserToMap(const double angle, const double radius, const playerc_p
 
 	return 1;
 }
+
+/**
+* Transformation eines vollständigen Laserscans in Karten- und Gitterkoordinaten
+* \param[in] ranger Der Laser-Ranger
+* \param[in] pos	Die Roboterpose im global Frame
+* \param[out] scan	Der transformierte Scan
+*/
+void transformScanToMap(const playerc_ranger_t *const ranger, const playerc_position2d_t *const pos, laserscan_t *scan)
+{
+	pthread_once(&beamTablesOnce, initBeamTables);
+
+	const uint32_t count = (ranger->ranges_count < LASER_SAMPLES) ? ranger->ranges_count : LASER_SAMPLES;
+	const double *const ranges = ranger->ranges;
+
+	/* Rotation der Pose einmalig bestimmen */
+	const double px = pos->px;
+	const double py = pos->py;
+	const double sint = sin(pos->pa);
+	const double cost = cos(pos->pa);
+
+	/* Strahlrichtungen rotieren und Endpunkte bilden */
+	double *const x = scan->x;
+	double *const y = scan->y;
+	for (uint32_t a = 0; a < count; ++a)
+	{
+		const double r  = ranges[a];
+		const double dx = cost*beamCos[a] - sint*beamSin[a];
+		const double dy = sint*beamCos[a] + cost*beamSin[a];
+		x[a] = px + r*dx;
+		y[a] = py + r*dy;
+	}
+
+	/* Gitterkoordinaten und Treffer */
+	int *const cellx = scan->cellx;
+	int *const celly = scan->celly;
+	uint8_t *const hit = scan->hit;
+	for (uint32_t a = 0; a < count; ++a)
+	{
+		cellx[a] = MAP_OFFS_X+(int)(MAP_SCALE*x[a]);
+		celly[a] = MAP_OFFS_Y-(int)(MAP_SCALE*y[a]);
+		hit[a]   = ranges[a] < LASER_RANGE_MAX - LASER_RANGE_EPSILON;
+	}
+
+	scan->count = count;
+}
@@ -1,8 +1,11 @@
 #ifndef TRANSFORMS_H
 #define TRANSFORMS_H
 
+#include <stdint.h>
 #include <libplayerc/playerc.h>
 
+#include "laser.h"
+
 /**
 * Lineare Interpolation von einer gegebenen Domain in einen neuen Wertebereich
 * \param[in] domainMin Minimaler Wert von x
@@ -46,4 +49,33 @@ void transformLocalToMap(double x, double y, const playerc_position2d_t *const p
 */
 int transformLaserToMap(double angle, double radius, const playerc_position2d_t *const pos, double *mapx, double *mapy);
 
+/**
+* In Karten- und Gitterkoordinaten transformierter Laserscan.
+*
+* Die Felder sind als structure of arrays abgelegt, damit die Transformation
+* vom Compiler vektorisiert werden kann.
+*/
+typedef struct {
+	uint32_t count;					/*! Anzahl der gültigen Strahlen */
+	double x[LASER_SAMPLES];		/*! X-Koordinate des Endpunktes in Kartenkoordinaten */
+	double y[LASER_SAMPLES];		/*! Y-Koordinate des Endpunktes in Kartenkoordinaten */
+	int cellx[LASER_SAMPLES];		/*! X-Koordinate des Endpunktes in Gitterkoordinaten */
+	int celly[LASER_SAMPLES];		/*! Y-Koordinate des Endpunktes in Gitterkoordinaten */
+	uint8_t hit[LASER_SAMPLES];		/*! Nicht-null, wenn der Strahl innerhalb der Reichweite endet */
+} laserscan_t;
+
+/**
+* Transformation eines vollständigen Laserscans in Karten- und Gitterkoordinaten
+*
+* Sinus und Kosinus der Strahlwinkel werden einmalig tabelliert und pro Pose
+* nur noch rotiert, so dass je Strahl keine trigonometrischen Funktionen mehr
+* ausgewertet werden müssen. Anders als {\see transformLaserToMap} werden auch
+* Messungen auf maximaler Reichweite transformiert; diese sind über
+* {\see laserscan_t::hit} erkennbar.
+* \param[in] ranger Der Laser-Ranger
+* \param[in] pos	Die Roboterpose im global Frame
+* \param[out] scan	Der transformierte Scan
+*/
+void transformScanToMap(const playerc_ranger_t *const ranger, const playerc_position2d_t *const pos, laserscan_t *scan);
+
 #endif
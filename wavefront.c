@@ -0,0 +1,203 @@
+/**
+* Wellenfront-Distanzfeld über den begehbaren Zellen der Karte.
+*
+* Die Distanzen werden zusammen mit einer Generationsnummer je Zelle abgelegt;
+* eine Zelle, deren Generation nicht der aktuellen entspricht, gilt als nicht
+* erreicht. Das Feld muss daher vor einer Ausbreitung nicht gelöscht werden.
+*/
+
+#include "map.h"
+#include "wavefront.h"
+#include "stdlib.h"
+#include "string.h"
+
+/**
+* Distanzfeld der letzten Ausbreitung
+*/
+typedef struct {
+	uint32_t *distance;		/*! Distanz je Zelle, zeilenweise */
+	uint16_t *stamps;		/*! Generation je Zelle */
+	int32_t *queue;			/*! Warteschlange der Breitensuche (Zellindizes) */
+	uint16_t epoch;			/*! Aktuelle Generation */
+	uint32_t radius;		/*! Untere Schranke der Distanz nicht erreichter Zellen */
+	int originX;			/*! X-Koordinate der ersten abgedeckten Zelle */
+	int originY;			/*! Y-Koordinate der ersten abgedeckten Zelle */
+	int width;				/*! Breite des abgedeckten Bereiches in Zellen */
+	int height;				/*! Höhe des abgedeckten Bereiches in Zellen */
+} wavefront_t;
+
+static wavefront_t field = { (uint32_t*)0, (uint16_t*)0, (int32_t*)0, 0, 0, 0, 0, 0, 0 };
+
+/**
+* Passt das Distanzfeld an die aktuelle Ausdehnung des Gitters an.
+* \return 0 wenn erfolgreich, ansonsten nicht-null
+*/
+static int fitFieldToGrid()
+{
+	if (field.distance != (uint32_t*)0
+	 && field.originX == searchgrid.originX && field.originY == searchgrid.originY
+	 && field.width == searchgrid.width && field.height == searchgrid.height)
+	{
+		return 0;
+	}
+
+	wavefront_shutdown();
+	const size_t cells = (size_t)searchgrid.width*searchgrid.height;
+	field.distance = (uint32_t*)malloc(cells*sizeof(uint32_t));
+	field.stamps   = (uint16_t*)calloc(cells, sizeof(uint16_t));
+	field.queue    = (int32_t*)malloc(cells*sizeof(int32_t));
+	field.epoch    = 0;
+	field.originX  = searchgrid.originX;
+	field.originY  = searchgrid.originY;
+	field.width    = searchgrid.width;
+	field.height   = searchgrid.height;
+	return field.distance == (uint32_t*)0 || field.stamps == (uint16_t*)0 || field.queue == (int32_t*)0;
+}
+
+/**
+* Gibt die Ressourcen des Distanzfeldes frei.
+*/
+void wavefront_shutdown(void)
+{
+	free(field.distance);
+	free(field.stamps);
+	free(field.queue);
+	field.distance = (uint32_t*)0;
+	field.stamps   = (uint16_t*)0;
+	field.queue    = (int32_t*)0;
+	field.width = field.height = 0;
+}
+
+/**
+* Beginnt eine neue Generation; alle Zellen gelten danach als nicht erreicht.
+*/
+static void nextEpoch()
+{
+	if (++field.epoch == 0)
+	{
+		memset(field.stamps, 0, (size_t)field.width*field.height*sizeof(uint16_t));
+		field.epoch = 1;
+	}
+	field.radius = 0;
+}
+
+/**
+* Ermittelt, ob eine Zelle von der Wellenfront betreten werden darf.
+* \param[in] cell Der Zellzustand
+* \return Null, wenn die Zelle unkartiert oder eine Wand ist, ansonsten nicht-null.
+*/
+static inline int isPassable(const uint8_t cell)
+{
+	return (cell & GRID_CELL_CHARTED) && !(cell & GRID_CELL_WALL);
+}
+
+/**
+* Breitet die Wellenfront von der Startzelle aus.
+* \param[in] startX Die X-Koordinate des Startpunktes in Kartenkoordinaten
+* \param[in] startY Die Y-Koordinate des Startpunktes in Kartenkoordinaten
+* \param[in] stopMask Zustandsbits, bei denen die Ausbreitung endet, oder 0
+* \param[out] outX Die X-Koordinate der gefundenen Zelle in Kartenkoordinaten
+* \param[out] outY Die Y-Koordinate der gefundenen Zelle in Kartenkoordinaten
+* \return Null, wenn keine passende Zelle erreicht wurde, ansonsten nicht-null.
+*/
+int wavefront_expand(const int startX, const int startY, const uint8_t stopMask, int *outX, int *outY)
+{
+	if (fitFieldToGrid()) return 0;
+	nextEpoch();
+
+	const int sx = startX - field.originX;
+	const int sy = startY - field.originY;
+	if ((unsigned)sx >= (unsigned)field.width || (unsigned)sy >= (unsigned)field.height) return 0;
+
+	/* Startzelle eintragen */
+	int head = 0, tail = 0;
+	const int32_t start = sy*field.width + sx;
+	field.stamps[start]   = field.epoch;
+	field.distance[start] = 0;
+	field.queue[tail++]   = start;
+
+	static const int dx[4] = { -1, 1, 0, 0 };
+	static const int dy[4] = { 0, 0, -1, 1 };
+
+	while (head != tail)
+	{
+		const int32_t index = field.queue[head++];
+		const int x = index % field.width;
+		const int y = index / field.width;
+		const uint8_t cell = grid_get(&searchgrid, field.originX + x, field.originY + y);
+
+		/* Gesuchte Zelle erreicht; Breitensuche liefert die kürzeste Wegdistanz */
+		if (cell & stopMask)
+		{
+			/* Alle näheren Zellen sind bereits erreicht */
+			field.radius = field.distance[index];
+			*outX = field.originX + x;
+			*outY = field.originY + y;
+			return 1;
+		}
+
+		const uint32_t distance = field.distance[index] + 1;
+		for (int n = 0; n < 4; ++n)
+		{
+			const int nx = x + dx[n];
+			const int ny = y + dy[n];
+			if ((unsigned)nx >= (unsigned)field.width || (unsigned)ny >= (unsigned)field.height) continue;
+
+			const int32_t neighbor = ny*field.width + nx;
+			if (field.stamps[neighbor] == field.epoch) continue;
+			if (!isPassable(grid_get(&searchgrid, field.originX + nx, field.originY + ny))) continue;
+
+			field.stamps[neighbor]   = field.epoch;
+			field.distance[neighbor] = distance;
+			field.queue[tail++]      = neighbor;
+		}
+	}
+
+	/* Vollständig ausgebreitet: nicht erreichte Zellen sind unerreichbar */
+	field.radius = WAVEFRONT_UNREACHABLE;
+	return 0;
+}
+
+/**
+* Verwirft das Distanzfeld der letzten Ausbreitung.
+*/
+void wavefront_invalidate(void)
+{
+	if (field.stamps != (uint16_t*)0) nextEpoch();
+}
+
+/**
+* Liefert die Wegdistanz einer Zelle aus der letzten Ausbreitung.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Die Distanz in Zellen oder {\see WAVEFRONT_UNREACHABLE}
+*/
+uint32_t wavefront_distance(const int x, const int y)
+{
+	const int rx = x - field.originX;
+	const int ry = y - field.originY;
+	if ((unsigned)rx >= (unsigned)field.width || (unsigned)ry >= (unsigned)field.height) return WAVEFRONT_UNREACHABLE;
+
+	const int32_t index = ry*field.width + rx;
+	if (field.stamps[index] != field.epoch) return WAVEFRONT_UNREACHABLE;
+	return field.distance[index];
+}
+
+/**
+* Liefert die Generation der letzten Ausbreitung.
+* \return Die Generation
+*/
+uint16_t wavefront_epoch(void)
+{
+	return field.epoch;
+}
+
+/**
+* Liefert eine untere Schranke der Wegdistanz aller Zellen, die von der
+* letzten Ausbreitung nicht erreicht wurden.
+* \return Die Distanz in Zellen oder {\see WAVEFRONT_UNREACHABLE}
+*/
+uint32_t wavefront_radius(void)
+{
+	return field.radius;
+}
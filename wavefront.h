@@ -0,0 +1,74 @@
+/**
+* Wellenfront-Distanzfeld über den begehbaren Zellen der Karte.
+*
+* Ausgehend von einer Startzelle wird eine Breitensuche über alle kartierten,
+* wandfreien Zellen (4er-Nachbarschaft) durchgeführt. Jede erreichte Zelle
+* erhält ihre Wegdistanz zum Start in Zellen; Wände und unkartierter Raum
+* werden dabei nicht durchquert. Die Ausbreitung erfolgt auf dem
+* Schnappschuss {\see searchgrid} der Hintergrundsuche.
+*/
+
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <stdint.h>
+
+/**
+* Distanz nicht erreichter Zellen
+*/
+#define WAVEFRONT_UNREACHABLE (UINT32_MAX)
+
+/**
+* Gibt die Ressourcen des Distanzfeldes frei.
+*/
+void wavefront_shutdown(void);
+
+/**
+* Breitet die Wellenfront von der Startzelle aus.
+*
+* Ist {\see stopMask} ungleich null, endet die Ausbreitung an der ersten Zelle,
+* deren Zustand eines der Bits der Maske trägt; diese ist dann die im Sinne
+* der Wegdistanz näheste solche Zelle. Andernfalls wird das vollständige
+* Distanzfeld der erreichbaren Zellen berechnet.
+*
+* \param[in] startX Die X-Koordinate des Startpunktes in Kartenkoordinaten
+* \param[in] startY Die Y-Koordinate des Startpunktes in Kartenkoordinaten
+* \param[in] stopMask Zustandsbits, bei denen die Ausbreitung endet, oder 0
+* \param[out] outX Die X-Koordinate der gefundenen Zelle in Kartenkoordinaten
+* \param[out] outY Die Y-Koordinate der gefundenen Zelle in Kartenkoordinaten
+* \return Null, wenn keine passende Zelle erreicht wurde, ansonsten nicht-null.
+*/
+int wavefront_expand(const int startX, const int startY, const uint8_t stopMask, int *outX, int *outY);
+
+/**
+* Verwirft das Distanzfeld der letzten Ausbreitung, ohne eine neue zu
+* beginnen; bis zur nächsten Ausbreitung gilt jede Zelle als nicht erreicht.
+* Ist aufzurufen, wenn das Feld nicht mehr zum Suchgitter oder zur Position
+* des Roboters passt, damit es nicht als Heuristik weiterverwendet wird.
+*/
+void wavefront_invalidate(void);
+
+/**
+* Liefert die Wegdistanz einer Zelle aus der letzten Ausbreitung.
+* \param[in] x Die X-Koordinate in Kartenkoordinaten
+* \param[in] y Die Y-Koordinate in Kartenkoordinaten
+* \return Die Distanz in Zellen oder {\see WAVEFRONT_UNREACHABLE}
+*/
+uint32_t wavefront_distance(const int x, const int y);
+
+/**
+* Liefert eine untere Schranke der Wegdistanz aller Zellen, die von der
+* letzten Ausbreitung nicht erreicht wurden. Endete die Ausbreitung ohne
+* Treffer, sind solche Zellen unerreichbar.
+* \return Die Distanz in Zellen oder {\see WAVEFRONT_UNREACHABLE}
+*/
+uint32_t wavefront_radius(void);
+
+/**
+* Liefert die Generation der letzten Ausbreitung; ändert sich mit jedem Aufruf
+* von {\see wavefront_expand} und {\see wavefront_invalidate}.
+* \return Die Generation
+*/
+uint16_t wavefront_epoch(void);
+
+#endif